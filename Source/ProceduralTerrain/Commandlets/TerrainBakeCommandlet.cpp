@@ -0,0 +1,311 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainBakeCommandlet.h"
+#include "../Libraries/ChunkFunctionLibrary.h"
+#include "../Structures/ChunkDiskCache.h"
+#include "JsonObjectConverter.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+static bool ParseChunkIndex(const FString& Params, const TCHAR* name, FIntPoint& outChunkIndex)
+{
+	FString value;
+	FString X, Y;
+	if (!FParse::Value(*Params, name, value, false) || !value.Split(TEXT(","), &X, &Y))
+		return false;
+
+	outChunkIndex = FIntPoint(FCString::Atoi(*X), FCString::Atoi(*Y));
+	return true;
+}
+
+UTerrainBakeCommandlet::UTerrainBakeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Pregenerates a rectangle of chunks into the terrain disk cache");
+	HelpUsage = TEXT("-run=TerrainBake -Min=X,Y -Max=X,Y [-LODs=2,4,6] [-CacheDir=Path] [-CacheBudgetMB=N] [-Shards=N] ")
+		TEXT("[-Snapshot=Path.json] [-NoiseGraph=Path.json] [-ChunkWidth= -NoiseScale= -HeightMultiplier= -UVScale= -MaxLOD= -Compact -Pyramid -AnalyticNormals]");
+}
+
+FTerrainSettingsPtr UTerrainBakeCommandlet::ParseSettings(const FString& Params)
+{
+	// Anything not given keeps the default of the library, like it does for the terrain
+	FTerrainSettings settings = *UChunkFunctionLibrary::GetSettings();
+	settings.compactVertices = false;
+	settings.pyramidSampling = false;
+	settings.analyticNormals = false;
+
+	// A terrain with a noise graph of its own is only matched through its snapshot, or its graph
+	FString snapshotPath;
+	uint32 snapshotHash = 0;
+	if (FParse::Value(*Params, TEXT("Snapshot="), snapshotPath))
+	{
+		if (!FTerrainSettings::LoadSnapshot(snapshotPath, settings, &snapshotHash))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Terrain commandlet: can't read the settings snapshot %s"), *snapshotPath);
+			return nullptr;
+		}
+	}
+
+	FString graphPath;
+	if (FParse::Value(*Params, TEXT("NoiseGraph="), graphPath))
+	{
+		FString JSON;
+		if (!FFileHelper::LoadFileToString(JSON, *graphPath) || !FJsonObjectConverter::JsonObjectStringToUStruct(JSON, &settings.noiseGraph))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Terrain commandlet: can't read the noise graph %s"), *graphPath);
+			return nullptr;
+		}
+	}
+
+	int32 maxLOD = settings.maxLOD;
+
+	FParse::Value(*Params, TEXT("ChunkWidth="), settings.chunkWidth);
+	FParse::Value(*Params, TEXT("NoiseScale="), settings.noiseScale);
+	FParse::Value(*Params, TEXT("HeightMultiplier="), settings.heightMultiplier);
+	FParse::Value(*Params, TEXT("UVScale="), settings.UVScale);
+	FParse::Value(*Params, TEXT("MaxLOD="), maxLOD);
+
+	settings.maxLOD = (uint8)FMath::Clamp(maxLOD, 0, (int32)FTerrainSettings::MaxSupportedLOD);
+	settings.compactVertices |= FParse::Param(*Params, TEXT("Compact"));
+	settings.pyramidSampling |= FParse::Param(*Params, TEXT("Pyramid"));
+	settings.analyticNormals |= FParse::Param(*Params, TEXT("AnalyticNormals"));
+	settings.noiseProgram = nullptr;
+
+	FString error;
+	FTerrainSettingsPtr result = FTerrainSettings::Make(MoveTemp(settings), &error);
+	if (!result.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Terrain commandlet: the noise graph doesn't compile: %s"), *error);
+		return nullptr;
+	}
+
+	// Flags on top of a snapshot are allowed, but then the terrain that wrote it won't read what gets baked
+	if (snapshotHash != 0 && snapshotHash != result->chunkDataHash)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Terrain commandlet: chunk data hash %08X, the terrain of the snapshot runs with %08X"),
+			result->chunkDataHash, snapshotHash);
+	}
+
+	return result;
+}
+
+bool UTerrainBakeCommandlet::ParseLODs(
+	const FString&		Params,
+	const uint8			maxLOD,
+	TArray<uint8>&		outLODs
+)
+{
+	outLODs.Reset();
+
+	FString LODs;
+	if (!FParse::Value(*Params, TEXT("LODs="), LODs, false))
+	{
+		for (int32 LOD = FTerrainSettings::MinShownLOD; LOD <= maxLOD; LOD++)
+			outLODs.Add((uint8)LOD);
+		return true;
+	}
+
+	TArray<FString> values;
+	LODs.ParseIntoArray(values, TEXT(","));
+
+	for (const FString& value : values)
+	{
+		// The terrain never shows nor looks up the others
+		const int32 LOD = FCString::Atoi(*value);
+		if (LOD < FTerrainSettings::MinShownLOD || LOD > maxLOD)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Terrain commandlet: LOD %d is outside of %d..%d"), LOD, FTerrainSettings::MinShownLOD, maxLOD);
+			return false;
+		}
+		outLODs.AddUnique((uint8)LOD);
+	}
+	return true;
+}
+
+bool UTerrainBakeCommandlet::ParseParams(const FString& Params)
+{
+	if (!ParseChunkIndex(Params, TEXT("Min="), m_minChunk) || !ParseChunkIndex(Params, TEXT("Max="), m_maxChunk))
+	{
+		UE_LOG(LogTemp, Error, TEXT("TerrainBake: -Min=X,Y and -Max=X,Y are required. %s"), *HelpUsage);
+		return false;
+	}
+
+	m_settings = ParseSettings(Params);
+	if (!m_settings.IsValid())
+		return false;
+
+	if (!ParseLODs(Params, m_settings->maxLOD, m_LODs))
+		return false;
+
+	if (!FParse::Value(*Params, TEXT("CacheDir="), m_cacheDirectory))
+		m_cacheDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TerrainCache"));
+
+	int32 cacheBudgetMB = 0;
+	FParse::Value(*Params, TEXT("CacheBudgetMB="), cacheBudgetMB);
+	m_cacheBudgetBytes = (int64)FMath::Max(cacheBudgetMB, 0) * 1024 * 1024;
+
+	return true;
+}
+
+TArray<UTerrainBakeCommandlet::FBakeJob> UTerrainBakeCommandlet::GatherJobs(
+	const int32			shardIndex,
+	const int32			shardCount
+) const
+{
+	FChunkDiskCache& diskCache = FChunkDiskCache::Get();
+	const uint32 chunkDataHash = m_settings->chunkDataHash;
+
+	TArray<FBakeJob> jobs;
+	for (int32 Y = FMath::Min(m_minChunk.Y, m_maxChunk.Y); Y <= FMath::Max(m_minChunk.Y, m_maxChunk.Y); Y++)
+	{
+		for (int32 X = FMath::Min(m_minChunk.X, m_maxChunk.X); X <= FMath::Max(m_minChunk.X, m_maxChunk.X); X++)
+		{
+			const FIntPoint chunkIndex(X, Y);
+
+			// Two processes appending to the same region file would tear it, so the shards split the regions
+			if (shardCount > 1 && GetTypeHash(FChunkDiskCache::GetRegionIndex(chunkIndex)) % (uint32)shardCount != (uint32)shardIndex)
+				continue;
+
+			for (const uint8 LOD : m_LODs)
+			{
+				if (!diskCache.Contains(chunkIndex, LOD, chunkDataHash))
+					jobs.Add({ chunkIndex, LOD });
+			}
+		}
+	}
+	return jobs;
+}
+
+int32 UTerrainBakeCommandlet::Main(const FString& Params)
+{
+	if (!ParseParams(Params))
+		return 1;
+
+	int32 shardCount = 1;
+	int32 shardIndex = INDEX_NONE;
+	FParse::Value(*Params, TEXT("Shards="), shardCount);
+	FParse::Value(*Params, TEXT("ShardIndex="), shardIndex);
+	shardCount = FMath::Max(shardCount, 1);
+
+	if (shardCount > 1 && shardIndex == INDEX_NONE)
+		return RunCoordinator(Params, shardCount);
+
+	FChunkDiskCache::Get().Open(m_cacheDirectory, shardIndex == INDEX_NONE ? m_cacheBudgetBytes : 0);
+	if (!FChunkDiskCache::Get().IsOpen())
+	{
+		UE_LOG(LogTemp, Error, TEXT("TerrainBake: can't create %s"), *m_cacheDirectory);
+		FChunkDiskCache::Get().Close();
+		return 1;
+	}
+
+	const TArray<FBakeJob> jobs = GatherJobs(shardIndex, shardCount);
+	const int32 result = RunJobs(jobs);
+
+	FChunkDiskCache::Get().Close();
+	return result;
+}
+
+int32 UTerrainBakeCommandlet::RunJobs(const TArray<FBakeJob>& jobs)
+{
+	static constexpr int32 BatchSize = 256;
+
+	FChunkDiskCache& diskCache = FChunkDiskCache::Get();
+	const FTerrainSettings& settings = *m_settings;
+	const FChunkJobToken token;
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBake: %d chunk LODs to bake into %s"), jobs.Num(), *m_cacheDirectory);
+
+	const double startTime = FPlatformTime::Seconds();
+	FThreadSafeCounter failedJobs;
+
+	// In batches, so the progress gets reported while it runs
+	for (int32 first = 0; first < jobs.Num(); first += BatchSize)
+	{
+		const int32 count = FMath::Min(BatchSize, jobs.Num() - first);
+
+		// The same pipeline the terrain runs, which appends the tile to the cache itself
+		ParallelFor(count, [&](const int32 i)
+			{
+				const FBakeJob& job = jobs[first + i];
+
+				delete UChunkFunctionLibrary::TryGenerateChunkData_LOD(settings, FVector2D(job.chunkIndex) * settings.chunkWidth, job.LOD, token);
+
+				if (!diskCache.Contains(job.chunkIndex, job.LOD, settings.chunkDataHash))
+					failedJobs.Increment();
+			}, EParallelForFlags::Unbalanced);
+
+		const double elapsed = FPlatformTime::Seconds() - startTime;
+		UE_LOG(LogTemp, Display, TEXT("TerrainBake: %d / %d chunk LODs, %.1f per second"),
+			first + count, jobs.Num(), elapsed > 0.0 ? (first + count) / elapsed : 0.0);
+	}
+
+	const FChunkDiskCacheStats stats = diskCache.GetStats();
+	UE_LOG(LogTemp, Display, TEXT("TerrainBake: done in %.1f s, %lld tiles and %.1f MB written, %d failed"),
+		FPlatformTime::Seconds() - startTime, stats.writtenTiles, stats.bytesWritten / (1024.0 * 1024.0), failedJobs.GetValue());
+
+	return failedJobs.GetValue() > 0 ? 1 : 0;
+}
+
+int32 UTerrainBakeCommandlet::RunCoordinator(
+	const FString&		Params,
+	const int32			shardCount
+)
+{
+	FChunkDiskCache::Get().Open(m_cacheDirectory, m_cacheBudgetBytes);
+	const int32 remainingBefore = GatherJobs(INDEX_NONE, 1).Num();
+
+	// The regions are closed before the workers start appending to them
+	FChunkDiskCache::Get().Close();
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBake: %d chunk LODs to bake over %d worker processes"), remainingBefore, shardCount);
+
+	const double startTime = FPlatformTime::Seconds();
+	TArray<FProcHandle> workers;
+
+	for (int32 shard = 0; shard < shardCount; shard++)
+	{
+		const FString workerParams = FString::Printf(TEXT("\"%s\" -run=TerrainBake %s -ShardIndex=%d -unattended -nullrhi"),
+			*FPaths::GetProjectFilePath(), *Params, shard);
+
+		FProcHandle worker = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *workerParams, false, true, true, nullptr, 0, nullptr, nullptr);
+		if (!worker.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("TerrainBake: can't start the worker of shard %d"), shard);
+			continue;
+		}
+		workers.Add(worker);
+	}
+
+	int32 failedWorkers = shardCount - workers.Num();
+	for (FProcHandle& worker : workers)
+	{
+		FPlatformProcess::WaitForProc(worker);
+
+		int32 returnCode = 1;
+		if (!FPlatformProcess::GetProcReturnCode(worker, &returnCode) || returnCode != 0)
+			failedWorkers++;
+
+		FPlatformProcess::CloseProc(worker);
+	}
+
+	// Whatever a failed worker didn't bake is picked up by the next run
+	FChunkDiskCache::Get().Open(m_cacheDirectory);
+	const int32 remainingAfter = GatherJobs(INDEX_NONE, 1).Num();
+	FChunkDiskCache::Get().Close();
+
+	const double elapsed = FPlatformTime::Seconds() - startTime;
+	const int32 baked = remainingBefore - remainingAfter;
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBake: %d chunk LODs baked in %.1f s, %.1f per second. %d left, %d failed workers"),
+		baked, elapsed, elapsed > 0.0 ? baked / elapsed : 0.0, remainingAfter, failedWorkers);
+
+	return (failedWorkers > 0 || remainingAfter > 0) ? 1 : 0;
+}
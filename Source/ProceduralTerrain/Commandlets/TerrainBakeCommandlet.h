@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "../Structures/TerrainSettings.h"
+#include "TerrainBakeCommandlet.generated.h"
+
+// Pregenerates a rectangle of chunks into the disk cache, so the terrain reads them back instead of generating them.
+// The settings have to be the ones the terrain runs with, or none of its lookups hit. Tiles already in the cache are
+// skipped, which is also how an interrupted bake resumes
+UCLASS()
+class PROCEDURALTERRAIN_API UTerrainBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+private:
+	struct FBakeJob
+	{
+		FIntPoint			chunkIndex;
+		uint8				LOD;
+	};
+
+	FIntPoint				m_minChunk;
+	FIntPoint				m_maxChunk;
+	TArray<uint8>			m_LODs;
+	FString					m_cacheDirectory;
+	int64					m_cacheBudgetBytes = 0;		//	Only the coordinator or a single process prunes the other settings
+	FTerrainSettingsPtr		m_settings;
+
+	bool ParseParams(const FString& Params);
+
+	// The chunk LODs of the rectangle that aren't baked yet, only the ones of the regions of the shard if shardCount > 1
+	TArray<FBakeJob> GatherJobs(
+		const int32			shardIndex,
+		const int32			shardCount
+	) const;
+
+	// Spawns one worker process per shard and waits for them, every region is baked by a single process
+	int32 RunCoordinator(
+		const FString&		Params,
+		const int32			shardCount
+	);
+
+	int32 RunJobs(const TArray<FBakeJob>& jobs);
+
+public:
+	UTerrainBakeCommandlet();
+
+	// Library settings, or the -Snapshot= a terrain wrote, then the graph of -NoiseGraph= and the -ChunkWidth= -NoiseScale=
+	// -HeightMultiplier= -UVScale= -MaxLOD= -Compact -Pyramid -AnalyticNormals flags on top. nullptr if a file can't be
+	// read or the noise graph doesn't compile
+	static FTerrainSettingsPtr ParseSettings(const FString& Params);
+
+	// The LODs of -LODs=, from the lowest shown LOD to maxLOD. All of them in that range without it, false if one is out of it
+	static bool ParseLODs(
+		const FString&		Params,
+		const uint8			maxLOD,
+		TArray<uint8>&		outLODs
+	);
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,869 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainBenchmarkCommandlet.h"
+#include "TerrainBakeCommandlet.h"
+#include "../Libraries/ChunkFunctionLibrary.h"
+#include "../Libraries/NoiseFunctionLibrary.h"
+#include "../Structures/TerrainClipmap.h"
+#include "../Components/ChunkComponent.h"
+#include "../Components/TerrainMeshComponent.h"
+#include "../Components/TerrainClipmapComponent.h"
+#include "../TerrainGenerator.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Engine/World.h"
+#include "RenderingThread.h"
+#include "HAL/PlatformTime.h"
+#include "Dom/JsonObject.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+// Forwards everything to the allocator it wraps and counts the allocations of every thread, so a stage only sees its own
+class FBenchmarkMalloc final : public FMalloc
+{
+private:
+	FMalloc*					m_inner;
+
+	static thread_local int64	s_allocations;
+
+public:
+	explicit FBenchmarkMalloc(FMalloc* inner) : m_inner(inner) {}
+
+	// Installed once and never removed, blocks allocated before are freed through it and the other threads may still
+	// hold it after the commandlet is done
+	static void Install()
+	{
+		static FBenchmarkMalloc* instance = nullptr;
+		if (!instance)
+		{
+			instance = new FBenchmarkMalloc(GMalloc);
+			GMalloc = instance;
+		}
+	}
+
+	static FORCEINLINE int64 GetThreadAllocations() { return s_allocations; }
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override						{ s_allocations++; return m_inner->Malloc(Count, Alignment); }
+	virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override					{ s_allocations++; return m_inner->TryMalloc(Count, Alignment); }
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override		{ s_allocations += Count > 0; return m_inner->Realloc(Original, Count, Alignment); }
+	virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override	{ s_allocations += Count > 0; return m_inner->TryRealloc(Original, Count, Alignment); }
+	virtual void Free(void* Original) override											{ m_inner->Free(Original); }
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override	{ return m_inner->GetAllocationSize(Original, SizeOut); }
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override		{ return m_inner->QuantizeSize(Count, Alignment); }
+	virtual void Trim(bool bTrimThreadCaches) override							{ m_inner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override						{ m_inner->SetupTLSCachesOnCurrentThread(); }
+	virtual void MarkTLSCachesAsUsedOnCurrentThread() override					{ m_inner->MarkTLSCachesAsUsedOnCurrentThread(); }
+	virtual void MarkTLSCachesAsUnusedOnCurrentThread() override				{ m_inner->MarkTLSCachesAsUnusedOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override				{ m_inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override						{ return m_inner->IsInternallyThreadSafe(); }
+	virtual bool ValidateHeap() override										{ return m_inner->ValidateHeap(); }
+	virtual void GetAllocatorStats(FGenericMemoryStats& out_Stats) override		{ m_inner->GetAllocatorStats(out_Stats); }
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override					{ m_inner->DumpAllocatorStats(Ar); }
+	virtual void UpdateStats() override											{ m_inner->UpdateStats(); }
+	virtual const TCHAR* GetDescriptiveName() override							{ return TEXT("BenchmarkMalloc"); }
+};
+
+thread_local int64 FBenchmarkMalloc::s_allocations = 0;
+
+// Nearest rank, on sorted samples
+static double GetPercentile(const TArray<double>& sorted, const double percentile)
+{
+	if (sorted.IsEmpty())
+		return 0.0;
+
+	const int32 rank = FMath::CeilToInt32(percentile * sorted.Num()) - 1;
+	return sorted[FMath::Clamp(rank, 0, sorted.Num() - 1)];
+}
+
+UTerrainBenchmarkCommandlet::UTerrainBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Times every stage of the chunk generation, for every LOD and from 1 to N threads, or the frames of a flight in chunk and clipmap mode. ")
+		TEXT("The uploads of the flight need -AllowCommandletRendering");
+	HelpUsage = TEXT("-run=TerrainBenchmark [-LODs=2,4,6] [-Threads=N] [-Iterations=50] [-Warmup=5] [-Output=Path] ")
+		TEXT("[-Flight -FlightFrames=600 -FlightSpeed= -LODRepetitions=2,2,2 -ClipmapLevels=8 -ClipmapResolution=128 -AllowCommandletRendering -nullrhi] ")
+		TEXT("[-Baseline=Path.json] [-Tolerance=0.15] [-Snapshot=Path.json] [-NoiseGraph=Path.json] ")
+		TEXT("[-ChunkWidth= -NoiseScale= -HeightMultiplier= -UVScale= -MaxLOD= -Compact -Pyramid -AnalyticNormals]");
+}
+
+bool UTerrainBenchmarkCommandlet::ParseParams(const FString& Params)
+{
+	m_settings = UTerrainBakeCommandlet::ParseSettings(Params);
+	if (!m_settings.IsValid())
+		return false;
+
+	const int32 maxLOD = m_settings->maxLOD;
+
+	if (!UTerrainBakeCommandlet::ParseLODs(Params, m_settings->maxLOD, m_LODs))
+		return false;
+
+	if (m_LODs.IsEmpty() && !FParse::Param(*Params, TEXT("Flight")))
+	{
+		UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: no LOD to time, max LOD is %d"), maxLOD);
+		return false;
+	}
+
+	m_maxThreads = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	FParse::Value(*Params, TEXT("Threads="), m_maxThreads);
+	FParse::Value(*Params, TEXT("Iterations="), m_iterations);
+	FParse::Value(*Params, TEXT("Warmup="), m_warmupIterations);
+	FParse::Value(*Params, TEXT("Tolerance="), m_tolerance);
+	FParse::Value(*Params, TEXT("Baseline="), m_baselinePath);
+
+	// ParallelFor runs on the task graph workers and the calling thread, past that the extra threads would run one
+	// after the other while being reported as running at once
+	const int32 availableThreads = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	if (m_maxThreads > availableThreads)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TerrainBenchmark: %d threads asked for, only %d can run at once"), m_maxThreads, availableThreads);
+		m_maxThreads = availableThreads;
+	}
+
+	m_maxThreads = FMath::Max(m_maxThreads, 1);
+	m_iterations = FMath::Max(m_iterations, 1);
+	m_warmupIterations = FMath::Max(m_warmupIterations, 0);
+
+	m_flight = FParse::Param(*Params, TEXT("Flight"));
+	m_flightSpeed = m_settings->chunkWidth / 16.0;
+	FParse::Value(*Params, TEXT("FlightFrames="), m_flightFrames);
+	FParse::Value(*Params, TEXT("FlightSpeed="), m_flightSpeed);
+	FParse::Value(*Params, TEXT("ClipmapLevels="), m_clipmapLevels);
+	FParse::Value(*Params, TEXT("ClipmapResolution="), m_clipmapResolution);
+
+	// The first frame isn't a sample, so there have to be others
+	m_flightFrames = FMath::Max(m_flightFrames, 2);
+
+	m_lodRepetitions.Reset();
+	FString lodRepetitions;
+	if (FParse::Value(*Params, TEXT("LODRepetitions="), lodRepetitions, false))
+	{
+		TArray<FString> values;
+		lodRepetitions.ParseIntoArray(values, TEXT(","));
+
+		for (const FString& value : values)
+			m_lodRepetitions.Add(FMath::Max(FCString::Atoi(*value), 0));
+
+		if (m_lodRepetitions.Num() > maxLOD + 1)
+		{
+			UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: %d LOD repetitions for LODs 0..%d"), m_lodRepetitions.Num(), maxLOD);
+			return false;
+		}
+	}
+	else
+	{
+		for (int32 LOD = 0; LOD <= maxLOD; LOD++)
+			m_lodRepetitions.Add(2);
+	}
+
+	if (!FParse::Value(*Params, TEXT("Output="), m_outputPath))
+	{
+		m_outputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TerrainBenchmark"),
+			FString::Printf(TEXT("Benchmark_%s"), *FDateTime::Now().ToString()));
+	}
+	m_outputPath = FPaths::ChangeExtension(m_outputPath, TEXT(""));
+
+	return true;
+}
+
+int32 UTerrainBenchmarkCommandlet::Main(const FString& Params)
+{
+	if (!ParseParams(Params))
+		return 1;
+
+	FBenchmarkMalloc::Install();
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %d LODs, 1 to %d threads, %d iterations per thread, settings %08X"),
+		m_LODs.Num(), m_maxThreads, m_iterations, m_settings->chunkDataHash);
+
+	TArray<FStageResult> results;
+	if (m_flight)
+	{
+		RunFlight(results);
+	}
+	else
+	{
+		for (int32 threads = 1; threads <= m_maxThreads; threads++)
+		{
+			for (const uint8 LOD : m_LODs)
+				RunLOD(LOD, threads, results);
+		}
+	}
+
+	if (!WriteResults(results))
+		return 1;
+
+	return CompareToBaseline(results) > 0 ? 1 : 0;
+}
+
+UTerrainBenchmarkCommandlet::FStageResult UTerrainBenchmarkCommandlet::RunStage(
+	const TCHAR*						stage,
+	const uint8							LOD,
+	const int32							threads,
+	TFunctionRef<void(const int32)>		body
+) const
+{
+	TArray<TArray<double>> threadSeconds;
+	TArray<TArray<int64>> threadAllocations;
+	threadSeconds.SetNum(threads);
+	threadAllocations.SetNum(threads);
+
+	const int32 callsPerThread = m_warmupIterations + m_iterations;
+
+	// threads never exceeds the task graph workers and this one, ParseParams clamps it, so every thread runs at once
+	ParallelFor(threads, [&](const int32 thread)
+		{
+			TArray<double>& seconds = threadSeconds[thread];
+			TArray<int64>& allocations = threadAllocations[thread];
+			seconds.Reserve(m_iterations);
+			allocations.Reserve(m_iterations);
+
+			for (int32 i = 0; i < callsPerThread; i++)
+			{
+				const int64 allocationsBefore = FBenchmarkMalloc::GetThreadAllocations();
+				const uint64 startCycles = FPlatformTime::Cycles64();
+
+				body(thread * callsPerThread + i);
+
+				const uint64 cycles = FPlatformTime::Cycles64() - startCycles;
+				if (i < m_warmupIterations)
+					continue;
+
+				seconds.Add(FPlatformTime::ToSeconds64(cycles));
+				allocations.Add(FBenchmarkMalloc::GetThreadAllocations() - allocationsBefore);
+			}
+		}, EParallelForFlags::Unbalanced);
+
+	TArray<double> samples;
+	int64 totalAllocations = 0;
+	double slowestThreadSeconds = 0.0;
+
+	for (int32 thread = 0; thread < threads; thread++)
+	{
+		double threadTotal = 0.0;
+		for (const double seconds : threadSeconds[thread])
+			threadTotal += seconds;
+		for (const int64 allocations : threadAllocations[thread])
+			totalAllocations += allocations;
+
+		slowestThreadSeconds = FMath::Max(slowestThreadSeconds, threadTotal);
+		samples.Append(threadSeconds[thread]);
+	}
+
+	return MakeResult(stage, LOD, threads, samples, totalAllocations, slowestThreadSeconds);
+}
+
+UTerrainBenchmarkCommandlet::FStageResult UTerrainBenchmarkCommandlet::MakeResult(
+	const TCHAR*						stage,
+	const uint8							LOD,
+	const int32							threads,
+	TArray<double>&						samples,
+	const int64							totalAllocations,
+	const double						slowestThreadSeconds
+) const
+{
+	FStageResult result;
+	result.stage = stage;
+	result.LOD = LOD;
+	result.threads = threads;
+
+	samples.Sort();
+	result.samples = samples.Num();
+
+	double totalSeconds = 0.0;
+	for (const double seconds : samples)
+		totalSeconds += seconds;
+
+	result.minUs = samples[0] * 1e6;
+	result.maxUs = samples.Last() * 1e6;
+	result.meanUs = totalSeconds / samples.Num() * 1e6;
+	result.p50Us = GetPercentile(samples, 0.50) * 1e6;
+	result.p90Us = GetPercentile(samples, 0.90) * 1e6;
+	result.p99Us = GetPercentile(samples, 0.99) * 1e6;
+	result.callsPerSecond = slowestThreadSeconds > 0.0 ? samples.Num() / slowestThreadSeconds : 0.0;
+	result.allocationsPerCall = (double)totalAllocations / samples.Num();
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %-28s LOD %2d, %2d threads: p50 %9.1f us, p99 %9.1f us, %8.1f calls/s, %.1f allocations"),
+		stage, LOD, threads, result.p50Us, result.p99Us, result.callsPerSecond, result.allocationsPerCall);
+
+	return result;
+}
+
+void UTerrainBenchmarkCommandlet::RunFlight(TArray<FStageResult>& outResults) const
+{
+	const FTerrainSettings& settings = *m_settings;
+	const float chunkWidth = settings.chunkWidth;
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: flight of %d frames at %.1f units per frame, %.1f chunks in total"),
+		m_flightFrames, m_flightSpeed, m_flightSpeed * (m_flightFrames - 1) / chunkWidth);
+
+	auto Summarize = [&](const TCHAR* stage, const double fillSeconds, TArray<double>& samples, const int64 allocations, const int32 busyFrames)
+		{
+			double totalSeconds = 0.0;
+			for (const double seconds : samples)
+				totalSeconds += seconds;
+
+			UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %s, initial fill %.1f ms, %d of %d frames did something"),
+				stage, fillSeconds * 1000.0, busyFrames, samples.Num());
+
+			outResults.Add(MakeResult(stage, 0, 1, samples, allocations, totalSeconds));
+		};
+
+	// Chunk mode, generation only: every window cell the terrain would generate, when the observer gets around another
+	// corner. On the terrain the jobs are spread over the worker pool, here they are summed into the frame that queued them
+	const TArray<TArray<FIntVector>> chunkFrames = GetFlightChunkLODs();
+	{
+		TArray<double> samples;
+		samples.Reserve(m_flightFrames);
+
+		double fillSeconds = 0.0;
+		int64 allocations = 0;
+		int32 busyFrames = 0;
+
+		for (int32 frame = 0; frame < m_flightFrames; frame++)
+		{
+			const int64 allocationsBefore = FBenchmarkMalloc::GetThreadAllocations();
+			const uint64 startCycles = FPlatformTime::Cycles64();
+
+			for (const FIntVector& chunkLOD : chunkFrames[frame])
+				delete &UChunkFunctionLibrary::GenerateChunkData_LOD(settings, FVector2D(chunkLOD.X, chunkLOD.Y) * chunkWidth, chunkLOD.Z);
+
+			const bool busy = !chunkFrames[frame].IsEmpty();
+
+			const double seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - startCycles);
+			if (frame == 0)
+			{
+				fillSeconds = seconds;
+				continue;
+			}
+
+			samples.Add(seconds);
+			allocations += FBenchmarkMalloc::GetThreadAllocations() - allocationsBefore;
+			busyFrames += busy ? 1 : 0;
+		}
+
+		Summarize(TEXT("Flight_Chunks_Generation"), fillSeconds, samples, allocations, busyFrames);
+	}
+
+	// Clipmap mode, generation only: the strips the rings uncover, then the meshes of the rings that moved
+	{
+		FTerrainClipmap clipmap;
+		clipmap.Initialize(m_settings, m_clipmapLevels, m_clipmapResolution);
+
+		FMeshData levelMesh;
+		TArray<double> samples;
+		samples.Reserve(m_flightFrames);
+
+		double fillSeconds = 0.0;
+		int64 allocations = 0;
+		int32 busyFrames = 0;
+
+		for (int32 frame = 0; frame < m_flightFrames; frame++)
+		{
+			const int64 allocationsBefore = FBenchmarkMalloc::GetThreadAllocations();
+			const uint64 startCycles = FPlatformTime::Cycles64();
+
+			const FClipmapUpdateResult result = clipmap.Update(GetFlightObserverPos(frame));
+
+			bool busy = result.movedLevels > 0;
+			for (int32 levelIndex = 0; levelIndex < clipmap.Num(); levelIndex++)
+			{
+				FClipmapLevel& level = clipmap.GetLevel(levelIndex);
+				if (!level.meshDirty)
+					continue;
+
+				clipmap.BuildLevelMesh(levelIndex, levelMesh);
+				level.holeVariant = clipmap.GetHoleVariant(levelIndex);
+				level.meshDirty = false;
+				busy = true;
+			}
+
+			const double seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - startCycles);
+			if (frame == 0)
+			{
+				fillSeconds = seconds;
+				continue;
+			}
+
+			samples.Add(seconds);
+			allocations += FBenchmarkMalloc::GetThreadAllocations() - allocationsBefore;
+			busyFrames += busy ? 1 : 0;
+		}
+
+		Summarize(TEXT("Flight_Clipmap_Generation"), fillSeconds, samples, allocations, busyFrames);
+	}
+
+	// The generation alone leaves out what each mode costs to upload, which the modes don't pay the same way. Without
+	// a scene the components would have nothing to upload to
+	if (FApp::CanEverRender())
+		RunUploadFlights(chunkFrames, outResults);
+	else
+		UE_LOG(LogTemp, Warning, TEXT("TerrainBenchmark: no rendering in this commandlet, the uploads of the flight need -AllowCommandletRendering"));
+}
+
+FVector2D UTerrainBenchmarkCommandlet::GetFlightObserverPos(const int32 frame) const
+{
+	// Diagonal, so both axes of the window and of the rings move
+	return FVector2D(1.0, 1.0).GetSafeNormal() * (m_flightSpeed * frame);
+}
+
+TArray<TArray<FIntVector>> UTerrainBenchmarkCommandlet::GetFlightChunkLODs() const
+{
+	const float chunkWidth = m_settings->chunkWidth;
+
+	TArray<FArrayUint8> lodMatrix;
+	const int32 halfWidth = ATerrainGenerator::BuildLodMatrix(m_lodRepetitions, lodMatrix);
+	const int32 renderWidth = halfWidth + halfWidth;
+
+	TArray<TArray<FIntVector>> frames;
+	frames.SetNum(m_flightFrames);
+
+	TSet<FIntVector> generated;
+	FIntPoint lastCorner = FIntPoint(MAX_int32);
+
+	for (int32 frame = 0; frame < m_flightFrames; frame++)
+	{
+		const FVector2D observerPos = GetFlightObserverPos(frame);
+		const FIntPoint corner(FMath::RoundToInt32(observerPos.X / chunkWidth), FMath::RoundToInt32(observerPos.Y / chunkWidth));
+
+		if (corner == lastCorner)
+			continue;
+
+		lastCorner = corner;
+		const FIntPoint startIdx = corner - FIntPoint(halfWidth);
+
+		for (int32 Y = 0; Y < renderWidth; Y++)
+		{
+			for (int32 X = 0; X < renderWidth; X++)
+			{
+				const uint8 LOD = lodMatrix[Y].array[X];
+				if (LOD < FTerrainSettings::MinShownLOD)
+					continue;
+
+				const FIntVector chunkLOD(startIdx.X + X, startIdx.Y + Y, LOD);
+				bool alreadyGenerated = false;
+				generated.Add(chunkLOD, &alreadyGenerated);
+				if (!alreadyGenerated)
+					frames[frame].Add(chunkLOD);
+			}
+		}
+	}
+
+	return frames;
+}
+
+void UTerrainBenchmarkCommandlet::RunThreadFlight(
+	const TCHAR*						stage,
+	UWorld*								world,
+	TFunctionRef<void(const int32)>		prepareFrame,
+	TFunctionRef<void(const int32)>		runFrame,
+	TArray<FStageResult>&				outResults
+) const
+{
+	FEvent* renderGate = FPlatformProcess::GetSynchEventFromPool();
+
+	TArray<double> gameSamples;
+	TArray<double> renderSamples;
+	gameSamples.Reserve(m_flightFrames);
+	renderSamples.Reserve(m_flightFrames);
+	int64 allocations = 0;
+
+	for (int32 frame = 0; frame < m_flightFrames; frame++)
+	{
+		prepareFrame(frame);
+
+		// The render thread is held until the game thread is done with the frame, so its commands run back to back
+		double renderStart = 0.0;
+		double renderEnd = 0.0;
+		ENQUEUE_RENDER_COMMAND(HoldTerrainBenchmarkFrame)(
+			[renderGate, &renderStart](FRHICommandListImmediate& RHICmdList)
+			{
+				renderGate->Wait();
+				renderStart = FPlatformTime::Seconds();
+			});
+
+		const int64 allocationsBefore = FBenchmarkMalloc::GetThreadAllocations();
+		const double gameStart = FPlatformTime::Seconds();
+
+		runFrame(frame);
+
+		// Where the dirty sections get their new proxy, on the game thread
+		world->SendAllEndOfFrameUpdates();
+
+		const double gameSeconds = FPlatformTime::Seconds() - gameStart;
+		const int64 frameAllocations = FBenchmarkMalloc::GetThreadAllocations() - allocationsBefore;
+
+		renderGate->Trigger();
+		ENQUEUE_RENDER_COMMAND(EndTerrainBenchmarkFrame)(
+			[&renderEnd](FRHICommandListImmediate& RHICmdList)
+			{
+				renderEnd = FPlatformTime::Seconds();
+			});
+		FlushRenderingCommands();
+
+		// Like the generation, the first frame fills everything and isn't a sample
+		if (frame == 0)
+			continue;
+
+		gameSamples.Add(gameSeconds);
+		renderSamples.Add(renderEnd - renderStart);
+		allocations += frameAllocations;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(renderGate);
+
+	// Every frame is a sample of the one thread that ran it, so the total of the samples is that thread's time
+	auto TotalSeconds = [](const TArray<double>& samples)
+		{
+			double total = 0.0;
+			for (const double seconds : samples)
+				total += seconds;
+			return total;
+		};
+
+	const double gameTotal = TotalSeconds(gameSamples);
+	const double renderTotal = TotalSeconds(renderSamples);
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %s, %.1f ms on the game thread and %.1f ms on the render thread"),
+		stage, gameTotal * 1000.0, renderTotal * 1000.0);
+
+	outResults.Add(MakeResult(*FString::Printf(TEXT("%s_GameThread"), stage), 0, 1, gameSamples, allocations, gameTotal));
+	outResults.Add(MakeResult(*FString::Printf(TEXT("%s_RenderThread"), stage), 0, 1, renderSamples, 0, renderTotal));
+}
+
+void UTerrainBenchmarkCommandlet::RunUploadFlights(
+	const TArray<TArray<FIntVector>>&	chunkFrames,
+	TArray<FStageResult>&				outResults
+) const
+{
+	const FTerrainSettings& settings = *m_settings;
+
+	// The render thread is what the split is about, commandlets don't start it on their own
+	const bool startedRenderingThread = !GIsThreadedRendering;
+	if (startedRenderingThread)
+	{
+		GUseThreadedRendering = true;
+		StartRenderingThread();
+	}
+
+	UWorld* world = UWorld::CreateWorld(EWorldType::Game, false);
+
+	// Chunk mode, through the mesh sections and through the terrain proxy. On the terrain the generation runs on the
+	// workers, so only the upload is timed
+	for (const bool terrainProxy : { false, true })
+	{
+		UTerrainMeshComponent* terrainMesh = nullptr;
+		if (terrainProxy)
+		{
+			terrainMesh = NewObject<UTerrainMeshComponent>(world);
+			terrainMesh->RegisterComponentWithWorld(world);
+		}
+
+		TMap<FIntPoint, UChunkComponent*> chunks;
+		TArray<FChunkLodData*> datas;
+
+		RunThreadFlight(terrainProxy ? TEXT("Flight_TerrainProxy") : TEXT("Flight_Sections"), world,
+			[&](const int32 frame)
+			{
+				datas.Reset();
+				for (const FIntVector& chunkLOD : chunkFrames[frame])
+					datas.Add(&UChunkFunctionLibrary::GenerateChunkData_LOD(settings, FVector2D(chunkLOD.X, chunkLOD.Y) * settings.chunkWidth, chunkLOD.Z));
+			},
+			[&](const int32 frame)
+			{
+				for (int32 i = 0; i < datas.Num(); i++)
+				{
+					const FIntPoint chunkIndex(chunkFrames[frame][i].X, chunkFrames[frame][i].Y);
+					const uint8 LOD = chunkFrames[frame][i].Z;
+
+					UChunkComponent*& chunk = chunks.FindOrAdd(chunkIndex);
+					if (!chunk)
+					{
+						chunk = NewObject<UChunkComponent>(world);
+						chunk->UseSettings(m_settings);
+
+						if (terrainMesh)
+							chunk->UseTerrainMesh(terrainMesh, chunkIndex);
+						else
+							chunk->RegisterComponentWithWorld(world);
+					}
+
+					chunk->AddLodData(*datas[i], LOD);
+					chunk->SetFutureVisibilityToClosestLOD(LOD);
+					delete datas[i];
+				}
+			},
+			outResults);
+
+		UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %d chunk components through the %s"),
+			chunks.Num(), terrainProxy ? TEXT("terrain proxy") : TEXT("mesh sections"));
+
+		for (const TPair<FIntPoint, UChunkComponent*>& chunk : chunks)
+			chunk.Value->DestroyComponent();
+		if (terrainMesh)
+			terrainMesh->DestroyComponent();
+	}
+
+	// Clipmap mode: the sampling and the meshes run on the game thread on the terrain too, so they are timed with the upload
+	{
+		UTerrainClipmapComponent* clipmap = NewObject<UTerrainClipmapComponent>(world);
+		clipmap->RegisterComponentWithWorld(world);
+		clipmap->InitializeClipmap(m_settings, m_clipmapLevels, m_clipmapResolution, true);
+
+		RunThreadFlight(TEXT("Flight_Clipmap"), world,
+			[](const int32) {},
+			[&](const int32 frame)
+			{
+				clipmap->UpdateClipmap(GetFlightObserverPos(frame));
+			},
+			outResults);
+
+		clipmap->DestroyComponent();
+	}
+
+	FlushRenderingCommands();
+	world->DestroyWorld(false);
+
+	if (startedRenderingThread)
+	{
+		StopRenderingThread();
+		GUseThreadedRendering = false;
+	}
+}
+
+void UTerrainBenchmarkCommandlet::RunLOD(
+	const uint8							LOD,
+	const int32							threads,
+	TArray<FStageResult>&				outResults
+) const
+{
+	const FTerrainSettings& settings = *m_settings;
+	const FVector2D Pos = FVector2D::ZeroVector;
+
+	// The inputs every stage reads are built once, the way a non pyramid job builds them
+	const FHeightfieldPtr heightfield = UChunkFunctionLibrary::GetTopLod_Heightfield(settings, Pos);
+
+	// Doesn't depend on the LOD, so it is only timed once per thread count
+	if (LOD == m_LODs[0])
+	{
+		outResults.Add(RunStage(TEXT("GetTopLod_Vertices"), settings.maxLOD, threads, [&](const int32)
+			{
+				UChunkFunctionLibrary::GetTopLod_Vertices(settings, Pos);
+			}));
+
+		// The same samples through FMath::PerlinNoise2D one at a time and through the batch kernel, the noise of a
+		// 64 x 64 tile spread over the lattice
+		static constexpr int32 NoiseSamples = 64 * 64;
+
+		TArray<float> noiseX, noiseY;
+		noiseX.SetNumUninitialized(NoiseSamples);
+		noiseY.SetNumUninitialized(NoiseSamples);
+		for (int32 i = 0; i < NoiseSamples; i++)
+		{
+			noiseX[i] = (i % 64) * 0.37f;
+			noiseY[i] = (i / 64) * 0.37f;
+		}
+
+		// Every thread writes its own output, the inputs are only read
+		TArray<TArray<float>> noiseOutputs;
+		noiseOutputs.SetNum(threads);
+		for (TArray<float>& output : noiseOutputs)
+			output.SetNumUninitialized(NoiseSamples);
+
+		const int32 callsPerThread = m_warmupIterations + m_iterations;
+
+		outResults.Add(RunStage(TEXT("PerlinNoise2D_Scalar"), 0, threads, [&](const int32 index)
+			{
+				UNoiseFunctionLibrary::PerlinNoise2D_Batch_Scalar(noiseX.GetData(), noiseY.GetData(), noiseOutputs[index / callsPerThread].GetData(), NoiseSamples);
+			}));
+
+		outResults.Add(RunStage(TEXT("PerlinNoise2D_Batch"), 0, threads, [&](const int32 index)
+			{
+				UNoiseFunctionLibrary::PerlinNoise2D_Batch(noiseX.GetData(), noiseY.GetData(), noiseOutputs[index / callsPerThread].GetData(), NoiseSamples);
+			}));
+
+		if (!UNoiseFunctionLibrary::IsBatchKernelEnabled())
+			UE_LOG(LogTemp, Warning, TEXT("TerrainBenchmark: the batch kernel is disabled, PerlinNoise2D_Batch ran the scalar path"));
+	}
+
+	if (settings.analyticNormals)
+	{
+		outResults.Add(RunStage(TEXT("GetChunkData_Center_Analytic"), LOD, threads, [&](const int32)
+			{
+				UChunkFunctionLibrary::GetChunkData_Center_Analytic(settings, *heightfield, Pos, LOD);
+			}));
+
+		for (const Direction dir : { Direction::Up, Direction::Down, Direction::Left, Direction::Right })
+		{
+			// In the order of Direction
+			static const TCHAR* names[] = { TEXT("GetChunkData_Border_Analytic_Left"), TEXT("GetChunkData_Border_Analytic_Right"),
+				TEXT("GetChunkData_Border_Analytic_Up"), TEXT("GetChunkData_Border_Analytic_Down") };
+
+			// Both variants of the border, like a job builds them
+			outResults.Add(RunStage(names[static_cast<uint8>(dir)], LOD, threads, [&](const int32)
+				{
+					UChunkFunctionLibrary::GetChunkData_Border_Analytic(settings, *heightfield, Pos, LOD, dir, false);
+					UChunkFunctionLibrary::GetChunkData_Border_Analytic(settings, *heightfield, Pos, LOD, dir, true);
+				}));
+		}
+	}
+	else
+	{
+		outResults.Add(RunStage(TEXT("GetLod_Additionals_Vertices"), LOD, threads, [&](const int32)
+			{
+				UChunkFunctionLibrary::GetLod_Additionals_Vertices(settings, heightfield->heights, heightfield->level, Pos, LOD, LOD);
+			}));
+
+		const TArray<FVector> additionals = UChunkFunctionLibrary::GetLod_Additionals_Vertices(settings, heightfield->heights, heightfield->level, Pos, LOD, LOD);
+		const TArray<FVector> additionals_maxLOD = UChunkFunctionLibrary::GetLod_Additionals_Vertices(settings, heightfield->heights, heightfield->level, Pos, settings.maxLOD, settings.maxLOD);
+
+		outResults.Add(RunStage(TEXT("GetChunkData_Center"), LOD, threads, [&](const int32)
+			{
+				UChunkFunctionLibrary::GetChunkData_Center(additionals, Pos, LOD);
+			}));
+
+		typedef FMeshData(*FBorderBuilder)(const TArray<FVector>&, const uint8, const uint8, const bool);
+		const TPair<const TCHAR*, FBorderBuilder> borderBuilders[] = {
+			{ TEXT("GetChunkData_Border_Up"),		&UChunkFunctionLibrary::GetChunkData_Border_Up },
+			{ TEXT("GetChunkData_Border_Down"),		&UChunkFunctionLibrary::GetChunkData_Border_Down },
+			{ TEXT("GetChunkData_Border_Left"),		&UChunkFunctionLibrary::GetChunkData_Border_Left },
+			{ TEXT("GetChunkData_Border_Right"),	&UChunkFunctionLibrary::GetChunkData_Border_Right },
+		};
+
+		for (const TPair<const TCHAR*, FBorderBuilder>& builder : borderBuilders)
+		{
+			// Both variants of the border, like a job builds them
+			outResults.Add(RunStage(builder.Key, LOD, threads, [&](const int32)
+				{
+					builder.Value(additionals_maxLOD, settings.maxLOD, LOD, false);
+					builder.Value(additionals_maxLOD, settings.maxLOD, LOD, true);
+				}));
+		}
+	}
+
+	// Every call gets a chunk of its own, on rows no other run uses, so none of them finds its heightfield in the cache
+	const int32 callsPerThread = m_warmupIterations + m_iterations;
+	const int32 rowOffset = 1 + (LOD * (m_maxThreads + 1) + threads) * m_maxThreads;
+
+	outResults.Add(RunStage(TEXT("GenerateChunkData_LOD"), LOD, threads, [&](const int32 index)
+		{
+			const FVector2D chunkIndex(index % callsPerThread, rowOffset + index / callsPerThread);
+			delete &UChunkFunctionLibrary::GenerateChunkData_LOD(settings, chunkIndex * settings.chunkWidth, LOD);
+		}));
+}
+
+bool UTerrainBenchmarkCommandlet::WriteResults(const TArray<FStageResult>& results) const
+{
+	TSharedRef<FJsonObject> root = MakeShared<FJsonObject>();
+	root->SetNumberField(TEXT("settingsHash"), m_settings->chunkDataHash);
+	root->SetNumberField(TEXT("chunkWidth"), m_settings->chunkWidth);
+	root->SetNumberField(TEXT("maxLOD"), m_settings->maxLOD);
+	root->SetBoolField(TEXT("pyramidSampling"), m_settings->pyramidSampling);
+	root->SetBoolField(TEXT("analyticNormals"), m_settings->analyticNormals);
+	root->SetBoolField(TEXT("compactVertices"), m_settings->compactVertices);
+	root->SetNumberField(TEXT("iterations"), m_iterations);
+	root->SetNumberField(TEXT("warmupIterations"), m_warmupIterations);
+
+	FString CSV = TEXT("stage,LOD,threads,samples,minUs,meanUs,p50Us,p90Us,p99Us,maxUs,callsPerSecond,allocationsPerCall\n");
+	TArray<TSharedPtr<FJsonValue>> entries;
+
+	for (const FStageResult& result : results)
+	{
+		TSharedRef<FJsonObject> entry = MakeShared<FJsonObject>();
+		entry->SetStringField(TEXT("stage"), result.stage);
+		entry->SetNumberField(TEXT("LOD"), result.LOD);
+		entry->SetNumberField(TEXT("threads"), result.threads);
+		entry->SetNumberField(TEXT("samples"), result.samples);
+		entry->SetNumberField(TEXT("minUs"), result.minUs);
+		entry->SetNumberField(TEXT("meanUs"), result.meanUs);
+		entry->SetNumberField(TEXT("p50Us"), result.p50Us);
+		entry->SetNumberField(TEXT("p90Us"), result.p90Us);
+		entry->SetNumberField(TEXT("p99Us"), result.p99Us);
+		entry->SetNumberField(TEXT("maxUs"), result.maxUs);
+		entry->SetNumberField(TEXT("callsPerSecond"), result.callsPerSecond);
+		entry->SetNumberField(TEXT("allocationsPerCall"), result.allocationsPerCall);
+		entries.Add(MakeShared<FJsonValueObject>(entry));
+
+		CSV += FString::Printf(TEXT("%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n"),
+			*result.stage, result.LOD, result.threads, result.samples, result.minUs, result.meanUs,
+			result.p50Us, result.p90Us, result.p99Us, result.maxUs, result.callsPerSecond, result.allocationsPerCall);
+	}
+	root->SetArrayField(TEXT("results"), entries);
+
+	FString JSON;
+	const TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&JSON);
+	FJsonSerializer::Serialize(root, writer);
+
+	const FString JSONPath = m_outputPath + TEXT(".json");
+	const FString CSVPath = m_outputPath + TEXT(".csv");
+
+	if (!FFileHelper::SaveStringToFile(JSON, *JSONPath) || !FFileHelper::SaveStringToFile(CSV, *CSVPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: can't write the results to %s"), *m_outputPath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: results written to %s and %s"), *JSONPath, *CSVPath);
+	return true;
+}
+
+int32 UTerrainBenchmarkCommandlet::CompareToBaseline(const TArray<FStageResult>& results) const
+{
+	if (m_baselinePath.IsEmpty())
+		return 0;
+
+	FString JSON;
+	TSharedPtr<FJsonObject> root;
+	if (!FFileHelper::LoadFileToString(JSON, *m_baselinePath) ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(JSON), root) || !root.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: can't read the baseline %s"), *m_baselinePath);
+		return 1;
+	}
+
+	if ((uint32)root->GetNumberField(TEXT("settingsHash")) != m_settings->chunkDataHash)
+		UE_LOG(LogTemp, Warning, TEXT("TerrainBenchmark: the baseline was run with other settings, the comparison is meaningless"));
+
+	TMap<FString, TSharedPtr<FJsonObject>> baseline;
+	for (const TSharedPtr<FJsonValue>& value : root->GetArrayField(TEXT("results")))
+	{
+		const TSharedPtr<FJsonObject>& entry = value->AsObject();
+		baseline.Add(FString::Printf(TEXT("%s/%d/%d"), *entry->GetStringField(TEXT("stage")),
+			(int32)entry->GetNumberField(TEXT("LOD")), (int32)entry->GetNumberField(TEXT("threads"))), entry);
+	}
+
+	// The median, the tail is too noisy to fail on. The allocations are deterministic, any new one is a regression
+	int32 regressions = 0;
+	for (const FStageResult& result : results)
+	{
+		const TSharedPtr<FJsonObject>* entry = baseline.Find(result.GetKey());
+		if (!entry)
+			continue;
+
+		const double baseP50Us = (*entry)->GetNumberField(TEXT("p50Us"));
+		const double baseAllocations = (*entry)->GetNumberField(TEXT("allocationsPerCall"));
+
+		if (result.p50Us > baseP50Us * (1.0 + m_tolerance))
+		{
+			UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: %s regressed, p50 %.1f us against %.1f us"), *result.GetKey(), result.p50Us, baseP50Us);
+			regressions++;
+		}
+
+		if (result.allocationsPerCall > baseAllocations + 0.5)
+		{
+			UE_LOG(LogTemp, Error, TEXT("TerrainBenchmark: %s allocates more, %.1f per call against %.1f"), *result.GetKey(), result.allocationsPerCall, baseAllocations);
+			regressions++;
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("TerrainBenchmark: %d regressions against %s, %.0f%% tolerance"), regressions, *m_baselinePath, m_tolerance * 100.0);
+	return regressions;
+}
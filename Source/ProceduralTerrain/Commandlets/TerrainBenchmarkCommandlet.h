@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "../Structures/TerrainSettings.h"
+#include "TerrainBenchmarkCommandlet.generated.h"
+
+class UWorld;
+
+// Times every stage of the chunk generation for every LOD, on 1 to N threads at once, and writes the percentiles and
+// allocations of each to JSON and CSV. Given the JSON of an earlier run, fails if a stage got slower than the tolerance
+// or allocates more than it did. With -Flight, times the generation of the chunk and clipmap modes over the same flight
+// instead, then the game and render thread costs of each mode with its upload: the chunks through the mesh sections and
+// through the terrain proxy, the clipmap through its sections
+UCLASS()
+class PROCEDURALTERRAIN_API UTerrainBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+private:
+	struct FStageResult
+	{
+		FString				stage;
+		uint8				LOD = 0;
+		int32				threads = 0;
+		int32				samples = 0;
+		double				minUs = 0.0;
+		double				meanUs = 0.0;
+		double				p50Us = 0.0;
+		double				p90Us = 0.0;
+		double				p99Us = 0.0;
+		double				maxUs = 0.0;
+		double				callsPerSecond = 0.0;		//	Of all the threads together
+		double				allocationsPerCall = 0.0;
+
+		FString GetKey() const { return FString::Printf(TEXT("%s/%d/%d"), *stage, LOD, threads); }
+	};
+
+	FTerrainSettingsPtr		m_settings;
+	TArray<uint8>			m_LODs;
+	int32					m_maxThreads = 1;
+	int32					m_iterations = 50;
+	int32					m_warmupIterations = 5;
+	FString					m_outputPath;					//	Without extension, the .json and .csv go next to each other
+	FString					m_baselinePath;
+	double					m_tolerance = 0.15;
+
+	bool					m_flight = false;
+	int32					m_flightFrames = 600;
+	double					m_flightSpeed = 0.0;			//	World units per frame
+	TArray<int>				m_lodRepetitions;				//	Render window of the chunk mode, like the one of the terrain
+	int32					m_clipmapLevels = 8;
+	int32					m_clipmapResolution = 128;
+
+	bool ParseParams(const FString& Params);
+
+	// Runs body warmup + iterations times on every thread, the index given is unique over the whole run
+	FStageResult RunStage(
+		const TCHAR*						stage,
+		const uint8							LOD,
+		const int32							threads,
+		TFunctionRef<void(const int32)>		body
+	) const;
+
+	// Percentiles and throughput of the samples, in seconds, which get sorted
+	FStageResult MakeResult(
+		const TCHAR*						stage,
+		const uint8							LOD,
+		const int32							threads,
+		TArray<double>&						samples,
+		const int64							totalAllocations,
+		const double						slowestThreadSeconds
+	) const;
+
+	// Flies the observer in a straight line and times what each mode does on every frame, the first one which fills
+	// everything left out
+	void RunFlight(TArray<FStageResult>& outResults) const;
+
+	FVector2D GetFlightObserverPos(const int32 frame) const;
+
+	// The (X, Y, LOD) the chunk mode generates on every frame of the flight, once the observer gets around another corner
+	TArray<TArray<FIntVector>> GetFlightChunkLODs() const;
+
+	// Times the game thread part of every frame up to the end of frame updates of the world, then the render thread part.
+	// The render thread is held until the game thread is done with the frame, so neither overlaps the other
+	void RunThreadFlight(
+		const TCHAR*						stage,
+		UWorld*								world,
+		TFunctionRef<void(const int32)>		prepareFrame,		//	Untimed
+		TFunctionRef<void(const int32)>		runFrame,
+		TArray<FStageResult>&				outResults
+	) const;
+
+	// The chunk LODs of every frame handed to chunk components through the mesh sections, then through the terrain
+	// proxy, and the clipmap updated through its sections, all in a world of their own
+	void RunUploadFlights(
+		const TArray<TArray<FIntVector>>&	chunkFrames,
+		TArray<FStageResult>&				outResults
+	) const;
+
+	void RunLOD(
+		const uint8							LOD,
+		const int32							threads,
+		TArray<FStageResult>&				outResults
+	) const;
+
+	bool WriteResults(const TArray<FStageResult>& results) const;
+
+	// Number of regressions against the baseline, 0 if there is none to compare to
+	int32 CompareToBaseline(const TArray<FStageResult>& results) const;
+
+public:
+	UTerrainBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -2,67 +2,280 @@
 
 
 #include "ChunkComponent.h"
+#include "TerrainMeshComponent.h"
+#include "../ProceduralTerrain.h"
 
 UChunkComponent::UChunkComponent(const FObjectInitializer& ObjectInitializer)
     : Super(ObjectInitializer)
 {
-    PrimaryComponentTick.bCanEverTick = true;
-    m_chunkData.Initialize(UChunkFunctionLibrary::GetMaxLOD());
+    // The visibility is applied when the expected LOD changes, so the chunk has nothing to do every frame
+    PrimaryComponentTick.bCanEverTick = false;
+    UseSettings(UChunkFunctionLibrary::GetSettings());
     m_expectedLodInfos = FChunkLodInfos();
 }
 
+void UChunkComponent::UseSettings(const FTerrainSettingsPtr& settings)
+{
+    m_settings = settings;
+
+    const uint8 maxLOD = m_settings->maxLOD;
+    m_chunkData.Reset();
+    m_chunkData.Initialize(maxLOD);
+    m_LODBytes.Init(0, maxLOD + 1);
+    m_LODLastUsed.Init(0.0, maxLOD + 1);
+    m_LODReleasedBytes.Init(0, maxLOD + 1);
+}
+
 void UChunkComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+    if (IsValid(m_terrainMesh))
+    {
+        m_terrainMesh->RemoveChunk(m_chunkIndex);
+    }
+
     m_chunkData.Reset();
 }
 
-void UChunkComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UChunkComponent::UseTerrainMesh(UTerrainMeshComponent* terrainMesh, const FIntPoint& chunkIndex)
 {
-    RefreshChunkVisibility();
+    m_terrainMesh = terrainMesh;
+    m_chunkIndex = chunkIndex;
+}
+
+void UChunkComponent::EnsureRegistered()
+{
+    if (IsRegistered())
+        return;
+
+    AttachToComponent(m_terrainMesh, FAttachmentTransformRules::KeepRelativeTransform);
+    SetVisibility(false);
+    RegisterComponentWithWorld(m_terrainMesh->GetWorld());
 }
 
 void UChunkComponent::AddLodData(FChunkLodData& chunkLodData, const uint32 LOD)
 {
-    CreateNewMeshSection(chunkLodData.Center, FChunkPartSelector(LOD, Direction::Center));
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_UploadChunkLOD);
+
+    // Compact parts are expanded one at a time into the same scratch mesh, right before their section is created
+    FMeshData scratch;
+    const float UVScale = m_settings->UVScale;
+
+    // What the render side keeps of every part, the CPU copy of the mesh sections or the vertices in the pooled pages
+    const SIZE_T vertexBytes = m_terrainMesh ? sizeof(FVector3f) + 2 * sizeof(FPackedNormal) + sizeof(FVector2f) : sizeof(FProcMeshVertex);
+    SIZE_T renderBytes = 0;
+    FBox bounds(ForceInit);
+
+    auto CountPart = [&](const FMeshData& part) -> const FMeshData&
+        {
+            renderBytes += part.vertices.Num() * vertexBytes + part.GetTriangles().Num() * sizeof(uint32);
+            bounds += FBox(part.vertices);
+            return part;
+        };
+
+    const SIZE_T dataBytes = chunkLodData.GetAllocatedSize();
+    m_LODBytes[LOD] = dataBytes;
+    m_LODLastUsed[LOD] = FPlatformTime::Seconds();
+
+    // Once the parts are in the sections, or in the terrain mesh, the data can go and only its presence and bounds stay
+    auto StoreLOD = [&]()
+        {
+            m_LODBytes[LOD] += renderBytes;
+            m_chunkData.AddNewLOD(LOD, MoveTemp(chunkLodData), bounds);
+
+            INC_DWORD_STAT(STAT_Terrain_UploadedChunkLODs);
+            INC_DWORD_STAT_BY(STAT_Terrain_UploadedBytes, renderBytes);
+
+            if (m_settings->releaseUploadedData)
+            {
+                m_chunkData.ReleaseLODData(LOD);
+                m_LODBytes[LOD] -= dataBytes;
+                m_LODReleasedBytes[LOD] = dataBytes;
+            }
+        };
+
+    if (m_terrainMesh)
+    {
+        const bool withCollision = (LOD == m_settings->maxLOD);
+
+        for (const Direction dir : { Direction::Center, Direction::Up, Direction::Down, Direction::Left, Direction::Right })
+        {
+            const FChunkPartSelector normal = FChunkPartSelector(LOD, dir);
+            const FMeshData& normalPart = CountPart(chunkLodData.GetPart(dir, false, UVScale, scratch));
+
+            m_terrainMesh->SetChunkPart(m_chunkIndex, ConvertPartSelectorToIndex(normal), normalPart, UVScale);
+
+            // The collision only needs one surface, the downscaled borders cover the same ground
+            if (withCollision)
+                CreateCollisionSection(normalPart, normal);
+
+            if (dir != Direction::Center)
+            {
+                const FChunkPartSelector downscaled = FChunkPartSelector(LOD, dir, true);
+                m_terrainMesh->SetChunkPart(m_chunkIndex, ConvertPartSelectorToIndex(downscaled), CountPart(chunkLodData.GetPart(dir, true, UVScale, scratch)), UVScale);
+            }
+        }
+
+        StoreLOD();
+        RefreshChunkVisibility();
+        return;
+    }
+
+    CreateNewMeshSection(CountPart(chunkLodData.GetPart(Direction::Center, false, UVScale, scratch)), FChunkPartSelector(LOD, Direction::Center));
+
+    for (const Direction dir : { Direction::Up, Direction::Down, Direction::Left, Direction::Right })
+    {
+        CreateNewMeshSection(CountPart(chunkLodData.GetPart(dir, false, UVScale, scratch)), FChunkPartSelector(LOD, dir));
+        CreateNewMeshSection(CountPart(chunkLodData.GetPart(dir, true, UVScale, scratch)), FChunkPartSelector(LOD, dir, true));
+    }
+
+    StoreLOD();
+
+    // The new sections were created hidden, the ones the chunk expects are shown right away
+    RefreshChunkVisibility();
+}
+
+void UChunkComponent::RemoveLOD(const uint8 LOD)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkComponent::RemoveLOD);
+
+    if (!m_chunkData.ContainsLOD(LOD))
+        return;
+
+    for (const Direction dir : { Direction::Center, Direction::Up, Direction::Down, Direction::Left, Direction::Right })
+    {
+        for (const bool downscaled : { false, true })
+        {
+            if (dir == Direction::Center && downscaled)
+                continue;
+
+            const int32 sectionIndex = ConvertPartSelectorToIndex(FChunkPartSelector(LOD, dir, downscaled));
+
+            if (m_terrainMesh)
+                m_terrainMesh->RemoveChunkPart(m_chunkIndex, sectionIndex);
+
+            // With the terrain mesh only the collision of the max LOD lives in the sections, clearing a missing one does nothing
+            ClearMeshSection(sectionIndex);
+            m_visibleSections.Remove(sectionIndex);
+        }
+    }
+
+    m_chunkData.RemoveLOD(LOD);
+    m_LODBytes[LOD] = 0;
+    m_LODReleasedBytes[LOD] = 0;
+}
+
+const FChunkLodData* UChunkComponent::FindLODData(const uint8 LOD)
+{
+    if (!m_chunkData.ContainsLOD(LOD) || !m_chunkData.IsLODDataResident(LOD))
+        return nullptr;
+
+    return &m_chunkData.GetLOD(LOD);
+}
+
+void UChunkComponent::RestoreLODData(const uint8 LOD, FChunkLodData&& data)
+{
+    if (!m_chunkData.ContainsLOD(LOD) || m_chunkData.IsLODDataResident(LOD))
+        return;
+
+    const SIZE_T dataBytes = data.GetAllocatedSize();
+    m_chunkData.RestoreLODData(LOD, MoveTemp(data));
+    m_LODBytes[LOD] += dataBytes;
+    m_LODReleasedBytes[LOD] = 0;
+}
+
+SIZE_T UChunkComponent::GetReleasedBytes() const
+{
+    SIZE_T bytes = 0;
+    for (const SIZE_T released : m_LODReleasedBytes)
+        bytes += released;
+    return bytes;
+}
+
+void UChunkComponent::ResetForReuse()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkComponent::ResetForReuse);
+
+    ClearAllMeshSections();
+
+    m_chunkData.Reset();
+    m_chunkData.Initialize(m_settings->maxLOD);
+    m_visibleSections.Empty();
+    m_expectedLodInfos = FChunkLodInfos();
+
+    for (int32 LOD = 0; LOD < m_LODBytes.Num(); LOD++)
+    {
+        m_LODBytes[LOD] = 0;
+        m_LODLastUsed[LOD] = 0.0;
+        m_LODReleasedBytes[LOD] = 0;
+    }
+}
+
+void UChunkComponent::CreateCollisionSection(const FMeshData& meshData, const FChunkPartSelector& chunkPartSelector)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkComponent::CreateCollisionSection);
 
-    CreateNewMeshSection(chunkLodData.borders_normal[static_cast<uint32>(Direction::Up)], FChunkPartSelector(LOD, Direction::Up));
-    CreateNewMeshSection(chunkLodData.borders_downscaled[static_cast<uint32>(Direction::Up)], FChunkPartSelector(LOD, Direction::Up, true));
-    CreateNewMeshSection(chunkLodData.borders_normal[static_cast<uint32>(Direction::Down)], FChunkPartSelector(LOD, Direction::Down));
-    CreateNewMeshSection(chunkLodData.borders_downscaled[static_cast<uint32>(Direction::Down)], FChunkPartSelector(LOD, Direction::Down, true));
-    CreateNewMeshSection(chunkLodData.borders_normal[static_cast<uint32>(Direction::Left)], FChunkPartSelector(LOD, Direction::Left));
-    CreateNewMeshSection(chunkLodData.borders_downscaled[static_cast<uint32>(Direction::Left)], FChunkPartSelector(LOD, Direction::Left, true));
-    CreateNewMeshSection(chunkLodData.borders_normal[static_cast<uint32>(Direction::Right)], FChunkPartSelector(LOD, Direction::Right));
-    CreateNewMeshSection(chunkLodData.borders_downscaled[static_cast<uint32>(Direction::Right)], FChunkPartSelector(LOD, Direction::Right, true));
-    m_chunkData.AddNewLOD(LOD, MoveTemp(chunkLodData));
+    EnsureRegistered();
+
+    // The component is hidden, so the section only carries what the collision is cooked from
+    CreateMeshSection(
+        ConvertPartSelectorToIndex(chunkPartSelector),
+        meshData.vertices,
+        meshData.GetTriangles(),
+        TArray<FVector>(),
+        TArray<FVector2D>(),
+        TArray<FColor>(),
+        TArray<FProcMeshTangent>(),
+        true
+    );
 }
 
 void UChunkComponent::CreateNewMeshSection(const FMeshData& meshData, const FChunkPartSelector& chunkPartSelector)
 {
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkComponent::CreateNewMeshSection);
+
+    const uint64 startCycles = FPlatformTime::Cycles64();
+
     const uint8 sectionIndex = ConvertPartSelectorToIndex(chunkPartSelector);
 
     ClearMeshSection(sectionIndex);
 
-    m_visibleSections.Add(sectionIndex);
+    // The section is recreated hidden, so it has to be shown again if the chunk expects it
+    m_visibleSections.Remove(sectionIndex);
 
     TArray<FColor> VertexColors;
     VertexColors.Init(FColor::White, meshData.vertices.Num());
 
+    // Meshes sharing their topology don't carry UVs, they are XY * UVScale like the builders used to emit them
+    TArray<FVector2D> UVs;
+    if (meshData.topology.IsValid())
+    {
+        const float UVScale = m_settings->UVScale;
+
+        UVs.SetNumUninitialized(meshData.vertices.Num());
+        for (int32 i = 0; i < meshData.vertices.Num(); i++)
+            UVs[i] = FVector2D(meshData.vertices[i].X, meshData.vertices[i].Y) * UVScale;
+    }
+
     CreateMeshSection(
         sectionIndex,                                                   // Section Index
         meshData.vertices,                                              // Vertices
-        meshData.triangles,                                             // Triangles (indices)
+        meshData.GetTriangles(),                                        // Triangles (indices)
         meshData.normals,                                               // Normals (can be empty)
-        meshData.UVs,                                                   // UV coordinates
+        meshData.topology.IsValid() ? UVs : meshData.UVs,               // UV coordinates
         VertexColors,                                                   // Vertex Colors
         meshData.tangents,                                              // Tangents (can be empty)
-        (chunkPartSelector.LOD == UChunkFunctionLibrary::GetMaxLOD())   // Enable collision
+        (chunkPartSelector.LOD == m_settings->maxLOD)                   // Enable collision
     );
     SetMeshSectionVisible(sectionIndex, false);
+
+    FTerrainRenderCounters::uploadedParts.Increment();
+    INC_DWORD_STAT(STAT_Terrain_UploadedParts);
+    FTerrainRenderCounters::gameThreadUploadCycles.Add(FPlatformTime::Cycles64() - startCycles);
 }
 
 FORCEINLINE uint32 UChunkComponent::ConvertPartSelectorToIndex(const FChunkPartSelector& sel) const
 {
-    const uint32 MaxLOD = UChunkFunctionLibrary::GetMaxLOD();
+    const uint32 MaxLOD = m_settings->maxLOD;
 
     if (sel.borderDirection == Direction::Center)
     {
@@ -80,94 +293,69 @@ FORCEINLINE uint32 UChunkComponent::ConvertPartSelectorToIndex(const FChunkPartS
 
 void UChunkComponent::SetFutureLOD(FChunkLodInfos futureLodInfos)
 {
+    if (m_expectedLodInfos == futureLodInfos)
+        return;
+
     m_expectedLodInfos = futureLodInfos;
+    RefreshChunkVisibility();
 }
 
 void UChunkComponent::RefreshChunkVisibility()
 {
-    for (int32 i = 0; i < m_visibleSections.Num(); i++)
-    {
-        SetMeshSectionVisible(m_visibleSections[i], false);
-    }
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_ChunkVisibility);
 
-    m_visibleSections.Empty(5);
-
-    if (m_expectedLodInfos.LOD < 1) return;
-
-    FChunkPartSelector center = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Center);
-    FChunkPartSelector up_normal = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Up);
-    FChunkPartSelector up_downscaled = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Up, true);
-    FChunkPartSelector down_normal = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Down);
-    FChunkPartSelector down_downscaled = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Down, true);
-    FChunkPartSelector left_normal = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Left);
-    FChunkPartSelector left_downscaled = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Left, true);
-    FChunkPartSelector right_normal = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Right);
-    FChunkPartSelector right_downscaled = FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Right, true);
-
-    const int32 sectionIndex_center = ConvertPartSelectorToIndex(center);
-    const int32 sectionIndex_up_normal = ConvertPartSelectorToIndex(up_normal);
-    const int32 sectionIndex_up_downscaled = ConvertPartSelectorToIndex(up_downscaled);
-    const int32 sectionIndex_down_normal = ConvertPartSelectorToIndex(down_normal);
-    const int32 sectionIndex_down_downscaled = ConvertPartSelectorToIndex(down_downscaled);
-    const int32 sectionIndex_left_normal = ConvertPartSelectorToIndex(left_normal);
-    const int32 sectionIndex_left_downscaled = ConvertPartSelectorToIndex(left_downscaled);
-    const int32 sectionIndex_right_normal = ConvertPartSelectorToIndex(right_normal);
-    const int32 sectionIndex_right_downscaled = ConvertPartSelectorToIndex(right_downscaled);
-
-    const bool donwscaleUp = m_expectedLodInfos.GetDownscale(Direction::Up);
-    const bool donwscaleDown = m_expectedLodInfos.GetDownscale(Direction::Down);
-    const bool downscaleLeft = m_expectedLodInfos.GetDownscale(Direction::Left);
-    const bool downscaleRight = m_expectedLodInfos.GetDownscale(Direction::Right);
-
-    SetMeshSectionVisible(sectionIndex_center, true);
-    m_visibleSections.Add(sectionIndex_center);
-
-    if (!donwscaleUp) {
-        SetMeshSectionVisible(sectionIndex_up_normal, true);
-        m_visibleSections.Add(sectionIndex_up_normal);
-    }
-    else
-    {
-        SetMeshSectionVisible(sectionIndex_up_downscaled, true);
-        m_visibleSections.Add(sectionIndex_up_downscaled);
-    }
-    if (!donwscaleDown)
-    {
-        SetMeshSectionVisible(sectionIndex_down_normal, true);
-        m_visibleSections.Add(sectionIndex_down_normal);
+    const uint64 startCycles = FPlatformTime::Cycles64();
 
-    }
-    else
-    {
-        SetMeshSectionVisible(sectionIndex_down_downscaled, true);
-        m_visibleSections.Add(sectionIndex_down_downscaled);
-    }
-    if (!downscaleLeft)
-    {
-        SetMeshSectionVisible(sectionIndex_left_normal, true);
-        m_visibleSections.Add(sectionIndex_left_normal);
+    TArray<int32> sections;
+    sections.Reserve(5);
 
-    }
-    else
+    if (m_expectedLodInfos.LOD >= 1)
     {
-        SetMeshSectionVisible(sectionIndex_left_downscaled, true);
-        m_visibleSections.Add(sectionIndex_left_downscaled);
+        sections.Add(ConvertPartSelectorToIndex(FChunkPartSelector(m_expectedLodInfos.LOD, Direction::Center)));
 
+        for (const Direction dir : { Direction::Up, Direction::Down, Direction::Left, Direction::Right })
+        {
+            sections.Add(ConvertPartSelectorToIndex(FChunkPartSelector(m_expectedLodInfos.LOD, dir, m_expectedLodInfos.GetDownscale(dir))));
+        }
     }
-    if (!downscaleRight)
+
+    // Only the sections that differ from the visible ones are touched, each of them dirties the render state
+    int32 changes = 0;
+
+    for (const int32 sectionIndex : m_visibleSections)
     {
-        SetMeshSectionVisible(sectionIndex_right_normal, true);
-        m_visibleSections.Add(sectionIndex_right_normal);
+        if (sections.Contains(sectionIndex))
+            continue;
 
+        if (!m_terrainMesh)
+            SetMeshSectionVisible(sectionIndex, false);
+        changes++;
     }
-    else
+
+    for (const int32 sectionIndex : sections)
     {
-        SetMeshSectionVisible(sectionIndex_right_downscaled, true);
-        m_visibleSections.Add(sectionIndex_right_downscaled);
+        if (m_visibleSections.Contains(sectionIndex))
+            continue;
+
+        if (!m_terrainMesh)
+            SetMeshSectionVisible(sectionIndex, true);
+        changes++;
     }
+
+    if (changes == 0)
+        return;
+
+    m_visibleSections = MoveTemp(sections);
+
+    // The terrain mesh keeps the visible parts of the chunk, so they are sent as a whole
+    if (m_terrainMesh)
+        m_terrainMesh->SetChunkVisibleParts(m_chunkIndex, m_visibleSections);
+
+    FTerrainRenderCounters::AddSectionChanges(changes);
+    FTerrainRenderCounters::gameThreadVisibilityCycles.Add(FPlatformTime::Cycles64() - startCycles);
 }
 
-void UChunkComponent::SetFutureVisibilityToClosestLOD(const uint32 lod)
+void UChunkComponent::SetFutureVisibilityToClosestLOD(const uint32 lod, const bool resetBorders)
 {
     const uint32 maxLowerLOD = m_chunkData.GetMaxLowerLOD(lod);
     const uint32 minHigherLOD = m_chunkData.GetMinHigherLOD(lod);
@@ -175,5 +363,7 @@ void UChunkComponent::SetFutureVisibilityToClosestLOD(const uint32 lod)
     const uint32 diffLower = (lod >= maxLowerLOD) ? (lod - maxLowerLOD) : (maxLowerLOD - lod);
     const uint32 diffHigher = (minHigherLOD >= lod) ? (minHigherLOD - lod) : (lod - minHigherLOD);
 
-    m_expectedLodInfos.LOD = (diffLower > diffHigher) ? minHigherLOD : maxLowerLOD;
+    const uint8 closestLOD = (diffLower > diffHigher) ? minHigherLOD : maxLowerLOD;
+
+    SetFutureLOD(FChunkLodInfos(closestLOD, resetBorders ? (uint8)0 : m_expectedLodInfos.downscales_masked));
 }
@@ -8,6 +8,8 @@
 #include "../Libraries/ChunkFunctionLibrary.h"
 #include "ChunkComponent.generated.h"
 
+class UTerrainMeshComponent;
+
 UCLASS()
 class PROCEDURALTERRAIN_API UChunkComponent : public UProceduralMeshComponent
 {
@@ -16,27 +18,81 @@ private:
 	FChunkData				m_chunkData;
 	TArray<int32>			m_visibleSections;
 	FChunkLodInfos			m_expectedLodInfos;
+
+	TArray<SIZE_T>			m_LODBytes;						//	Data and render bytes of every LOD, taken when it is added
+	TArray<double>			m_LODLastUsed;					//	Last time every LOD was wanted by the window, for the eviction order
+	TArray<SIZE_T>			m_LODReleasedBytes;				//	Data of every LOD dropped after its upload
+
+	UPROPERTY()
+	TObjectPtr<UTerrainMeshComponent>	m_terrainMesh = nullptr;	//	Draws the parts instead of the mesh sections when set, cleared by the GC if it goes first
+	FIntPoint				m_chunkIndex;
+
+	FTerrainSettingsPtr		m_settings;						//	Settings of the terrain the chunk belongs to, its data was generated with them
+
+	void EnsureRegistered();
+
+	void CreateCollisionSection(const FMeshData&, const FChunkPartSelector&);
 public:
 
 	UChunkComponent(const FObjectInitializer& ObjectInitializer);
 
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
-
 	FORCEINLINE bool ContainsLOD(uint32 LOD)
 	{
 		return m_chunkData.ContainsLOD(LOD);
 ;	}
 
+	// The parts are sent to the terrain mesh from now on, the component only gets registered for the collision of the max LOD
+	void UseTerrainMesh(
+		UTerrainMeshComponent*	terrainMesh,
+		const FIntPoint&		chunkIndex
+	);
+
+	FORCEINLINE bool UsesTerrainMesh() const { return m_terrainMesh != nullptr; }
+
+	// Only on an empty component, a fresh or reset one, the LOD count comes from the settings
+	void UseSettings(const FTerrainSettingsPtr& settings);
+
 	void AddLodData(
 		FChunkLodData&		chunkLodData, 
 		const uint32			LOD
 	);
 
+	// Frees the data and the sections or parts of the LOD, the chunk must not be showing it
+	void RemoveLOD(const uint8 LOD);
+
+	// Drops every LOD and section so the component can be given another chunk. The parts the terrain mesh has
+	// for the old chunk index are left to whoever evicted it
+	void ResetForReuse();
+
+	FORCEINLINE SIZE_T GetLODResidentBytes(const uint8 LOD) const { return m_LODBytes[LOD]; }
+
+	FORCEINLINE double GetLODLastUsed(const uint8 LOD) const { return m_LODLastUsed[LOD]; }
+
+	FORCEINLINE void TouchLOD(const uint8 LOD, const double time) { m_LODLastUsed[LOD] = time; }
+
+	FORCEINLINE const FChunkLodInfos& GetExpectedLodInfos() const { return m_expectedLodInfos; }
+
+	FORCEINLINE bool IsLODDataResident(const uint8 LOD) const { return m_chunkData.IsLODDataResident(LOD); }
+
+	FORCEINLINE const FBox& GetLODBounds(const uint8 LOD) const { return m_chunkData.GetLODBounds(LOD); }
+
+	// nullptr if the data was released after the upload, RestoreLODData gives it back
+	const FChunkLodData* FindLODData(const uint8 LOD);
+
+	void RestoreLODData(const uint8 LOD, FChunkLodData&& data);
+
+	SIZE_T GetReleasedBytes() const;
+
+	FORCEINLINE SIZE_T GetResidentBytes() const { return m_chunkData.GetAllocatedSize(); }
+
+	FORCEINLINE SIZE_T GetExpandedBytes() const { return m_chunkData.GetExpandedSize(); }
+
 	void CreateNewMeshSection(const FMeshData&, const FChunkPartSelector&);
 
-	void SetFutureVisibilityToClosestLOD(const uint32 lod);
+	// Both apply the visibility right away, and only if the expected LOD or borders changed
+	void SetFutureVisibilityToClosestLOD(const uint32 lod, const bool resetBorders = false);
 
 	void RefreshChunkVisibility();
 
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainClipmapComponent.h"
+#include "../ProceduralTerrain.h"
+
+UTerrainClipmapComponent::UTerrainClipmapComponent(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer)
+{
+    // The terrain updates it when it looks at the observer, like the chunks
+    PrimaryComponentTick.bCanEverTick = false;
+    SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+    // The finest level moves often, its collision can't be cooked on the game thread every time
+    bUseAsyncCooking = true;
+}
+
+void UTerrainClipmapComponent::InitializeClipmap(
+    const FTerrainSettingsPtr&  settings,
+    const int32                 levels,
+    const int32                 resolution,
+    const bool                  collision
+)
+{
+    ClearAllMeshSections();
+
+    m_collision = collision;
+    SetCollisionEnabled(collision ? ECollisionEnabled::QueryAndPhysics : ECollisionEnabled::NoCollision);
+
+    m_clipmap.Initialize(settings, levels, resolution);
+
+    const int32 width = m_clipmap.GetResolution() + 1;
+    m_vertexColors.Init(FColor::White, width * width);
+}
+
+FClipmapUpdateResult UTerrainClipmapComponent::UpdateClipmap(const FVector2D& observerPos)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UTerrainClipmapComponent::UpdateClipmap);
+
+    FClipmapUpdateResult result = m_clipmap.Update(observerPos);
+
+    for (int32 levelIndex = 0; levelIndex < m_clipmap.Num(); levelIndex++)
+    {
+        FClipmapLevel& level = m_clipmap.GetLevel(levelIndex);
+        if (!level.meshDirty)
+            continue;
+
+        const int32 holeVariant = m_clipmap.GetHoleVariant(levelIndex);
+        m_clipmap.BuildLevelMesh(levelIndex, m_levelMesh);
+
+        // Every variant has the same vertices, only the triangles around the hole differ. The update cooks the collision
+        // again if the section has some
+        const FProcMeshSection* section = GetProcMeshSection(levelIndex);
+        if (section && section->ProcVertexBuffer.Num() == m_levelMesh.vertices.Num() && level.holeVariant == holeVariant)
+        {
+            UpdateMeshSection(levelIndex, m_levelMesh.vertices, m_levelMesh.normals, m_levelMesh.UVs, m_vertexColors, m_levelMesh.tangents);
+        }
+        else
+        {
+            CreateMeshSection(
+                levelIndex,
+                m_levelMesh.vertices,
+                m_levelMesh.GetTriangles(),
+                m_levelMesh.normals,
+                m_levelMesh.UVs,
+                m_vertexColors,
+                m_levelMesh.tangents,
+                m_collision && levelIndex == 0
+            );
+        }
+
+        level.holeVariant = holeVariant;
+        level.meshDirty = false;
+        result.rebuiltLevels++;
+    }
+    return result;
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "../Structures/TerrainClipmap.h"
+#include "TerrainClipmapComponent.generated.h"
+
+// Draws the levels of a clipmap around the observer, one mesh section per level. A level only gets its section
+// updated when it or its finer level moved, and only recreated when the hole of the finer level moved in it.
+// Only the finest level can carry collision, cooked off the game thread every time it moves: nothing collides past it
+UCLASS()
+class PROCEDURALTERRAIN_API UTerrainClipmapComponent : public UProceduralMeshComponent
+{
+	GENERATED_BODY()
+private:
+	FTerrainClipmap			m_clipmap;
+	FMeshData				m_levelMesh;					//	Scratch of the level being rebuilt, kept for its allocations
+	TArray<FColor>			m_vertexColors;
+	bool					m_collision = false;			//	On the section of the finest level
+
+public:
+	UTerrainClipmapComponent(const FObjectInitializer& ObjectInitializer);
+
+	// Drops the sections, the first update samples every level
+	void InitializeClipmap(
+		const FTerrainSettingsPtr&	settings,
+		const int32					levels,
+		const int32					resolution,
+		const bool					collision
+	);
+
+	// Moves the levels around the observer and rebuilds the sections of the dirty ones
+	FClipmapUpdateResult UpdateClipmap(const FVector2D& observerPos);
+
+	FORCEINLINE const FTerrainClipmap& GetClipmap() const { return m_clipmap; }
+};
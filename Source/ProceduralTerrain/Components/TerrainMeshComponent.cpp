@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainMeshComponent.h"
+#include "../ProceduralTerrain.h"
+#include "RenderingThread.h"
+#include "SceneInterface.h"
+
+UTerrainMeshComponent::UTerrainMeshComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	m_localBounds.Init();
+}
+
+void UTerrainMeshComponent::OnRegister()
+{
+	if (!m_renderData.IsValid())
+	{
+		const ERHIFeatureLevel::Type featureLevel = GetScene() ? GetScene()->GetFeatureLevel() : GMaxRHIFeatureLevel;
+
+		m_renderData = MakeShared<FTerrainRenderData, ESPMode::ThreadSafe>(featureLevel, (uint32)FMath::Max(m_pageVertices, 1), (uint32)FMath::Max(m_pageIndices, 3));
+	}
+
+	Super::OnRegister();
+}
+
+void UTerrainMeshComponent::OnComponentDestroyed(bool bDestroyingHierarchy)
+{
+	Super::OnComponentDestroyed(bDestroyingHierarchy);
+	ReleaseRenderData();
+}
+
+void UTerrainMeshComponent::BeginDestroy()
+{
+	Super::BeginDestroy();
+	ReleaseRenderData();
+}
+
+void UTerrainMeshComponent::ReleaseRenderData()
+{
+	m_localBounds.Init();
+
+	if (!m_renderData.IsValid())
+		return;
+
+	// The proxy may still hold a reference, so the render data itself dies with whichever of the two goes last
+	FTerrainRenderDataPtr renderData = MoveTemp(m_renderData);
+	ENQUEUE_RENDER_COMMAND(ReleaseTerrainRenderData)(
+		[renderData](FRHICommandListImmediate& RHICmdList)
+		{
+			renderData->ReleaseResources_RenderThread();
+		});
+}
+
+FPrimitiveSceneProxy* UTerrainMeshComponent::CreateSceneProxy()
+{
+	if (!m_renderData.IsValid())
+		return nullptr;
+
+	return new FTerrainSceneProxy(this, m_renderData);
+}
+
+FBoxSphereBounds UTerrainMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!m_localBounds.IsValid)
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector(1.0), 1.0);
+
+	return FBoxSphereBounds(m_localBounds).TransformBy(LocalToWorld);
+}
+
+void UTerrainMeshComponent::SetChunkPart(
+	const FIntPoint&			chunkIndex,
+	const uint32				partIndex,
+	const FMeshData&			meshData,
+	const float					UVScale
+)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UTerrainMeshComponent::SetChunkPart);
+
+	if (!m_renderData.IsValid())
+		return;
+
+	const uint64 startCycles = FPlatformTime::Cycles64();
+
+	const TArray<int32>& triangles = meshData.GetTriangles();
+	const int32 numVertices = meshData.vertices.Num();
+	const bool hasNormals = meshData.normals.Num() == numVertices;
+	const bool hasTangents = meshData.tangents.Num() == numVertices;
+
+	FTerrainUploadPart* part = new FTerrainUploadPart();
+	part->positions.SetNumUninitialized(numVertices);
+	part->tangents.SetNumUninitialized(numVertices * 2);
+	part->UVs.SetNumUninitialized(numVertices);
+	part->indices.SetNumUninitialized(triangles.Num());
+	part->bounds.Init();
+
+	for (int32 i = 0; i < numVertices; i++)
+	{
+		const FVector3f position = FVector3f(meshData.vertices[i]);
+		const FVector3f normal = hasNormals ? FVector3f(meshData.normals[i]) : FVector3f::UpVector;
+		const FVector3f tangent = hasTangents ? FVector3f(meshData.tangents[i].TangentX) : FVector3f::ForwardVector;
+
+		part->positions[i] = position;
+		part->bounds += position;
+
+		// The sign of the binormal lives in the W of TangentZ
+		part->tangents[i * 2] = FPackedNormal(tangent);
+		part->tangents[i * 2 + 1] = FPackedNormal(FVector4f(normal, (hasTangents && meshData.tangents[i].bFlipTangentY) ? -1.0f : 1.0f));
+
+		// Meshes sharing their topology don't carry UVs, they are XY * UVScale like the mesh sections get them
+		part->UVs[i] = meshData.topology.IsValid() || meshData.UVs.Num() != numVertices
+			? FVector2f(position.X, position.Y) * UVScale
+			: FVector2f(meshData.UVs[i]);
+	}
+
+	for (int32 i = 0; i < triangles.Num(); i++)
+		part->indices[i] = (uint32)triangles[i];
+
+	// The bounds only ever grow, a removed chunk leaves them as they were until the terrain is rebuilt
+	const FBox partBounds = FBox(part->bounds);
+	if (partBounds.IsValid && (!m_localBounds.IsValid || !m_localBounds.IsInsideOrOn(partBounds.Min) || !m_localBounds.IsInsideOrOn(partBounds.Max)))
+	{
+		m_localBounds += partBounds;
+		UpdateBounds();
+		MarkRenderTransformDirty();
+	}
+
+	FTerrainRenderDataPtr renderData = m_renderData;
+	ENQUEUE_RENDER_COMMAND(SetTerrainChunkPart)(
+		[renderData, chunkIndex, partIndex, part](FRHICommandListImmediate& RHICmdList)
+		{
+			renderData->SetPart_RenderThread(RHICmdList, chunkIndex, partIndex, *part);
+			delete part;
+		});
+
+	FTerrainRenderCounters::uploadedParts.Increment();
+	INC_DWORD_STAT(STAT_Terrain_UploadedParts);
+	FTerrainRenderCounters::gameThreadUploadCycles.Add(FPlatformTime::Cycles64() - startCycles);
+}
+
+void UTerrainMeshComponent::SetChunkVisibleParts(
+	const FIntPoint&			chunkIndex,
+	const TArray<int32>&		visibleParts
+)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UTerrainMeshComponent::SetChunkVisibleParts);
+
+	if (!m_renderData.IsValid())
+		return;
+
+	TArray<uint32> parts;
+	parts.Reserve(visibleParts.Num());
+	for (const int32 partIndex : visibleParts)
+		parts.Add((uint32)partIndex);
+
+	FTerrainRenderDataPtr renderData = m_renderData;
+	ENQUEUE_RENDER_COMMAND(SetTerrainChunkVisibleParts)(
+		[renderData, chunkIndex, parts = MoveTemp(parts)](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			renderData->SetVisibleParts_RenderThread(chunkIndex, MoveTemp(parts));
+		});
+}
+
+void UTerrainMeshComponent::RemoveChunkPart(const FIntPoint& chunkIndex, const uint32 partIndex)
+{
+	if (!m_renderData.IsValid())
+		return;
+
+	FTerrainRenderDataPtr renderData = m_renderData;
+	ENQUEUE_RENDER_COMMAND(RemoveTerrainChunkPart)(
+		[renderData, chunkIndex, partIndex](FRHICommandListImmediate& RHICmdList)
+		{
+			renderData->RemovePart_RenderThread(chunkIndex, partIndex);
+		});
+}
+
+void UTerrainMeshComponent::RemoveChunk(const FIntPoint& chunkIndex)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UTerrainMeshComponent::RemoveChunk);
+
+	if (!m_renderData.IsValid())
+		return;
+
+	FTerrainRenderDataPtr renderData = m_renderData;
+	ENQUEUE_RENDER_COMMAND(RemoveTerrainChunk)(
+		[renderData, chunkIndex](FRHICommandListImmediate& RHICmdList)
+		{
+			renderData->RemoveChunk_RenderThread(chunkIndex);
+		});
+}
+
+int32 UTerrainMeshComponent::GetNumBufferPages() const
+{
+	return m_renderData.IsValid() ? m_renderData->GetNumPages() : 0;
+}
+
+int64 UTerrainMeshComponent::GetBufferBytes() const
+{
+	return m_renderData.IsValid() ? m_renderData->GetGPUBytes() : 0;
+}
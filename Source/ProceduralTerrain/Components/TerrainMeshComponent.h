@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/MeshComponent.h"
+#include "../Structures/MeshData.h"
+#include "TerrainSceneProxy.h"
+#include "TerrainMeshComponent.generated.h"
+
+// Rendering costs since the last reset, for the path the terrain currently uses
+USTRUCT(BlueprintType)
+struct FTerrainRenderStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) bool			usesTerrainProxy = false;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		gameThreadUploadSeconds = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		gameThreadVisibilitySeconds = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		renderThreadUploadSeconds = 0.0;		//	Terrain proxy only, the mesh sections are uploaded by the engine
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		renderThreadGatherSeconds = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		uploadedParts = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		visibilityUpdates = 0;				//	Sections, or parts, whose visibility changed
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		sectionChangesThisFrame = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		maxSectionChangesPerFrame = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		framesWithSectionChanges = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		drawRanges = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		registeredChunkComponents = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		bufferPages = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		bufferBytes = 0;
+};
+
+// Single primitive drawing the parts of every chunk out of pooled GPU buffers. Each visible (chunk, LOD, border) part
+// is one draw range, so a chunk costs neither a component nor mesh sections nor render state updates
+UCLASS()
+class PROCEDURALTERRAIN_API UTerrainMeshComponent : public UMeshComponent
+{
+	GENERATED_BODY()
+private:
+	FTerrainRenderDataPtr			m_renderData;
+	FBox							m_localBounds;
+
+	void ReleaseRenderData();
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Vertices of one pooled buffer page"))
+	int32							m_pageVertices = 256 * 1024;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Indices of one pooled buffer page"))
+	int32							m_pageIndices = 1536 * 1024;
+
+	UTerrainMeshComponent(const FObjectInitializer& ObjectInitializer);
+
+	virtual void OnRegister() override;
+	virtual void OnComponentDestroyed(bool bDestroyingHierarchy) override;
+	virtual void BeginDestroy() override;
+
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	virtual int32 GetNumMaterials() const override { return 1; }
+
+	// Converts the part and hands it to the render thread, replacing the one the chunk had at this index
+	void SetChunkPart(
+		const FIntPoint&			chunkIndex,
+		const uint32				partIndex,
+		const FMeshData&			meshData,
+		const float					UVScale
+	);
+
+	void SetChunkVisibleParts(
+		const FIntPoint&			chunkIndex,
+		const TArray<int32>&		visibleParts
+	);
+
+	void RemoveChunkPart(
+		const FIntPoint&			chunkIndex,
+		const uint32				partIndex
+	);
+
+	void RemoveChunk(const FIntPoint& chunkIndex);
+
+	int32 GetNumBufferPages() const;
+
+	int64 GetBufferBytes() const;
+};
@@ -0,0 +1,410 @@
+#include "TerrainSceneProxy.h"
+#include "TerrainMeshComponent.h"
+#include "../ProceduralTerrain.h"
+#include "Materials/Material.h"
+#include "SceneInterface.h"
+#include "SceneManagement.h"
+
+FThreadSafeCounter64 FTerrainRenderCounters::gameThreadUploadCycles;
+FThreadSafeCounter64 FTerrainRenderCounters::gameThreadVisibilityCycles;
+FThreadSafeCounter64 FTerrainRenderCounters::renderThreadUploadCycles;
+FThreadSafeCounter64 FTerrainRenderCounters::renderThreadGatherCycles;
+FThreadSafeCounter64 FTerrainRenderCounters::uploadedParts;
+FThreadSafeCounter64 FTerrainRenderCounters::visibilityUpdates;
+FThreadSafeCounter64 FTerrainRenderCounters::drawRanges;
+uint64 FTerrainRenderCounters::sectionChangesFrame = 0;
+int32 FTerrainRenderCounters::sectionChangesThisFrame = 0;
+int32 FTerrainRenderCounters::maxSectionChangesPerFrame = 0;
+int64 FTerrainRenderCounters::framesWithSectionChanges = 0;
+
+void FTerrainRenderCounters::AddSectionChanges(const int32 changes)
+{
+    check(IsInGameThread());
+
+    if (sectionChangesFrame != GFrameCounter)
+    {
+        sectionChangesFrame = GFrameCounter;
+        sectionChangesThisFrame = 0;
+        framesWithSectionChanges++;
+    }
+
+    sectionChangesThisFrame += changes;
+    maxSectionChangesPerFrame = FMath::Max(maxSectionChangesPerFrame, sectionChangesThisFrame);
+    visibilityUpdates.Add(changes);
+}
+
+void FTerrainRenderCounters::Reset()
+{
+    gameThreadUploadCycles.Reset();
+    gameThreadVisibilityCycles.Reset();
+    renderThreadUploadCycles.Reset();
+    renderThreadGatherCycles.Reset();
+    uploadedParts.Reset();
+    visibilityUpdates.Reset();
+    drawRanges.Reset();
+
+    sectionChangesFrame = 0;
+    sectionChangesThisFrame = 0;
+    maxSectionChangesPerFrame = 0;
+    framesWithSectionChanges = 0;
+}
+
+void FTerrainRangeAllocator::Initialize(const uint32 capacity)
+{
+    m_free.Reset();
+    m_free.Add({ 0, capacity });
+    m_capacity = capacity;
+    m_used = 0;
+}
+
+bool FTerrainRangeAllocator::Allocate(const uint32 count, uint32& outOffset)
+{
+    for (int32 i = 0; i < m_free.Num(); i++)
+    {
+        FRange& range = m_free[i];
+        if (range.count < count)
+            continue;
+
+        outOffset = range.offset;
+        range.offset += count;
+        range.count -= count;
+
+        if (range.count == 0)
+            m_free.RemoveAt(i);
+
+        m_used += count;
+        return true;
+    }
+    return false;
+}
+
+void FTerrainRangeAllocator::Free(const uint32 offset, const uint32 count)
+{
+    int32 next = 0;
+    while (next < m_free.Num() && m_free[next].offset < offset)
+        next++;
+
+    m_free.Insert({ offset, count }, next);
+    m_used -= count;
+
+    // Merging with the following range first, so the index of the new one stays valid
+    if (next + 1 < m_free.Num() && m_free[next].offset + m_free[next].count == m_free[next + 1].offset)
+    {
+        m_free[next].count += m_free[next + 1].count;
+        m_free.RemoveAt(next + 1);
+    }
+
+    if (next > 0 && m_free[next - 1].offset + m_free[next - 1].count == m_free[next].offset)
+    {
+        m_free[next - 1].count += m_free[next].count;
+        m_free.RemoveAt(next);
+    }
+}
+
+void FTerrainIndexBuffer::InitRHI(FRHICommandListBase& RHICmdList)
+{
+    FRHIResourceCreateInfo CreateInfo(TEXT("FTerrainIndexBuffer"));
+    IndexBufferRHI = RHICmdList.CreateIndexBuffer(sizeof(uint32), FMath::Max<uint32>(capacity, 3) * sizeof(uint32), BUF_Static, CreateInfo);
+}
+
+void FTerrainBufferPage::InitResources(
+    FRHICommandListBase&        RHICmdList,
+    const uint32                vertexCapacity,
+    const uint32                indexCapacity
+)
+{
+    vertexRanges.Initialize(vertexCapacity);
+    indexRanges.Initialize(indexCapacity);
+
+    // The buffers are created at their full size right away, the parts are then written in place
+    vertexBuffers.PositionVertexBuffer.Init(vertexCapacity, false);
+    vertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(true);
+    vertexBuffers.StaticMeshVertexBuffer.Init(vertexCapacity, 1, false);
+
+    vertexBuffers.PositionVertexBuffer.InitResource(RHICmdList);
+    vertexBuffers.StaticMeshVertexBuffer.InitResource(RHICmdList);
+
+    indexBuffer.capacity = indexCapacity;
+    indexBuffer.InitResource(RHICmdList);
+
+    FLocalVertexFactory::FDataType Data;
+    vertexBuffers.PositionVertexBuffer.BindPositionVertexBuffer(&vertexFactory, Data);
+    vertexBuffers.StaticMeshVertexBuffer.BindTangentVertexBuffer(&vertexFactory, Data);
+    vertexBuffers.StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(&vertexFactory, Data);
+    vertexBuffers.StaticMeshVertexBuffer.BindLightMapVertexBuffer(&vertexFactory, Data, 0);
+    FColorVertexBuffer::BindDefaultColorVertexBuffer(&vertexFactory, Data, FColorVertexBuffer::NullBindStride::ZeroForDefaultBufferBind);
+
+    vertexFactory.SetData(RHICmdList, Data);
+    vertexFactory.InitResource(RHICmdList);
+}
+
+void FTerrainBufferPage::ReleaseResources()
+{
+    vertexFactory.ReleaseResource();
+    indexBuffer.ReleaseResource();
+    vertexBuffers.PositionVertexBuffer.ReleaseResource();
+    vertexBuffers.StaticMeshVertexBuffer.ReleaseResource();
+}
+
+SIZE_T FTerrainBufferPage::GetGPUBytes() const
+{
+    const SIZE_T vertexBytes = sizeof(FVector3f) + 2 * sizeof(FPackedNormal) + sizeof(FVector2f);
+    return vertexRanges.GetCapacity() * vertexBytes + indexRanges.GetCapacity() * sizeof(uint32);
+}
+
+void FTerrainRenderData::FreePart_RenderThread(const FTerrainPartAllocation& allocation)
+{
+    FTerrainBufferPage& page = *m_pages[allocation.page];
+    page.vertexRanges.Free(allocation.firstVertex, allocation.numVertices);
+    page.indexRanges.Free(allocation.firstIndex, allocation.numIndices);
+}
+
+void FTerrainRenderData::SetPart_RenderThread(
+    FRHICommandListImmediate&   RHICmdList,
+    const FIntPoint&            chunkIndex,
+    const uint32                partIndex,
+    const FTerrainUploadPart&   part
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_WriteParts);
+
+    check(IsInRenderingThread());
+
+    const uint64 startCycles = FPlatformTime::Cycles64();
+
+    FChunk& chunk = m_chunks.FindOrAdd(chunkIndex);
+
+    // A part that gets regenerated replaces its previous allocation
+    if (const FTerrainPartAllocation* previous = chunk.parts.Find(partIndex))
+    {
+        FreePart_RenderThread(*previous);
+        chunk.parts.Remove(partIndex);
+    }
+
+    const uint32 numVertices = part.positions.Num();
+    const uint32 numIndices = part.indices.Num();
+    if (numVertices == 0 || numIndices == 0)
+        return;
+
+    FTerrainPartAllocation allocation;
+    allocation.numVertices = numVertices;
+    allocation.numIndices = numIndices;
+    allocation.bounds = part.bounds;
+
+    for (int32 i = 0; i < m_pages.Num() && allocation.page == INDEX_NONE; i++)
+    {
+        FTerrainBufferPage& page = *m_pages[i];
+
+        if (!page.vertexRanges.Allocate(numVertices, allocation.firstVertex))
+            continue;
+
+        if (!page.indexRanges.Allocate(numIndices, allocation.firstIndex))
+        {
+            page.vertexRanges.Free(allocation.firstVertex, numVertices);
+            continue;
+        }
+
+        allocation.page = i;
+    }
+
+    // Every page is full, so a new one is added. A part bigger than the default page size gets a page of its own size
+    if (allocation.page == INDEX_NONE)
+    {
+        TUniquePtr<FTerrainBufferPage> page = MakeUnique<FTerrainBufferPage>(m_featureLevel);
+        page->InitResources(RHICmdList, FMath::Max(m_pageVertices, numVertices), FMath::Max(m_pageIndices, numIndices));
+
+        verify(page->vertexRanges.Allocate(numVertices, allocation.firstVertex));
+        verify(page->indexRanges.Allocate(numIndices, allocation.firstIndex));
+
+        m_numPages.Increment();
+        m_GPUBytes.Add(page->GetGPUBytes());
+        allocation.page = m_pages.Add(MoveTemp(page));
+    }
+
+    FTerrainBufferPage& page = *m_pages[allocation.page];
+
+    auto WriteBuffer = [&RHICmdList](FRHIBuffer* buffer, const uint32 offsetBytes, const void* source, const uint32 numBytes)
+        {
+            void* destination = RHICmdList.LockBuffer(buffer, offsetBytes, numBytes, RLM_WriteOnly);
+            FMemory::Memcpy(destination, source, numBytes);
+            RHICmdList.UnlockBuffer(buffer);
+        };
+
+    WriteBuffer(page.vertexBuffers.PositionVertexBuffer.VertexBufferRHI.GetReference(),
+        allocation.firstVertex * sizeof(FVector3f), part.positions.GetData(), numVertices * sizeof(FVector3f));
+
+    WriteBuffer(page.vertexBuffers.StaticMeshVertexBuffer.TangentsVertexBuffer.VertexBufferRHI.GetReference(),
+        allocation.firstVertex * 2 * sizeof(FPackedNormal), part.tangents.GetData(), numVertices * 2 * sizeof(FPackedNormal));
+
+    WriteBuffer(page.vertexBuffers.StaticMeshVertexBuffer.TexCoordVertexBuffer.VertexBufferRHI.GetReference(),
+        allocation.firstVertex * sizeof(FVector2f), part.UVs.GetData(), numVertices * sizeof(FVector2f));
+
+    // The indices of the part start at 0, they are moved to where its vertices landed in the page
+    uint32* indices = (uint32*)RHICmdList.LockBuffer(page.indexBuffer.IndexBufferRHI.GetReference(),
+        allocation.firstIndex * sizeof(uint32), numIndices * sizeof(uint32), RLM_WriteOnly);
+
+    for (uint32 i = 0; i < numIndices; i++)
+        indices[i] = part.indices[i] + allocation.firstVertex;
+
+    RHICmdList.UnlockBuffer(page.indexBuffer.IndexBufferRHI.GetReference());
+
+    chunk.parts.Add(partIndex, allocation);
+
+    FTerrainRenderCounters::renderThreadUploadCycles.Add(FPlatformTime::Cycles64() - startCycles);
+}
+
+void FTerrainRenderData::SetVisibleParts_RenderThread(
+    const FIntPoint&            chunkIndex,
+    TArray<uint32>&&            visibleParts
+)
+{
+    check(IsInRenderingThread());
+
+    m_chunks.FindOrAdd(chunkIndex).visibleParts = MoveTemp(visibleParts);
+}
+
+void FTerrainRenderData::RemovePart_RenderThread(
+    const FIntPoint&            chunkIndex,
+    const uint32                partIndex
+)
+{
+    check(IsInRenderingThread());
+
+    FChunk* chunk = m_chunks.Find(chunkIndex);
+    FTerrainPartAllocation allocation;
+    if (!chunk || !chunk->parts.RemoveAndCopyValue(partIndex, allocation))
+        return;
+
+    FreePart_RenderThread(allocation);
+}
+
+void FTerrainRenderData::RemoveChunk_RenderThread(const FIntPoint& chunkIndex)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(FTerrainRenderData::RemoveChunk_RenderThread);
+
+    check(IsInRenderingThread());
+
+    FChunk chunk;
+    if (!m_chunks.RemoveAndCopyValue(chunkIndex, chunk))
+        return;
+
+    for (const TPair<uint32, FTerrainPartAllocation>& part : chunk.parts)
+        FreePart_RenderThread(part.Value);
+}
+
+void FTerrainRenderData::ReleaseResources_RenderThread()
+{
+    check(IsInRenderingThread());
+
+    for (TUniquePtr<FTerrainBufferPage>& page : m_pages)
+        page->ReleaseResources();
+
+    m_pages.Empty();
+    m_chunks.Empty();
+    m_numPages.Reset();
+    m_GPUBytes.Reset();
+}
+
+FTerrainSceneProxy::FTerrainSceneProxy(UTerrainMeshComponent* component, const FTerrainRenderDataPtr& renderData)
+    :   FPrimitiveSceneProxy(component),
+        m_renderData(renderData),
+        m_material(component->GetMaterial(0)),
+        m_materialRelevance(component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+{
+    if (!m_material)
+        m_material = UMaterial::GetDefaultMaterial(MD_Surface);
+}
+
+SIZE_T FTerrainSceneProxy::GetTypeHash() const
+{
+    static size_t UniquePointer;
+    return reinterpret_cast<size_t>(&UniquePointer);
+}
+
+void FTerrainSceneProxy::GetDynamicMeshElements(
+    const TArray<const FSceneView*>&    Views,
+    const FSceneViewFamily&             ViewFamily,
+    uint32                              VisibilityMap,
+    FMeshElementCollector&              Collector
+) const
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_GatherMeshBatches);
+
+    const uint64 startCycles = FPlatformTime::Cycles64();
+
+    // Every part shares the transform of the terrain, so they all read the same primitive uniform buffer
+    bool bHasPrecomputedVolumetricLightmap;
+    FMatrix PreviousLocalToWorld;
+    int32 SingleCaptureIndex;
+    bool bOutputVelocity;
+    GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
+    bOutputVelocity |= AlwaysHasVelocity();
+
+    FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+    DynamicPrimitiveUniformBuffer.Set(Collector.GetRHICommandList(), GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), GetLocalBounds(),
+        true, bHasPrecomputedVolumetricLightmap, bOutputVelocity, GetCustomPrimitiveData());
+
+    const FMaterialRenderProxy* MaterialProxy = m_material->GetRenderProxy();
+    const FMatrix& LocalToWorld = GetLocalToWorld();
+    int64 emitted = 0;
+
+    for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+    {
+        if (!(VisibilityMap & (1 << ViewIndex)))
+            continue;
+
+        const FSceneView* View = Views[ViewIndex];
+
+        m_renderData->ForEachVisiblePart([&](const FTerrainBufferPage& page, const FTerrainPartAllocation& allocation)
+            {
+                const FBox WorldBounds = FBox(allocation.bounds).TransformBy(LocalToWorld);
+                if (!View->ViewFrustum.IntersectBox(WorldBounds.GetCenter(), WorldBounds.GetExtent()))
+                    return;
+
+                FMeshBatch& Mesh = Collector.AllocateMesh();
+                Mesh.VertexFactory = &page.vertexFactory;
+                Mesh.MaterialRenderProxy = MaterialProxy;
+                Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+                Mesh.Type = PT_TriangleList;
+                Mesh.DepthPriorityGroup = SDPG_World;
+                Mesh.bCanApplyViewModeOverrides = false;
+
+                FMeshBatchElement& BatchElement = Mesh.Elements[0];
+                BatchElement.IndexBuffer = &page.indexBuffer;
+                BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+                SetDrawRange(BatchElement, allocation);
+
+                Collector.AddMesh(ViewIndex, Mesh);
+                emitted++;
+            });
+    }
+
+    FTerrainRenderCounters::drawRanges.Add(emitted);
+    FTerrainRenderCounters::renderThreadGatherCycles.Add(FPlatformTime::Cycles64() - startCycles);
+}
+
+void FTerrainSceneProxy::SetDrawRange(
+    FMeshBatchElement&                  element,
+    const FTerrainPartAllocation&       allocation
+)
+{
+    element.FirstIndex = allocation.firstIndex;
+    element.NumPrimitives = allocation.numIndices / 3;
+    element.MinVertexIndex = allocation.firstVertex;
+    element.MaxVertexIndex = allocation.firstVertex + allocation.numVertices - 1;
+}
+
+FPrimitiveViewRelevance FTerrainSceneProxy::GetViewRelevance(const FSceneView* View) const
+{
+    FPrimitiveViewRelevance Result;
+    Result.bDrawRelevance = IsShown(View);
+    Result.bShadowRelevance = IsShadowCast(View);
+    Result.bDynamicRelevance = true;
+    Result.bRenderInMainPass = ShouldRenderInMainPass();
+    Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+    Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+    Result.bTranslucentSelfShadow = bCastVolumetricTranslucentShadow;
+    m_materialRelevance.SetPrimitiveViewRelevance(Result);
+    Result.bVelocityRelevance = DrawsVelocity() && Result.bOpaque && Result.bRenderInMainPass;
+    return Result;
+}
@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PrimitiveSceneProxy.h"
+#include "LocalVertexFactory.h"
+#include "RenderResource.h"
+#include "Rendering/StaticMeshVertexBuffer.h"
+#include "Rendering/PositionVertexBuffer.h"
+#include "Rendering/ColorVertexBuffer.h"
+#include "StaticMeshResources.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Materials/MaterialRelevance.h"
+
+class UTerrainMeshComponent;
+
+// Timings and counts of the terrain rendering, for whichever path the terrain uses. They are read and reset from the game thread
+struct FTerrainRenderCounters
+{
+    static FThreadSafeCounter64     gameThreadUploadCycles;         //  Creating the sections, or converting and enqueueing the parts
+    static FThreadSafeCounter64     gameThreadVisibilityCycles;     //  Showing and hiding the sections, or sending the visible parts
+    static FThreadSafeCounter64     renderThreadUploadCycles;       //  Writing the parts into the GPU pages, terrain proxy only
+    static FThreadSafeCounter64     renderThreadGatherCycles;       //  Building the mesh batches of the visible parts, terrain proxy only
+    static FThreadSafeCounter64     uploadedParts;
+    static FThreadSafeCounter64     visibilityUpdates;              //  Sections, or parts, whose visibility changed
+    static FThreadSafeCounter64     drawRanges;                     //  Mesh batches emitted by the terrain proxy
+
+    // Visibility changes per frame, only touched by the game thread
+    static uint64                   sectionChangesFrame;
+    static int32                    sectionChangesThisFrame;
+    static int32                    maxSectionChangesPerFrame;
+    static int64                    framesWithSectionChanges;
+
+    static void AddSectionChanges(const int32 changes);
+
+    static void Reset();
+};
+
+// First fit allocator of [offset, offset + count) ranges inside a fixed capacity, freed ranges are merged with their neighbours
+class FTerrainRangeAllocator
+{
+private:
+    struct FRange
+    {
+        uint32      offset;
+        uint32      count;
+    };
+
+    TArray<FRange>      m_free;             //  Sorted by offset
+    uint32              m_capacity = 0;
+    uint32              m_used = 0;
+
+public:
+    void Initialize(const uint32 capacity);
+
+    // Returns false if no free range is large enough
+    bool Allocate(const uint32 count, uint32& outOffset);
+
+    void Free(const uint32 offset, const uint32 count);
+
+    FORCEINLINE uint32 GetCapacity() const { return m_capacity; }
+    FORCEINLINE uint32 GetUsed() const { return m_used; }
+};
+
+class FTerrainIndexBuffer : public FIndexBuffer
+{
+public:
+    uint32              capacity = 0;
+
+    virtual void InitRHI(FRHICommandListBase& RHICmdList) override;
+};
+
+// One pooled set of GPU buffers, chunk parts are sub-allocated inside of it and drawn as ranges of its index buffer
+struct FTerrainBufferPage
+{
+    FStaticMeshVertexBuffers        vertexBuffers;
+    FTerrainIndexBuffer             indexBuffer;
+    FLocalVertexFactory             vertexFactory;
+    FTerrainRangeAllocator          vertexRanges;
+    FTerrainRangeAllocator          indexRanges;
+
+    FTerrainBufferPage(const ERHIFeatureLevel::Type featureLevel) : vertexFactory(featureLevel, "FTerrainBufferPage") {}
+
+    void InitResources(
+        FRHICommandListBase&        RHICmdList,
+        const uint32                vertexCapacity,
+        const uint32                indexCapacity
+    );
+
+    void ReleaseResources();
+
+    SIZE_T GetGPUBytes() const;
+};
+
+// A chunk part converted into the vertex layout of the pages, ready to be copied by the render thread
+struct FTerrainUploadPart
+{
+    TArray<FVector3f>               positions;
+    TArray<FPackedNormal>           tangents;           //  TangentX and TangentZ of every vertex, the layout of the static mesh vertex buffer
+    TArray<FVector2f>               UVs;
+    TArray<uint32>                  indices;            //  Relative to the first vertex of the part
+    FBox3f                          bounds;
+};
+
+// Where a chunk part lives inside the pages
+struct FTerrainPartAllocation
+{
+    int32                           page = INDEX_NONE;
+    uint32                          firstVertex = 0;
+    uint32                          numVertices = 0;
+    uint32                          firstIndex = 0;
+    uint32                          numIndices = 0;
+    FBox3f                          bounds;
+};
+
+// Every GPU allocation of the terrain, and which parts of which chunks are visible. It outlives the scene proxies,
+// so a proxy recreated by the engine keeps drawing the same data. Only touched by the render thread
+class FTerrainRenderData
+{
+private:
+    struct FChunk
+    {
+        TMap<uint32, FTerrainPartAllocation>    parts;          //  Section index of the part
+        TArray<uint32>                          visibleParts;
+    };
+
+    ERHIFeatureLevel::Type                      m_featureLevel;
+    uint32                                      m_pageVertices;
+    uint32                                      m_pageIndices;
+    TArray<TUniquePtr<FTerrainBufferPage>>      m_pages;
+    TMap<FIntPoint, FChunk>                     m_chunks;
+
+    FThreadSafeCounter                          m_numPages;         //  Mirrors of the pages, so the game thread can read them
+    FThreadSafeCounter64                        m_GPUBytes;
+
+    void FreePart_RenderThread(const FTerrainPartAllocation& allocation);
+
+public:
+    FTerrainRenderData(const ERHIFeatureLevel::Type featureLevel, const uint32 pageVertices, const uint32 pageIndices)
+        :   m_featureLevel(featureLevel),
+            m_pageVertices(pageVertices),
+            m_pageIndices(pageIndices)
+    {}
+
+    void SetPart_RenderThread(
+        FRHICommandListImmediate&   RHICmdList,
+        const FIntPoint&            chunkIndex,
+        const uint32                partIndex,
+        const FTerrainUploadPart&   part
+    );
+
+    void SetVisibleParts_RenderThread(
+        const FIntPoint&            chunkIndex,
+        TArray<uint32>&&            visibleParts
+    );
+
+    void RemovePart_RenderThread(
+        const FIntPoint&            chunkIndex,
+        const uint32                partIndex
+    );
+
+    void RemoveChunk_RenderThread(const FIntPoint& chunkIndex);
+
+    void ReleaseResources_RenderThread();
+
+    // Calls visitor(page, allocation) for every visible part
+    template<typename FVisitor>
+    void ForEachVisiblePart(FVisitor&& visitor) const
+    {
+        for (const TPair<FIntPoint, FChunk>& chunk : m_chunks)
+        {
+            for (const uint32 partIndex : chunk.Value.visibleParts)
+            {
+                const FTerrainPartAllocation* allocation = chunk.Value.parts.Find(partIndex);
+                if (allocation)
+                    visitor(*m_pages[allocation->page], *allocation);
+            }
+        }
+    }
+
+    FORCEINLINE int32 GetNumPages() const { return m_numPages.GetValue(); }
+
+    FORCEINLINE int64 GetGPUBytes() const { return m_GPUBytes.GetValue(); }
+};
+
+typedef TSharedPtr<FTerrainRenderData, ESPMode::ThreadSafe> FTerrainRenderDataPtr;
+
+// Draws every visible chunk part of the terrain as a range of a pooled buffer, instead of one mesh section per part
+class FTerrainSceneProxy final : public FPrimitiveSceneProxy
+{
+private:
+    FTerrainRenderDataPtr           m_renderData;
+    UMaterialInterface*             m_material;
+    FMaterialRelevance              m_materialRelevance;
+
+public:
+    FTerrainSceneProxy(UTerrainMeshComponent* component, const FTerrainRenderDataPtr& renderData);
+
+    virtual SIZE_T GetTypeHash() const override;
+
+    virtual void GetDynamicMeshElements(
+        const TArray<const FSceneView*>&    Views,
+        const FSceneViewFamily&             ViewFamily,
+        uint32                              VisibilityMap,
+        FMeshElementCollector&              Collector
+    ) const override;
+
+    virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
+
+    virtual bool CanBeOccluded() const override { return !m_materialRelevance.bDisableDepthTest; }
+
+    virtual uint32 GetMemoryFootprint() const override { return sizeof(*this) + GetAllocatedSize(); }
+
+    FORCEINLINE const FTerrainRenderDataPtr& GetRenderData() const { return m_renderData; }
+
+    // The range of the page a part is drawn from, the indices of a part point at its vertices in the page
+    static void SetDrawRange(
+        FMeshBatchElement&                  element,
+        const FTerrainPartAllocation&       allocation
+    );
+};
@@ -1,50 +1,282 @@
 ﻿#include "ChunkFunctionLibrary.h"
 #include "ProceduralMeshComponent.h"
-#include "KismetProceduralMeshLibrary.h"
+#include "../Structures/MeshTopology.h"
+#include "../ProceduralTerrain.h"
 
-float		UChunkFunctionLibrary::m_noiseScale         = 0.0001f;
-float		UChunkFunctionLibrary::m_heightMultiplier   = 2500;
-float		UChunkFunctionLibrary::m_chunkWidth         = 12800;
-float       UChunkFunctionLibrary::m_UVScale            = 0.1;
-uint8       UChunkFunctionLibrary::m_maxLOD             = 8;
+FTerrainSettingsPtr UChunkFunctionLibrary::m_settings;
+FCriticalSection    UChunkFunctionLibrary::m_settingsLock;
+
+FTerrainSettingsPtr UChunkFunctionLibrary::GetSettings()
+{
+    FScopeLock lock(&m_settingsLock);
+
+    // Nothing has been set yet, so the heights come from the default graph with the default settings
+    if (!m_settings.IsValid())
+        m_settings = FTerrainSettings::Make(FTerrainSettings());
+
+    return m_settings;
+}
+
+bool UChunkFunctionLibrary::UpdateSettings(
+    TFunctionRef<void(FTerrainSettings&)>   change,
+    FString*                                outError
+)
+{
+    // Held through the whole update, so two setters called together don't drop each other's change
+    FScopeLock lock(&m_settingsLock);
+
+    FTerrainSettings settings = m_settings.IsValid() ? *m_settings : FTerrainSettings();
+    change(settings);
+
+    // The jobs that started with the previous snapshot keep it, only the next ones see this one
+    FTerrainSettingsPtr snapshot = FTerrainSettings::Make(MoveTemp(settings), outError);
+    if (!snapshot.IsValid())
+        return false;
+
+    m_settings = snapshot;
+    return true;
+}
+
+void UChunkFunctionLibrary::SetTerrainGenerationSettings(
+    const float         chunkWidth,
+    const float         noiseScale,
+    const float         heightMultiplier,
+    const float         UVScale,
+    const uint8         maxLOD
+)
+{
+    UpdateSettings([&](FTerrainSettings& settings)
+        {
+            settings.chunkWidth = chunkWidth;
+            settings.noiseScale = noiseScale;
+            settings.heightMultiplier = heightMultiplier;
+            settings.UVScale = UVScale;
+            settings.maxLOD = FMath::Min(maxLOD, FTerrainSettings::MaxSupportedLOD);
+            settings.noiseProgram = nullptr;        // The frequencies of the program depend on the noise scale
+        });
+}
+
+// Index in the additionals grid of the vertex that is alongEdge vertices along the border and inward vertices away from it
+template<Direction Dir>
+static FORCEINLINE int32 GetBorderSourceIndex(const int32 alongEdge, const int32 inward, const int32 dataWidth)
+{
+    if constexpr (Dir == Direction::Up)         return inward * dataWidth + alongEdge;
+    else if constexpr (Dir == Direction::Down)  return (dataWidth - 1 - inward) * dataWidth + alongEdge;
+    else if constexpr (Dir == Direction::Left)  return alongEdge * dataWidth + inward;
+    else                                        return alongEdge * dataWidth + (dataWidth - 1 - inward);
+}
+
+// The two rows a border keeps out of its temp rows: the second one without its ends, and the third one without two vertices
+// on each side. The temp rows around them are only there as the padding of the grid normal kernel
+static FMeshData GetBorderRows(
+    const TArray<FVector>&  Rows,
+    const int32             realWidth,
+    const uint8             LOD,
+    const Direction         dir
+)
+{
+    FMeshData Final(FVector2D(realWidth, 2), true, false);
+
+    Final.vertices.Append(Rows.GetData() + realWidth + 1, realWidth - 2);
+    Final.vertices.Append(Rows.GetData() + 2 * realWidth + 2, realWidth - 4);
+
+    Final.normals.SetNumUninitialized(Final.vertices.Num());
+    Final.tangents.SetNumUninitialized(Final.vertices.Num());
+
+    UMeshStaticLibrary::CalculateGridNormalsAndTangents(
+        Rows.GetData(), realWidth, 1, 1, realWidth - 1, 2,
+        Final.normals.GetData(), Final.tangents.GetData());
+
+    UMeshStaticLibrary::CalculateGridNormalsAndTangents(
+        Rows.GetData(), realWidth, 2, 2, realWidth - 2, 3,
+        Final.normals.GetData() + (realWidth - 2), Final.tangents.GetData() + (realWidth - 2));
+
+    Final.topology = FMeshTopologyCache::Get().Find(LOD, dir);
+
+    return Final;
+}
+
+// Builds the normal and the downscaled variants of one border, either output can be null.
+// Both variants read the same four temp rows, and the downscaled one only differs by the odd vertices of the chunk edge,
+// so it reuses everything the normal one computed except for the normals and tangents these vertices touch
+template<Direction Dir>
+static void BuildBorderVariants(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    FMeshData*              outNormal,
+    FMeshData*              outDownscaled
+)
+{
+    const int32 dataWidth = (1 << sourceLOD) + 3;
+    const int32 step = (1 << (sourceLOD - LOD));
+    const int32 realWidth = (1 << LOD) + 3;
+
+    // Row 0 is the halo ring, row 1 the edge of the chunk, the next ones go inward one LOD cell at a time.
+    // Along the edge, the first and last vertices are on the halo ring too
+    TArray<FVector> Rows;
+    Rows.SetNumUninitialized(4 * realWidth);
+
+    for (int32 Row = 0; Row < 4; Row++)
+    {
+        const int32 inward = (Row == 0) ? 0 : 1 + (Row - 1) * step;
+        FVector* Dest = Rows.GetData() + Row * realWidth;
+
+        Dest[0] = wholeChunk_additionalsVerts[GetBorderSourceIndex<Dir>(0, inward, dataWidth)];
+
+        for (int32 Col = 1; Col < realWidth - 1; Col++)
+            Dest[Col] = wholeChunk_additionalsVerts[GetBorderSourceIndex<Dir>(1 + (Col - 1) * step, inward, dataWidth)];
+
+        Dest[realWidth - 1] = wholeChunk_additionalsVerts[GetBorderSourceIndex<Dir>(dataWidth - 1, inward, dataWidth)];
+    }
+
+    FMeshData Normal = GetBorderRows(Rows, realWidth, LOD, Dir);
+
+    if (outDownscaled)
+    {
+        // The coarser neighbour has no vertex on every other column of the edge, so these sit halfway between their neighbours
+        FVector* Edge = Rows.GetData() + realWidth;
+        for (int32 Col = 2; Col < realWidth - 2; Col += 2)
+            Edge[Col] = 0.5f * (Edge[Col - 1] + Edge[Col + 1]);
+
+        FMeshData Downscaled = outNormal ? FMeshData(Normal) : MoveTemp(Normal);
+
+        for (int32 Col = 2; Col < realWidth - 2; Col += 2)
+            Downscaled.vertices[Col - 1] = Edge[Col];
+
+        // Every edge vertex reads a moved one, while the next row only does right under them
+        UMeshStaticLibrary::CalculateGridNormalsAndTangents(
+            Rows.GetData(), realWidth, 1, 1, realWidth - 1, 2,
+            Downscaled.normals.GetData(), Downscaled.tangents.GetData());
+
+        for (int32 Col = 2; Col < realWidth - 2; Col += 2)
+        {
+            const int32 FinalIndx = (realWidth - 2) + (Col - 2);
+            UMeshStaticLibrary::GetGridNormalAndTangent(
+                Rows.GetData(), realWidth, 2 * realWidth + Col,
+                Downscaled.normals[FinalIndx], Downscaled.tangents[FinalIndx]);
+        }
+
+        *outDownscaled = MoveTemp(Downscaled);
+    }
+
+    if (outNormal)
+        *outNormal = MoveTemp(Normal);
+}
+
+void UChunkFunctionLibrary::GetChunkData_Borders(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    FChunkLodData&          outData
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_BorderMeshes);
+
+    BuildBorderVariants<Direction::Up>(wholeChunk_additionalsVerts, sourceLOD, LOD,
+        &outData.borders_normal[static_cast<uint8>(Direction::Up)], &outData.borders_downscaled[static_cast<uint8>(Direction::Up)]);
+    BuildBorderVariants<Direction::Down>(wholeChunk_additionalsVerts, sourceLOD, LOD,
+        &outData.borders_normal[static_cast<uint8>(Direction::Down)], &outData.borders_downscaled[static_cast<uint8>(Direction::Down)]);
+    BuildBorderVariants<Direction::Left>(wholeChunk_additionalsVerts, sourceLOD, LOD,
+        &outData.borders_normal[static_cast<uint8>(Direction::Left)], &outData.borders_downscaled[static_cast<uint8>(Direction::Left)]);
+    BuildBorderVariants<Direction::Right>(wholeChunk_additionalsVerts, sourceLOD, LOD,
+        &outData.borders_normal[static_cast<uint8>(Direction::Right)], &outData.borders_downscaled[static_cast<uint8>(Direction::Right)]);
+}
 
 FMeshData UChunkFunctionLibrary::GetChunkData_Border_Up(
-    const TArray<FVector>&  wholeChunk_additionalsVerts, 
-    const uint8             LOD, 
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
     const bool              downscale
 )
 {
-    const int32 dataWidth = (1 << m_maxLOD) + 3;
-    const int32 step = (1 << (m_maxLOD - LOD));
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetChunkData_Border_Up);
+
+    FMeshData Final;
+    BuildBorderVariants<Direction::Up>(wholeChunk_additionalsVerts, sourceLOD, LOD, downscale ? nullptr : &Final, downscale ? &Final : nullptr);
+    return Final;
+}
+
+FMeshData UChunkFunctionLibrary::GetChunkData_Border_Down(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    const bool              downscale
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetChunkData_Border_Down);
+
+    FMeshData Final;
+    BuildBorderVariants<Direction::Down>(wholeChunk_additionalsVerts, sourceLOD, LOD, downscale ? nullptr : &Final, downscale ? &Final : nullptr);
+    return Final;
+}
+
+FMeshData UChunkFunctionLibrary::GetChunkData_Border_Left(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    const bool              downscale
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetChunkData_Border_Left);
+
+    FMeshData Final;
+    BuildBorderVariants<Direction::Left>(wholeChunk_additionalsVerts, sourceLOD, LOD, downscale ? nullptr : &Final, downscale ? &Final : nullptr);
+    return Final;
+}
+
+FMeshData UChunkFunctionLibrary::GetChunkData_Border_Right(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    const bool              downscale
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetChunkData_Border_Right);
+
+    FMeshData Final;
+    BuildBorderVariants<Direction::Right>(wholeChunk_additionalsVerts, sourceLOD, LOD, downscale ? nullptr : &Final, downscale ? &Final : nullptr);
+    return Final;
+}
+
+// The per-direction builders GetChunkData_Borders replaced, only kept as the baseline of BenchmarkBorderBuilders. Each call
+// gathers its own temp mesh and computes all of its normals, the downscaled variant gets none of the normal one's work
+
+static FMeshData BuildSeparateBorder_Up(
+    const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
+    const uint8             LOD,
+    const bool              downscale
+)
+{
+    const int32 dataWidth = (1 << sourceLOD) + 3;
+    const int32 step = (1 << (sourceLOD - LOD));
     const int32 realWidth = (1 << LOD) + 3;
     const int32 edge = step * 3 + 1;
 
     FMeshData Mesh(
         FVector2D(realWidth, 4),
+        false,
         false
     );
 
     int32 realIndx = 1;
 
     Mesh.vertices.Add(wholeChunk_additionalsVerts[0]);
-    Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[0].X, wholeChunk_additionalsVerts[0].Y) * m_UVScale);
 
-    // The first now, we only add verices and UVs, we don't create triangles
+    // The first row, we only add its vertices
     for (int32 X = 1; X < dataWidth - 1; X += step)
     {
         Mesh.vertices.Add(wholeChunk_additionalsVerts[X]);
-        Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[X].X, wholeChunk_additionalsVerts[X].Y) * m_UVScale);
     }
 
     Mesh.vertices.Add(wholeChunk_additionalsVerts[dataWidth - 1]);
-    Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[dataWidth - 1].X, wholeChunk_additionalsVerts[dataWidth - 1].Y) * m_UVScale);
 
 
     // In the lower parts, we add a vertice, and then, in the inner loop, we add vertice and two corresponding triangle too
     for (int32 Y = 1; Y <= edge; Y += step)
     {
         Mesh.vertices.Add(wholeChunk_additionalsVerts[Y * dataWidth]);
-        Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[Y * dataWidth].X, wholeChunk_additionalsVerts[Y * dataWidth].Y) * m_UVScale);
 
         for (int32 X = 1; X < dataWidth - 1; X += step)
         {
@@ -62,89 +294,36 @@ FMeshData UChunkFunctionLibrary::GetChunkData_Border_Up(
                         wholeChunk_additionalsVerts[Y * dataWidth + Rx]);
 
                 Mesh.vertices.Add(V);
-                Mesh.UVs.Add(FVector2D(V.X, V.Y) * m_UVScale);
             }
             else
             {
                 Mesh.vertices.Add(wholeChunk_additionalsVerts[Indx]);
-                Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[Indx].X, wholeChunk_additionalsVerts[Indx].Y) * m_UVScale);
             }
         }
 
         Mesh.vertices.Add(wholeChunk_additionalsVerts[(dataWidth - 1) + Y * dataWidth]);
-        Mesh.UVs.Add(FVector2D(wholeChunk_additionalsVerts[(dataWidth - 1) + Y * dataWidth].X, wholeChunk_additionalsVerts[(dataWidth - 1) + Y * dataWidth].Y) * m_UVScale);
-    }
-
-    for (int32 i = 1; i < 4; i++)
-    {
-        for (int32 j = 1; j < realWidth; j++)
-        {
-            const int32 B = (i - 1) * realWidth + j;
-            const int32 C = B - 1;
-            const int32 D = i * realWidth + j - 1;
-            const int32 A = D + 1;
-    
-            Mesh.triangles.Append({ A, B, C, A, C, D });
-        }
-    }
-
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(
-        Mesh.vertices,
-        Mesh.triangles,
-        Mesh.UVs,
-        Mesh.normals,
-        Mesh.tangents
-    );
-
-    FMeshData Final = FMeshData(FVector2D(realWidth, 2), true);
-
-    for (int32 i = realWidth + 1; i < 2 * realWidth - 1; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
     }
 
-    for (int32 i = 2 * realWidth + 2; i < 3 * realWidth - 2; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
-    }
-
-    for (int32 i = realWidth - 2; i < 2 * realWidth - 7; i++)
-    {
-        const int32 A = i - (realWidth - 3);
-        const int32 B = A + 1;
-        const int32 C = i;
-
-        Final.triangles.Append({ C, i + 1, B, A, C, B });
-    }
-
-    Final.triangles.Append({ 1, 0, realWidth - 2, realWidth -3, realWidth-4, 2 * realWidth - 7 });
-
-    return Final;
+    return GetBorderRows(Mesh.vertices, realWidth, LOD, Direction::Up);
 }
 
-FMeshData UChunkFunctionLibrary::GetChunkData_Border_Down(
+static FMeshData BuildSeparateBorder_Down(
     const TArray<FVector>&  wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
     const uint8             LOD,
     const bool              downscale
 )
 {
-    const int32 dataWidth = (1 << m_maxLOD) + 3;
-    const int32 step = (1 << (m_maxLOD - LOD));
+    const int32 dataWidth = (1 << sourceLOD) + 3;
+    const int32 step = (1 << (sourceLOD - LOD));
     const int32 realWidth = (1 << LOD) + 3;
     const int32 edge = step * 3 + 1;
 
-    FMeshData Mesh(FVector2D(realWidth, 4), false);
+    FMeshData Mesh(FVector2D(realWidth, 4), false, false);
 
     auto AddVU = [&](const FVector& V)
         {
             Mesh.vertices.Add(V);
-            Mesh.UVs.Add(FVector2D(V.X, V.Y) * m_UVScale);
         };
 
     // LocalY goes "upward from bottom border" (0..edge) -> SrcY goes (dataWidth-1 .. downwards)
@@ -202,80 +381,26 @@ FMeshData UChunkFunctionLibrary::GetChunkData_Border_Down(
         AddVU(wholeChunk_additionalsVerts[SrcY * dataWidth + (dataWidth - 1)]);
     }
 
-    for (int32 i = 1; i < 4; i++)
-    {
-        for (int32 j = 1; j < realWidth; j++)
-        {
-            const int32 B = (i - 1) * realWidth + j;
-            const int32 C = B - 1;
-            const int32 D = i * realWidth + j - 1;
-            const int32 A = D + 1;
-
-            // reversed winding vs Up
-            Mesh.triangles.Append({ A, C, B,  A, D, C });
-        }
-    }
-
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(
-        Mesh.vertices,
-        Mesh.triangles,
-        Mesh.UVs,
-        Mesh.normals,
-        Mesh.tangents
-    );
-
-    FMeshData Final(FVector2D(realWidth, 2), true);
-
-    for (int32 i = realWidth + 1; i < 2 * realWidth - 1; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
-    }
-
-    for (int32 i = 2 * realWidth + 2; i < 3 * realWidth - 2; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
-    }
-
-    for (int32 i = realWidth - 2; i < 2 * realWidth - 7; i++)
-    {
-        const int32 A = i - (realWidth - 3);
-        const int32 B = A + 1;
-        const int32 C = i;
-
-        Final.triangles.Append({ C, B, i + 1,  A, B, C });
-    }
-
-    Final.triangles.Append({
-        1, realWidth - 2, 0,
-        realWidth - 3, 2 * realWidth - 7, realWidth - 4
-        });
-
-    return Final;
+    return GetBorderRows(Mesh.vertices, realWidth, LOD, Direction::Down);
 }
 
-FMeshData UChunkFunctionLibrary::GetChunkData_Border_Left(
+static FMeshData BuildSeparateBorder_Left(
     const TArray<FVector>& wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
     const uint8            LOD,
     const bool             downscale
 )
 {
-    const int32 dataWidth = (1 << m_maxLOD) + 3;
-    const int32 step = (1 << (m_maxLOD - LOD));
+    const int32 dataWidth = (1 << sourceLOD) + 3;
+    const int32 step = (1 << (sourceLOD - LOD));
     const int32 realWidth = (1 << LOD) + 3;
     const int32 edge = step * 3 + 1;
 
-    FMeshData Mesh(FVector2D(realWidth, 4), false);
+    FMeshData Mesh(FVector2D(realWidth, 4), false, false);
 
     auto AddVU = [&](const FVector& V)
         {
             Mesh.vertices.Add(V);
-            Mesh.UVs.Add(FVector2D(V.X, V.Y) * m_UVScale);
         };
 
     // LocalX goes "rightward from left border" (0..edge) -> SrcX is the same
@@ -333,81 +458,26 @@ FMeshData UChunkFunctionLibrary::GetChunkData_Border_Left(
         AddVU(wholeChunk_additionalsVerts[(dataWidth - 1) * dataWidth + SrcX]);
     }
 
-    // NOTE: winding flipped (your triangles were reversed)
-    for (int32 i = 1; i < 4; i++)
-    {
-        for (int32 j = 1; j < realWidth; j++)
-        {
-            const int32 B = (i - 1) * realWidth + j;
-            const int32 C = B - 1;
-            const int32 D = i * realWidth + j - 1;
-            const int32 A = D + 1;
-
-            Mesh.triangles.Append({ A, C, B,  A, D, C });
-        }
-    }
-
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(
-        Mesh.vertices,
-        Mesh.triangles,
-        Mesh.UVs,
-        Mesh.normals,
-        Mesh.tangents
-    );
-
-    FMeshData Final(FVector2D(realWidth, 2), true);
-
-    for (int32 i = realWidth + 1; i < 2 * realWidth - 1; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
-    }
-
-    for (int32 i = 2 * realWidth + 2; i < 3 * realWidth - 2; i++)
-    {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
-    }
-
-    // NOTE: winding flipped (your triangles were reversed)
-    for (int32 i = realWidth - 2; i < 2 * realWidth - 7; i++)
-    {
-        const int32 A = i - (realWidth - 3);
-        const int32 B = A + 1;
-        const int32 C = i;
-
-        Final.triangles.Append({ C, B, i + 1,  A, B, C });
-    }
-
-    Final.triangles.Append({
-        1, realWidth - 2, 0,
-        realWidth - 3, 2 * realWidth - 7, realWidth - 4
-        });
-
-    return Final;
+    return GetBorderRows(Mesh.vertices, realWidth, LOD, Direction::Left);
 }
 
-FMeshData UChunkFunctionLibrary::GetChunkData_Border_Right(
+static FMeshData BuildSeparateBorder_Right(
     const TArray<FVector>& wholeChunk_additionalsVerts,
+    const uint8             sourceLOD,
     const uint8            LOD,
     const bool             downscale
 )
 {
-    const int32 dataWidth = (1 << m_maxLOD) + 3;
-    const int32 step = (1 << (m_maxLOD - LOD));
+    const int32 dataWidth = (1 << sourceLOD) + 3;
+    const int32 step = (1 << (sourceLOD - LOD));
     const int32 realWidth = (1 << LOD) + 3;
     const int32 edge = step * 3 + 1;
 
-    FMeshData Mesh(FVector2D(realWidth, 4), false);
+    FMeshData Mesh(FVector2D(realWidth, 4), false, false);
 
     auto AddVU = [&](const FVector& V)
         {
             Mesh.vertices.Add(V);
-            Mesh.UVs.Add(FVector2D(V.X, V.Y) * m_UVScale);
         };
 
     // LocalX goes "leftward from right border" (0..edge) -> SrcX goes (dataWidth-1 .. downwards)
@@ -465,147 +535,437 @@ FMeshData UChunkFunctionLibrary::GetChunkData_Border_Right(
         AddVU(wholeChunk_additionalsVerts[(dataWidth - 1) * dataWidth + SrcX]);
     }
 
-    // NOTE: winding flipped back (your triangles were reversed)
-    for (int32 i = 1; i < 4; i++)
+    return GetBorderRows(Mesh.vertices, realWidth, LOD, Direction::Right);
+}
+
+FBorderBuilderTimings UChunkFunctionLibrary::BenchmarkBorderBuilders(
+    const uint8             LOD,
+    const int32             iterations
+)
+{
+    const FTerrainSettingsPtr settings = GetSettings();
+    const uint8 maxLOD = settings->maxLOD;
+
+    FBorderBuilderTimings timings;
+    timings.LOD = FMath::Clamp<uint8>(LOD, 2, maxLOD);
+    timings.iterations = FMath::Max(iterations, 1);
+
+    const FVector2D Pos = FVector2D::ZeroVector;
+    const FHeightfieldPtr heightfield = GetTopLod_Heightfield(*settings, Pos);
+    const TArray<FVector> additionals = GetLod_Additionals_Vertices(*settings, heightfield->heights, heightfield->level, Pos, maxLOD, maxLOD);
+
+    // Eight separate builds per job, the way GenerateChunkData_LOD used to call them
+    double start = FPlatformTime::Seconds();
+    for (int32 i = 0; i < timings.iterations; i++)
+    {
+        FChunkLodData data;
+        for (const bool downscale : { false, true })
+        {
+            FMeshData* Borders = downscale ? data.borders_downscaled : data.borders_normal;
+            Borders[static_cast<uint8>(Direction::Up)] = BuildSeparateBorder_Up(additionals, maxLOD, timings.LOD, downscale);
+            Borders[static_cast<uint8>(Direction::Down)] = BuildSeparateBorder_Down(additionals, maxLOD, timings.LOD, downscale);
+            Borders[static_cast<uint8>(Direction::Left)] = BuildSeparateBorder_Left(additionals, maxLOD, timings.LOD, downscale);
+            Borders[static_cast<uint8>(Direction::Right)] = BuildSeparateBorder_Right(additionals, maxLOD, timings.LOD, downscale);
+        }
+    }
+    timings.separateSecondsPerJob = (FPlatformTime::Seconds() - start) / timings.iterations;
+
+    start = FPlatformTime::Seconds();
+    for (int32 i = 0; i < timings.iterations; i++)
+    {
+        FChunkLodData data;
+        GetChunkData_Borders(additionals, maxLOD, timings.LOD, data);
+    }
+    timings.fusedSecondsPerJob = (FPlatformTime::Seconds() - start) / timings.iterations;
+
+    return timings;
+}
+
+bool UChunkFunctionLibrary::SetNoiseGraph(const FNoiseGraph& graph)
+{
+    FString error;
+    const bool compiled = UpdateSettings([&graph](FTerrainSettings& settings)
+        {
+            settings.noiseGraph = graph;
+            settings.noiseProgram = nullptr;
+        }, &error);
+
+    if (!compiled)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Invalid noise graph, keeping the previous one: %s"), *error);
+        return false;
+    }
+    return true;
+}
+
+void UChunkFunctionLibrary::SetNoiseProfiling(const bool enabled)
+{
+    FNoiseProgram::SetProfiling(enabled);
+}
+
+TArray<FNoiseNodeTiming> UChunkFunctionLibrary::GetNoiseNodeTimings()
+{
+    return GetNoiseProgram()->GetNodeTimings();
+}
+
+void UChunkFunctionLibrary::ResetNoiseNodeTimings()
+{
+    GetNoiseProgram()->ResetNodeTimings();
+}
+
+void UChunkFunctionLibrary::SampleHeights(
+    const FTerrainSettings& settings,
+    const FVector2D*    positions,
+    float*              outZ,
+    const int32         num,
+    float*              outGradX,
+    float*              outGradY
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::SampleHeights);
+
+    settings.noiseProgram->Evaluate(positions, outZ, num, outGradX, outGradY);
+
+    for (int32 i = 0; i < num; i++)
+        outZ[i] *= settings.heightMultiplier;
+
+    if (outGradX && outGradY)
     {
-        for (int32 j = 1; j < realWidth; j++)
+        for (int32 i = 0; i < num; i++)
         {
-            const int32 B = (i - 1) * realWidth + j;
-            const int32 C = B - 1;
-            const int32 D = i * realWidth + j - 1;
-            const int32 A = D + 1;
+            outGradX[i] *= settings.heightMultiplier;
+            outGradY[i] *= settings.heightMultiplier;
+        }
+    }
+}
+
+void UChunkFunctionLibrary::SampleHeights_Grid(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos,
+    const float         Cell,
+    const int32         Width,
+    float*              outZ,
+    float*              outGradX,
+    float*              outGradY
+)
+{
+    SampleHeights_Rect(settings, Pos, Cell, Width, Width, outZ, outGradX, outGradY);
+}
+
+void UChunkFunctionLibrary::SampleHeights_Rect(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos,
+    const float         Cell,
+    const int32         WidthX,
+    const int32         WidthY,
+    float*              outZ,
+    float*              outGradX,
+    float*              outGradY
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::SampleHeights_Rect);
+
+    const int32 num = WidthX * WidthY;
+    settings.noiseProgram->EvaluateGrid(Pos, Cell, WidthX, WidthY, outZ, outGradX, outGradY);
+
+    for (int32 i = 0; i < num; i++)
+        outZ[i] *= settings.heightMultiplier;
 
-            Mesh.triangles.Append({ A, B, C,  A, C, D });
+    if (outGradX && outGradY)
+    {
+        for (int32 i = 0; i < num; i++)
+        {
+            outGradX[i] *= settings.heightMultiplier;
+            outGradY[i] *= settings.heightMultiplier;
         }
     }
+}
 
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(
-        Mesh.vertices,
-        Mesh.triangles,
-        Mesh.UVs,
-        Mesh.normals,
-        Mesh.tangents
-    );
+TArray<float> UChunkFunctionLibrary::GetTopLod_Vertices(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos
+)
+{
+    return GetLod_Vertices(settings, Pos, settings.maxLOD);
+}
+
+TArray<float> UChunkFunctionLibrary::GetLod_Vertices(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos,
+    const uint8         LOD,
+    const FHeightfield* coarser,
+    TArray<float>*      outGradX,
+    TArray<float>*      outGradY
+)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetLod_Vertices);
+
+    const int32 Width = (1 << LOD) + 1;
+    const float Cell = settings.chunkWidth / (Width - 1);
 
-    FMeshData Final(FVector2D(realWidth, 2), true);
+    // Every ratio-th sample of this grid lands exactly on a sample of the coarser one, so we only copy those
+    const int32 ratio = coarser ? (1 << (LOD - coarser->level)) : 0;
+    const int32 coarserWidth = coarser ? (1 << coarser->level) + 1 : 0;
+    check(!coarser || coarser->level <= LOD);
 
-    for (int32 i = realWidth + 1; i < 2 * realWidth - 1; i++)
+    const bool gradients = outGradX && outGradY;
+    check(!gradients || !coarser || coarser->HasGradients());
+
+    TArray<float> vertices = TArray<float>();
+    vertices.SetNumUninitialized(Width * Width);
+
+    if (gradients)
     {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
+        outGradX->SetNumUninitialized(Width * Width);
+        outGradY->SetNumUninitialized(Width * Width);
     }
 
-    for (int32 i = 2 * realWidth + 2; i < 3 * realWidth - 2; i++)
+    if (!coarser)
     {
-        Final.vertices.Add(Mesh.vertices[i]);
-        Final.UVs.Add(Mesh.UVs[i]);
-        Final.tangents.Add(Mesh.tangents[i]);
-        Final.normals.Add(Mesh.normals[i]);
+        SampleHeights_Grid(settings, Pos, Cell, Width, vertices.GetData(),
+            gradients ? outGradX->GetData() : nullptr,
+            gradients ? outGradY->GetData() : nullptr);
+        return vertices;
     }
 
-    // NOTE: winding flipped back (your triangles were reversed)
-    for (int32 i = realWidth - 2; i < 2 * realWidth - 7; i++)
+    // The samples the coarser grid doesn't have are gathered first, so the whole grid is still evaluated in one pass
+    TArray<FVector2D> positions;
+    TArray<int32> indices;
+    TArray<float> heights;
+    positions.Reserve(Width * Width);
+    indices.Reserve(Width * Width);
+
+    for (int32 Y = 0; Y < Width; ++Y)
     {
-        const int32 A = i - (realWidth - 3);
-        const int32 B = A + 1;
-        const int32 C = i;
+        const bool coarserRow = (Y % ratio) == 0;
+
+        for (int32 X = 0; X < Width; ++X)
+        {
+            if (coarserRow && (X % ratio) == 0)
+            {
+                const int32 coarserIndx = (Y / ratio) * coarserWidth + (X / ratio);
+                vertices[Y * Width + X] = coarser->heights[coarserIndx];
+
+                if (gradients)
+                {
+                    (*outGradX)[Y * Width + X] = coarser->gradientX[coarserIndx];
+                    (*outGradY)[Y * Width + X] = coarser->gradientY[coarserIndx];
+                }
+                continue;
+            }
 
-        Final.triangles.Append({ C, i + 1, B,  A, C, B });
+            positions.Add({ Pos.X + X * Cell, Pos.Y + Y * Cell });
+            indices.Add(Y * Width + X);
+        }
     }
 
-    Final.triangles.Append({ 1, 0, realWidth - 2,  realWidth - 3, realWidth - 4, 2 * realWidth - 7 });
+    heights.SetNumUninitialized(positions.Num());
 
-    return Final;
+    if (gradients)
+    {
+        TArray<float> gradX, gradY;
+        gradX.SetNumUninitialized(positions.Num());
+        gradY.SetNumUninitialized(positions.Num());
+
+        SampleHeights(settings, positions.GetData(), heights.GetData(), positions.Num(), gradX.GetData(), gradY.GetData());
+
+        for (int32 i = 0; i < indices.Num(); i++)
+        {
+            (*outGradX)[indices[i]] = gradX[i];
+            (*outGradY)[indices[i]] = gradY[i];
+        }
+    }
+    else
+    {
+        SampleHeights(settings, positions.GetData(), heights.GetData(), positions.Num());
+    }
+
+    for (int32 i = 0; i < indices.Num(); i++)
+        vertices[indices[i]] = heights[i];
+
+    return vertices;
 }
 
-TArray<float> UChunkFunctionLibrary::GetTopLod_Vertices(
-    const FVector2D&    Pos
+TArray<float> UChunkFunctionLibrary::GetSubsampled_Vertices(
+    const TArray<float>&    finer,
+    const uint8             finerLevel,
+    const uint8             LOD
 )
 {
-    const int32 Width = (1 << m_maxLOD) + 1;
-    const float Cell = m_chunkWidth / (Width - 1);
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetSubsampled_Vertices);
+
+    check(LOD <= finerLevel);
+
+    const int32 Width = (1 << LOD) + 1;
+    const int32 FinerWidth = (1 << finerLevel) + 1;
+    const int32 step = (1 << (finerLevel - LOD));
 
     TArray<float> vertices = TArray<float>();
     vertices.Reserve(Width * Width);
 
     for (int32 Y = 0; Y < Width; ++Y)
     {
-        for (int32 X = 0; X < Width; ++X){
-            const FVector2D W{ Pos.X + X * Cell, Pos.Y + Y * Cell };
+        const float* row = finer.GetData() + (Y * step) * FinerWidth;
+
+        for (int32 X = 0; X < Width; ++X)
+            vertices.Emplace(row[X * step]);
+    }
+
+    return vertices;
+}
 
-            const float  Z = FMath::PerlinNoise2D(W * m_noiseScale + FVector2D(0.1f))
-                * m_heightMultiplier;
+FHeightfieldPtr UChunkFunctionLibrary::GetLod_Heightfield(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos,
+    const uint8         LOD
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_Heightfield);
+
+    const FHeightfieldKey key(settings.GetChunkIndex(Pos), settings.settingsHash);
+
+    FHeightfieldPtr cached = FHeightfieldCache::Get().Find(key, 0);
 
-            vertices.Emplace(Z);
+    if (cached.IsValid() && cached->level == LOD)
+        return cached;
+
+    TSharedPtr<FHeightfield, ESPMode::ThreadSafe> heightfield = MakeShared<FHeightfield, ESPMode::ThreadSafe>();
+    heightfield->level = LOD;
+
+    // A finer level is already there, so this one costs no noise at all
+    if (cached.IsValid() && cached->level > LOD)
+    {
+        heightfield->heights = GetSubsampled_Vertices(cached->heights, cached->level, LOD);
+
+        if (cached->HasGradients())
+        {
+            heightfield->gradientX = GetSubsampled_Vertices(cached->gradientX, cached->level, LOD);
+            heightfield->gradientY = GetSubsampled_Vertices(cached->gradientY, cached->level, LOD);
         }
+        return heightfield;
     }
 
-    return vertices;
+    // Otherwise we sample this level, reusing whatever a coarser level already has, and let it replace the coarser one in the cache
+    heightfield->heights = settings.analyticNormals ?
+        GetLod_Vertices(settings, Pos, LOD, cached.Get(), &heightfield->gradientX, &heightfield->gradientY) :
+        GetLod_Vertices(settings, Pos, LOD, cached.Get());
+    FHeightfieldCache::Get().Add(key, heightfield);
+
+    return heightfield;
+}
+
+FHeightfieldPtr UChunkFunctionLibrary::GetTopLod_Heightfield(
+    const FTerrainSettings& settings,
+    const FVector2D&    Pos
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_Heightfield);
+
+    const FHeightfieldKey key(settings.GetChunkIndex(Pos), settings.settingsHash);
+
+    FHeightfieldPtr cached = FHeightfieldCache::Get().Find(key, settings.maxLOD);
+    if (cached.IsValid())
+        return cached;
+
+    TSharedPtr<FHeightfield, ESPMode::ThreadSafe> heightfield = MakeShared<FHeightfield, ESPMode::ThreadSafe>();
+    heightfield->level = settings.maxLOD;
+    heightfield->heights = settings.analyticNormals ?
+        GetLod_Vertices(settings, Pos, settings.maxLOD, nullptr, &heightfield->gradientX, &heightfield->gradientY) :
+        GetTopLod_Vertices(settings, Pos);
+
+    FHeightfieldCache::Get().Add(key, heightfield);
+
+    return heightfield;
 }
 
 TArray<FVector> UChunkFunctionLibrary::GetLod_Additionals_Vertices(
-    const TArray<float>&        topLodVertices,
+    const FTerrainSettings&     settings,
+    const TArray<float>&        lodVertices,
+    const uint8                 verticesLOD,
     const FVector2D             Pos,
-    const uint8                 LOD
+    const uint8                 LOD,
+    const uint8                 haloLOD
 )
 {
-    const int32 MaxWidth = (1 << m_maxLOD) + 1;
+    TRACE_CPUPROFILER_EVENT_SCOPE(UChunkFunctionLibrary::GetLod_Additionals_Vertices);
+
+    check(LOD <= verticesLOD);
+
+    const int32 SourceWidth = (1 << verticesLOD) + 1;
     const int32 Width = (1 << LOD) + 3;
 
-    const float Cell = m_chunkWidth / (Width - 3);
-    const int step = (1 << (m_maxLOD - LOD));
+    const float Cell = settings.chunkWidth / (Width - 3);
+    const float Halo = settings.chunkWidth / (1 << haloLOD);
+    const int step = (1 << (verticesLOD - LOD));
 
     FVector2D Pivot = Pos - FVector2D(Cell);
 
-    TArray<FVector> vertices = TArray<FVector>();
-    vertices.Reserve(Width * Width);
+    // The outer ring sits one haloLOD cell outside of the chunk, everything else is on the LOD grid
+    auto GetCoord = [&](const double pivot, const int32 I) -> double
+        {
+            if (I == 0)             return pivot + Cell - Halo;
+            if (I == Width - 1)     return pivot + (Width - 2) * Cell + Halo;
+            return pivot + I * Cell;
+        };
+
+    // All the halo samples are gathered first and go through the batch kernel in one call:
+    // the top row, then the left and right ends of every inner row, then the bottom row
+    TArray<FVector2D> haloPositions;
+    haloPositions.Reserve(4 * Width - 4);
 
     for (int X = 0; X < Width; X++)
-    {
-        const FVector2D W{ Pivot.X + X * Cell, Pivot.Y};
-        const float Z = FMath::PerlinNoise2D(W * m_noiseScale + FVector2D(0.1f))
-            * m_heightMultiplier;
+        haloPositions.Add({ GetCoord(Pivot.X, X), GetCoord(Pivot.Y, 0) });
 
-        vertices.Add({ W.X, W.Y, Z});
+    for (int Y = 1; Y < Width - 1; Y++)
+    {
+        haloPositions.Add({ GetCoord(Pivot.X, 0), Pivot.Y + Y * Cell });
+        haloPositions.Add({ GetCoord(Pivot.X, Width - 1), Pivot.Y + Y * Cell });
     }
 
+    for (int X = 0; X < Width; X++)
+        haloPositions.Add({ GetCoord(Pivot.X, X), GetCoord(Pivot.Y, Width - 1) });
+
+    TArray<float> haloHeights;
+    haloHeights.SetNumUninitialized(haloPositions.Num());
+    SampleHeights(settings, haloPositions.GetData(), haloHeights.GetData(), haloPositions.Num());
+
+    TArray<FVector> vertices = TArray<FVector>();
+    vertices.Reserve(Width * Width);
+
+    int32 haloIndx = 0;
+    auto AddHalo = [&]()
+        {
+            const FVector2D& W = haloPositions[haloIndx];
+            vertices.Add({ W.X, W.Y, haloHeights[haloIndx] });
+            haloIndx++;
+        };
+
+    for (int X = 0; X < Width; X++)
+        AddHalo();
+
     for (int Y = 1; Y < Width - 1; Y++)
     {
-        FVector2D W {Pivot.X, Pivot.Y + Y * Cell};
-        float  Z = FMath::PerlinNoise2D(W * m_noiseScale + FVector2D(0.1f))
-            * m_heightMultiplier;
-        vertices.Add({W.X, W.Y, Z });
+        AddHalo();
 
         for (int X = 1; X < Width - 1; X++)
         {
-            const int32 TopY = step * (Y - 1);
-            const int32 TopX = step * (X - 1);
-            const int32 Indx = TopY * MaxWidth + TopX;
+            const int32 SourceY = step * (Y - 1);
+            const int32 SourceX = step * (X - 1);
+            const int32 Indx = SourceY * SourceWidth + SourceX;
 
             vertices.Add({
                 Pivot.X + X * Cell,
                 Pivot.Y + Y * Cell,
-                topLodVertices[Indx]
+                lodVertices[Indx]
                 });
         }
 
-        W = { Pivot.X + (Width - 1) * Cell, Pivot.Y + Y * Cell};
-        Z = FMath::PerlinNoise2D(W * m_noiseScale + FVector2D(0.1f))
-            * m_heightMultiplier;
-
-        vertices.Add({ W.X, W.Y, Z });
+        // The right end was stored right after the left one
+        AddHalo();
     }
 
     for (int X = 0; X < Width; X++)
-    {
-        const FVector2D W{ Pivot.X + X * Cell, Pivot.Y + (Width - 1) * Cell};
-        const float  Z = FMath::PerlinNoise2D(W * m_noiseScale + FVector2D(0.1f))
-            * m_heightMultiplier;
-
-        vertices.Add({ W.X, W.Y, Z });
-    }
+        AddHalo();
 
     return vertices;
 }
@@ -616,95 +976,264 @@ FMeshData UChunkFunctionLibrary::GetChunkData_Center(
     const int8                  LOD
 )
 {
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_CenterMesh);
+
     const int32 DataWidth = (1 << LOD) + 3;
     const int32 Width = DataWidth - 4;
-    const float Cell = m_chunkWidth / (Width + 2);
 
-    FMeshData* Mesh = new FMeshData(
-        FVector2D(DataWidth, DataWidth),
-        true
+    FMeshData Final(
+        FVector2D(Width, Width),
+        true,
+        false
     );
 
-    for (int Y = 0; Y < DataWidth; Y++)
+    // The additionals already are a regular grid with a ring of padding around the vertices we keep,
+    // so the normals are read from it directly, without building a temp mesh
+    Final.normals.SetNumUninitialized(Width * Width);
+    Final.tangents.SetNumUninitialized(Width * Width);
+
+    UMeshStaticLibrary::CalculateGridNormalsAndTangents(
+        wholeChunk_additionals.GetData(), DataWidth, 2, 2, DataWidth - 2, DataWidth - 2,
+        Final.normals.GetData(), Final.tangents.GetData());
+
+    for (int Y = 2; Y < DataWidth - 2; Y++)
     {
-        for (int X = 0; X < DataWidth; X++)
+        for (int X = 2; X < DataWidth - 2; X++)
         {
-            const int32 Indx = Y * DataWidth + X;
+            Final.vertices.Add(wholeChunk_additionals[Y * DataWidth + X]);
+        }
+    }
 
-            Mesh->UVs.Add(FVector2D(wholeChunk_additionals[Indx].X, wholeChunk_additionals[Indx].Y) * m_UVScale);
-            Mesh->vertices.Add(wholeChunk_additionals[Indx]);
+    Final.topology = FMeshTopologyCache::Get().Find(LOD, Direction::Center);
 
-            if (X && Y)
-            {
-                const int32 B = Indx - DataWidth;
-                const int32 C = B - 1;
-                const int32 D = Indx - 1;
+    return Final;
+}
 
-                Mesh->triangles.Append({ Indx, B, C, Indx, C, D });
-            }
-        }
-    }
+// Surface normal of the heightfield Z(X, Y), from its gradient
+static FORCEINLINE FVector GetAnalyticNormal(const float gradX, const float gradY)
+{
+    return FVector(-gradX, -gradY, 1.0).GetSafeNormal();
+}
 
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(
-        Mesh->vertices, Mesh->triangles, Mesh->UVs,
-        Mesh->normals, Mesh->tangents
-    );
+// Derivative of the surface along X, which is the direction the U coordinate grows in
+static FORCEINLINE FVector GetAnalyticTangent(const float gradX)
+{
+    return FVector(1.0, 0.0, gradX).GetSafeNormal();
+}
+
+FMeshData UChunkFunctionLibrary::GetChunkData_Center_Analytic(
+    const FTerrainSettings&     settings,
+    const FHeightfield&         heightfield,
+    const FVector2D             Pos,
+    const uint8                 LOD
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_CenterMesh);
+
+    check(heightfield.HasGradients() && LOD <= heightfield.level);
+
+    const int32 GridWidth = (1 << LOD) + 1;
+    const int32 Width = GridWidth - 2;
+    const float Cell = settings.chunkWidth / (GridWidth - 1);
+    const int32 SourceWidth = (1 << heightfield.level) + 1;
+    const int32 step = (1 << (heightfield.level - LOD));
 
     FMeshData Final(
         FVector2D(Width, Width),
-        true
+        true,
+        false
     );
-    
-    int InnerIndx = 0;
-    for (int Y = 2; Y < DataWidth - 2; Y++)
+
+    for (int Y = 1; Y < GridWidth - 1; Y++)
     {
-        for (int X = 2; X < DataWidth - 2; X++)
+        for (int X = 1; X < GridWidth - 1; X++)
+        {
+            const int32 Indx = (Y * step) * SourceWidth + X * step;
+            const FVector V(Pos.X + X * Cell, Pos.Y + Y * Cell, heightfield.heights[Indx]);
+
+            Final.vertices.Add(V);
+            Final.normals.Add(GetAnalyticNormal(heightfield.gradientX[Indx], heightfield.gradientY[Indx]));
+            Final.tangents.Add(FProcMeshTangent(GetAnalyticTangent(heightfield.gradientX[Indx]), false));
+        }
+    }
+
+    Final.topology = FMeshTopologyCache::Get().Find(LOD, Direction::Center);
+
+    return Final;
+}
+
+FMeshData UChunkFunctionLibrary::GetChunkData_Border_Analytic(
+    const FTerrainSettings&     settings,
+    const FHeightfield&         heightfield,
+    const FVector2D             Pos,
+    const uint8                 LOD,
+    const Direction             dir,
+    const bool                  downscale
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_BorderMeshes);
+
+    check(heightfield.HasGradients() && LOD <= heightfield.level);
+
+    const int32 Last = (1 << LOD);
+    const int32 realWidth = Last + 3;
+    const float Cell = settings.chunkWidth / Last;
+    const int32 SourceWidth = (1 << heightfield.level) + 1;
+    const int32 step = (1 << (heightfield.level - LOD));
+
+    // Row 0 is the edge of the chunk, row 1 the one next to it, Col runs along the edge
+    auto GetGridPoint = [&](const int32 Row, const int32 Col) -> FIntPoint
         {
-            const int32 Indx = Y * DataWidth + X;
-    
-            Final.vertices.Add(Mesh->vertices[Indx]);
-            Final.UVs.Add(Mesh->UVs[Indx]);
-            Final.tangents.Add(Mesh->tangents[Indx]);
-            Final.normals.Add(Mesh->normals[Indx]);
-    
-            if (Y > 2 && X > 2)
+            switch (dir)
             {
-                const int32 B = InnerIndx - Width;
-                const int32 C = B - 1;
-                const int32 D = InnerIndx - 1;
-    
-                Final.triangles.Append({ InnerIndx, B, C, InnerIndx, C, D });
+            case Direction::Up:     return FIntPoint(Col, Row);
+            case Direction::Down:   return FIntPoint(Col, Last - Row);
+            case Direction::Left:   return FIntPoint(Row, Col);
+            default:                return FIntPoint(Last - Row, Col);
             }
-    
-            InnerIndx++;
+        };
+
+    FMeshData Final(FVector2D(realWidth, 2), true, false);
+
+    auto AddVertex = [&](const FVector& V, const FVector& Normal, const FVector& Tangent)
+        {
+            Final.vertices.Add(V);
+            Final.normals.Add(Normal);
+            Final.tangents.Add(FProcMeshTangent(Tangent, false));
+        };
+
+    auto AddGridVertex = [&](const int32 Row, const int32 Col)
+        {
+            const FIntPoint P = GetGridPoint(Row, Col);
+            const int32 Indx = (P.Y * step) * SourceWidth + P.X * step;
+
+            AddVertex(
+                FVector(Pos.X + P.X * Cell, Pos.Y + P.Y * Cell, heightfield.heights[Indx]),
+                GetAnalyticNormal(heightfield.gradientX[Indx], heightfield.gradientY[Indx]),
+                GetAnalyticTangent(heightfield.gradientX[Indx])
+            );
+        };
+
+    for (int32 Col = 0; Col <= Last; Col++)
+    {
+        // Same stitch as the other border builders: the odd vertices of the edge sit halfway between their neighbours,
+        // and so do their normals and tangents
+        if (downscale && (Col & 1) && Col < Last)
+        {
+            const FIntPoint L = GetGridPoint(0, Col - 1);
+            const FIntPoint R = GetGridPoint(0, Col + 1);
+            const int32 LIndx = (L.Y * step) * SourceWidth + L.X * step;
+            const int32 RIndx = (R.Y * step) * SourceWidth + R.X * step;
+
+            const FVector V = 0.5f * (
+                FVector(Pos.X + L.X * Cell, Pos.Y + L.Y * Cell, heightfield.heights[LIndx]) +
+                FVector(Pos.X + R.X * Cell, Pos.Y + R.Y * Cell, heightfield.heights[RIndx]));
+
+            AddVertex(
+                V,
+                (GetAnalyticNormal(heightfield.gradientX[LIndx], heightfield.gradientY[LIndx]) +
+                    GetAnalyticNormal(heightfield.gradientX[RIndx], heightfield.gradientY[RIndx])).GetSafeNormal(),
+                (GetAnalyticTangent(heightfield.gradientX[LIndx]) + GetAnalyticTangent(heightfield.gradientX[RIndx])).GetSafeNormal()
+            );
+        }
+        else
+        {
+            AddGridVertex(0, Col);
         }
     }
-    
-    delete Mesh;
+
+    for (int32 Col = 1; Col < Last; Col++)
+        AddGridVertex(1, Col);
+
+    // Same triangles as the other border builders
+    Final.topology = FMeshTopologyCache::Get().Find(LOD, dir);
 
     return Final;
 }
 
 FChunkLodData& UChunkFunctionLibrary::GenerateChunkData_LOD(
+    const FTerrainSettings& settings,
     const FVector2D&        Pos, 
     const uint8             LOD
 )
 {
-    FChunkLodData* result = new FChunkLodData();
-    TArray<float> highRes_vertices = GetTopLod_Vertices(Pos);
-    TArray<FVector> wholeChunk_additionals = GetLod_Additionals_Vertices(highRes_vertices, Pos, LOD);
-    TArray<FVector> wholeChunk_additionals_maxLOD = GetLod_Additionals_Vertices(highRes_vertices, Pos, m_maxLOD);
+    const FChunkJobToken token;
+    return *TryGenerateChunkData_LOD(settings, Pos, LOD, token);
+}
+
+FChunkLodData* UChunkFunctionLibrary::TryGenerateChunkData_LOD(
+    const FTerrainSettings& settings,
+    const FVector2D&        Pos,
+    const uint8             LOD,
+    const FChunkJobToken&   token
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_GenerateChunkLOD);
 
-    result->Center = GetChunkData_Center(wholeChunk_additionals, Pos, LOD);
-    result->borders_normal[static_cast<uint8>(Direction::Up)] = GetChunkData_Border_Up(wholeChunk_additionals_maxLOD, LOD, false);
-    result->borders_downscaled[static_cast<uint8>(Direction::Up)] = GetChunkData_Border_Up(wholeChunk_additionals_maxLOD, LOD, true);
-    result->borders_normal[static_cast<uint8>(Direction::Down)] = GetChunkData_Border_Down(wholeChunk_additionals_maxLOD, LOD, false);
-    result->borders_downscaled[static_cast<uint8>(Direction::Down)] = GetChunkData_Border_Down(wholeChunk_additionals_maxLOD, LOD, true);
-    result->borders_normal[static_cast<uint8>(Direction::Left)] = GetChunkData_Border_Left(wholeChunk_additionals_maxLOD, LOD, false);
-    result->borders_downscaled[static_cast<uint8>(Direction::Left)] = GetChunkData_Border_Left(wholeChunk_additionals_maxLOD, LOD, true);
-    result->borders_normal[static_cast<uint8>(Direction::Right)] = GetChunkData_Border_Right(wholeChunk_additionals_maxLOD, LOD, false);
-    result->borders_downscaled[static_cast<uint8>(Direction::Right)] = GetChunkData_Border_Right(wholeChunk_additionals_maxLOD, LOD, true);
+    if (token.IsCancelled())
+        return nullptr;
 
-    return *result;
-}
+    // A chunk generated in an earlier session with the same settings is read back instead
+    FChunkDiskCache& diskCache = FChunkDiskCache::Get();
+    const bool useDiskCache = diskCache.IsOpen();
+    const FIntPoint chunkIndex = settings.GetChunkIndex(Pos);
 
+    if (useDiskCache)
+    {
+        if (FChunkLodData* cached = diskCache.Load(chunkIndex, LOD, settings.chunkDataHash))
+            return cached;
+    }
+
+    TUniquePtr<FChunkLodData> result = MakeUnique<FChunkLodData>();
+    // In the pyramid mode we only sample the resolution this LOD needs, and the borders read the same grid with a max-LOD halo around it.
+    // Otherwise the borders read every step-th vertex of the max-LOD grid
+    const FHeightfieldPtr heightfield = settings.pyramidSampling ? GetLod_Heightfield(settings, Pos, LOD) : GetTopLod_Heightfield(settings, Pos);
+    const uint8 bordersLOD = settings.pyramidSampling ? LOD : settings.maxLOD;
+
+    // The heightfield stays in the cache even if we stop here, a job for another LOD of the chunk can still use it
+    if (token.IsCancelled())
+        return nullptr;
+
+    // Every vertex we keep is on the heightfield grid and carries its own gradient, so there is no halo nor tangent pass to go through
+    if (settings.analyticNormals)
+    {
+        result->Center = GetChunkData_Center_Analytic(settings, *heightfield, Pos, LOD);
+
+        if (token.IsCancelled())
+            return nullptr;
+
+        for (const Direction dir : { Direction::Left, Direction::Right, Direction::Up, Direction::Down })
+        {
+            result->borders_normal[static_cast<uint8>(dir)] = GetChunkData_Border_Analytic(settings, *heightfield, Pos, LOD, dir, false);
+            result->borders_downscaled[static_cast<uint8>(dir)] = GetChunkData_Border_Analytic(settings, *heightfield, Pos, LOD, dir, true);
+        }
+    }
+    else
+    {
+        TArray<FVector> wholeChunk_additionals = GetLod_Additionals_Vertices(settings, heightfield->heights, heightfield->level, Pos, LOD, LOD);
+        TArray<FVector> wholeChunk_additionals_maxLOD = GetLod_Additionals_Vertices(settings, heightfield->heights, heightfield->level, Pos, bordersLOD, settings.maxLOD);
+
+        if (token.IsCancelled())
+            return nullptr;
+
+        result->Center = GetChunkData_Center(wholeChunk_additionals, Pos, LOD);
+
+        if (token.IsCancelled())
+            return nullptr;
+
+        GetChunkData_Borders(wholeChunk_additionals_maxLOD, bordersLOD, LOD, *result);
+    }
+
+    // The chunk keeps the data for as long as the LOD is resident, so it is stored compact and only expanded for the upload
+    if (settings.compactVertices)
+    {
+        result->Compact(FVector(Pos, 0.0));
+    }
+
+    if (useDiskCache)
+    {
+        diskCache.Store(chunkIndex, LOD, settings.chunkDataHash, *result);
+    }
+
+    return result.Release();
+}
@@ -3,27 +3,61 @@
 
 #include "CoreMinimal.h"
 #include "Containers/Map.h"
+#include "HAL/ThreadSafeBool.h"
 
 #include "MeshFunctionLibrary.h"
 #include "../Structures/MeshData.h"
+#include "../Structures/HeightfieldCache.h"
+#include "../Structures/ChunkDiskCache.h"
+#include "../Structures/NoiseGraph.h"
+#include "../Structures/TerrainSettings.h"
 #include "ChunkFunctionLibrary.generated.h"
 
+// Average time the eight border meshes of one job take, built one by one or all together
+USTRUCT(BlueprintType)
+struct FBorderBuilderTimings
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) uint8       LOD = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       iterations = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double      separateSecondsPerJob = 0.0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double      fusedSecondsPerJob = 0.0;
+};
+
+// Shared between a chunk job and whoever started it, the job gives up at its next stage once cancelled
+struct FChunkJobToken
+{
+    FThreadSafeBool             cancelled = false;
+
+    FORCEINLINE void Cancel() { cancelled = true; }
+    FORCEINLINE bool IsCancelled() const { return cancelled; }
+};
+
+typedef TSharedPtr<FChunkJobToken, ESPMode::ThreadSafe> FChunkJobTokenPtr;
 
 UCLASS(BlueprintType)
 class UChunkFunctionLibrary : public UBlueprintFunctionLibrary
 {
     GENERATED_BODY()
 private:
-    static float                m_noiseScale;
-    static float                m_heightMultiplier;
-    static float                m_chunkWidth;
-    static float                m_UVScale;
-    static uint8                m_maxLOD;
+    static FTerrainSettingsPtr  m_settings;                 //  The snapshot new terrains and jobs start from, swapped whole by the setters
+    static FCriticalSection     m_settingsLock;
+
+    // Publishes a copy of the current settings with the change applied. Returns false if the result doesn't compile
+    static bool UpdateSettings(
+        TFunctionRef<void(FTerrainSettings&)>   change,
+        FString*                                outError = nullptr
+    );
 
 public:
 
     UChunkFunctionLibrary() {}
 
+    // The current snapshot, it stays valid and unchanged for as long as it is held
+    static FTerrainSettingsPtr GetSettings();
+
     UFUNCTION(BlueprintCallable)
     static void SetTerrainGenerationSettings(
         const float         chunkWidth,
@@ -31,51 +65,156 @@ public:
         const float         heightMultiplier,
         const float         UVScale,
         const uint8         maxLOD
-    )
-    {
-        m_heightMultiplier = heightMultiplier;
-        m_noiseScale = noiseScale;
-        m_chunkWidth = chunkWidth;
-        m_UVScale = UVScale;
-        m_maxLOD = maxLOD;
-    }
-
-    static FORCEINLINE float GetChunkWidth()        { return m_chunkWidth;          }
-    static FORCEINLINE float GetNoiseScale()        { return m_noiseScale;          }
-    static FORCEINLINE float GetHeightMultiplier()  { return m_heightMultiplier;    }
-    static FORCEINLINE float GetUVScale()           { return m_UVScale;             }
-    static FORCEINLINE uint8 GetMaxLOD()            { return m_maxLOD;              }
+    );
+
+    UFUNCTION(BlueprintCallable, meta = (ReturnDisplayName = "Success", ToolTip = "Compiles the graph the terrain height is evaluated from, keeps the previous one if it is invalid"))
+    static bool SetNoiseGraph(const FNoiseGraph& graph);
+
+    static FNoiseProgramPtr GetNoiseProgram() { return GetSettings()->noiseProgram; }
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "Enables the per-node timings of the noise graph"))
+    static void SetNoiseProfiling(const bool enabled);
+
+    UFUNCTION(BlueprintCallable)
+    static TArray<FNoiseNodeTiming> GetNoiseNodeTimings();
+
+    UFUNCTION(BlueprintCallable)
+    static void ResetNoiseNodeTimings();
+
+    // Values of the current snapshot, whatever runs for a terrain reads the snapshot of that terrain instead
+    static FORCEINLINE float GetChunkWidth()        { return GetSettings()->chunkWidth;          }
+    static FORCEINLINE float GetNoiseScale()        { return GetSettings()->noiseScale;          }
+    static FORCEINLINE float GetHeightMultiplier()  { return GetSettings()->heightMultiplier;    }
+    static FORCEINLINE float GetUVScale()           { return GetSettings()->UVScale;             }
+    static FORCEINLINE uint8 GetMaxLOD()            { return GetSettings()->maxLOD;              }
+    static FORCEINLINE bool GetPyramidSampling()    { return GetSettings()->pyramidSampling;     }
+    static FORCEINLINE bool GetAnalyticNormals()    { return GetSettings()->analyticNormals;     }
+    static FORCEINLINE bool GetCompactVertices()    { return GetSettings()->compactVertices;     }
+    static FORCEINLINE bool GetReleaseUploadedData(){ return GetSettings()->releaseUploadedData; }
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "When enabled, each LOD job only samples the noise at the resolution it needs"))
+    static void SetPyramidSampling(const bool enabled) { UpdateSettings([enabled](FTerrainSettings& settings) { settings.pyramidSampling = enabled; }); }
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "When enabled, normals and tangents come from the gradient of the noise instead of the mesh"))
+    static void SetAnalyticNormals(const bool enabled) { UpdateSettings([enabled](FTerrainSettings& settings) { settings.analyticNormals = enabled; }); }
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "When enabled, generated chunk data is stored with float chunk relative positions and packed normals, and only expanded for the upload"))
+    static void SetCompactVertices(const bool enabled) { UpdateSettings([enabled](FTerrainSettings& settings) { settings.compactVertices = enabled; }); }
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "When enabled, chunk components drop their copy of the chunk data once it is in the sections, only the LOD presence and bounds are kept"))
+    static void SetReleaseUploadedData(const bool enabled) { UpdateSettings([enabled](FTerrainSettings& settings) { settings.releaseUploadedData = enabled; }); }
+
+    static uint32 GetSettingsHash()     { return GetSettings()->settingsHash;   }     // Hash of every setting that affects the generated heights
+
+    static uint32 GetChunkDataHash()    { return GetSettings()->chunkDataHash;  }     // Same, with the settings that only change the meshes, what the disk cache is keyed by
 
     static FMeshData GetChunkData_Border_Up     (
                                                 const TArray<FVector>&      wholeChunk_additionalsVerts, 
+                                                const uint8                 sourceLOD,      // LOD of the grid the array was built from
                                                 const uint8                 LOD, 
                                                 const bool                  downscale
                                                 );
     static FMeshData GetChunkData_Border_Down   (
                                                 const TArray<FVector>&      wholeChunk_additionalsVerts,
+                                                const uint8                 sourceLOD,
                                                 const uint8                 LOD,
                                                 const bool                  downscale
                                                 );
     static FMeshData GetChunkData_Border_Left   (
                                                 const TArray<FVector>&      wholeChunk_additionalsVerts,
+                                                const uint8                 sourceLOD,
                                                 const uint8                 LOD,
                                                 const bool                  downscale
                                                 );
     static FMeshData GetChunkData_Border_Right  (
                                                 const TArray<FVector>&      wholeChunk_additionalsVerts,
+                                                const uint8                 sourceLOD,
                                                 const uint8                 LOD,
                                                 const bool                  downscale
                                                 );
 
+    static void GetChunkData_Borders( // Normal and downscaled variants of the four borders, sharing the reads and the normals between them
+                                                const TArray<FVector>&      wholeChunk_additionalsVerts,
+                                                const uint8                 sourceLOD,
+                                                const uint8                 LOD,
+                                                FChunkLodData&              outData
+                                                );
+
+    UFUNCTION(BlueprintCallable, meta = (ToolTip = "Times the eight border builds of a job with the per-direction builders GetChunkData_Borders replaced, against GetChunkData_Borders"))
+    static FBorderBuilderTimings BenchmarkBorderBuilders(
+        const uint8                 LOD,
+        const int32                 iterations = 100
+    );
+
+    static void SampleHeights( // Terrain height at every position, the noise graph evaluates them tile by tile
+        const FTerrainSettings&     settings,
+        const FVector2D*            positions,
+        float*                      outZ,
+        const int32                 num,
+        float*                      outGradX = nullptr,     // dZ/dX and dZ/dY, only evaluated if both are given
+        float*                      outGradY = nullptr
+    );
+
+    static void SampleHeights_Grid( // Same thing for the Width x Width grid starting at Pos
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos,
+        const float                 Cell,
+        const int32                 Width,
+        float*                      outZ,
+        float*                      outGradX = nullptr,
+        float*                      outGradY = nullptr
+    );
+
+    static void SampleHeights_Rect( // Same thing for the WidthX x WidthY grid starting at Pos, the strips a clipmap level uncovers
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos,
+        const float                 Cell,
+        const int32                 WidthX,
+        const int32                 WidthY,
+        float*                      outZ,
+        float*                      outGradX = nullptr,
+        float*                      outGradY = nullptr
+    );
+
     static TArray<float> GetTopLod_Vertices( // Simply, only generating the Z positions of the vertices of the LOD 0 chunk
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos
+    );
+
+    static TArray<float> GetLod_Vertices( // Z positions of the (2^LOD + 1)^2 grid, copying the samples a coarser heightfield already has
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos,
+        const uint8                 LOD,
+        const FHeightfield*         coarser = nullptr,
+        TArray<float>*              outGradX = nullptr,     // Filled with the gradients too if given, the coarser heightfield must have them
+        TArray<float>*              outGradY = nullptr
+    );
+
+    static TArray<float> GetSubsampled_Vertices( // Every step-th value of a finer grid, without any noise sampling
+        const TArray<float>&        finer,
+        const uint8                 finerLevel,
+        const uint8                 LOD
+    );
+
+    static FHeightfieldPtr GetLod_Heightfield( // Pyramid mode: heights of the LOD grid, from a cached finer level if there is one
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos,
+        const uint8                 LOD
+    );
+
+    static FHeightfieldPtr GetTopLod_Heightfield( // Same as GetTopLod_Vertices, but reuses the heights cached by the previous LOD jobs of the chunk
+        const FTerrainSettings&     settings,
         const FVector2D&            Pos
     );
 
     static TArray<FVector> GetLod_Additionals_Vertices
     (
-        const TArray<float>&        topLodVertices,
+        const FTerrainSettings&     settings,
+        const TArray<float>&        lodVertices,
+        const uint8                 verticesLOD,    // LOD of the grid lodVertices was sampled at
         const FVector2D             Pos,
-        const uint8                 LOD
+        const uint8                 LOD,
+        const uint8                 haloLOD         // The outer ring is one cell of this LOD away from the chunk
     );
      
     static FMeshData GetChunkData_Center(
@@ -84,8 +223,33 @@ public:
         const int8                  LOD
     );
 
+    static FMeshData GetChunkData_Center_Analytic( // Inner vertices read straight from the heightfield, normals from its gradients
+        const FTerrainSettings&     settings,
+        const FHeightfield&         heightfield,
+        const FVector2D             Pos,
+        const uint8                 LOD
+    );
+
+    static FMeshData GetChunkData_Border_Analytic( // Same two rows as GetChunkData_Border_*, without the halo and the temp mesh
+        const FTerrainSettings&     settings,
+        const FHeightfield&         heightfield,
+        const FVector2D             Pos,
+        const uint8                 LOD,
+        const Direction             dir,
+        const bool                  downscale
+    );
+
     static FChunkLodData& GenerateChunkData_LOD(
+        const FTerrainSettings&     settings,
         const FVector2D&            Pos,
         const uint8                 LOD
     );
+
+    // Same as GenerateChunkData_LOD, returns nullptr if the token got cancelled before the job was done
+    static FChunkLodData* TryGenerateChunkData_LOD(
+        const FTerrainSettings&     settings,
+        const FVector2D&            Pos,
+        const uint8                 LOD,
+        const FChunkJobToken&       token
+    );
 };
\ No newline at end of file
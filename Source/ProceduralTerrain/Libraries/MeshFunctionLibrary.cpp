@@ -1,4 +1,9 @@
 ﻿#include "MeshFunctionLibrary.h"
+#include "Async/ParallelFor.h"
+
+// Below these sizes the work is too small to be worth the task dispatch
+static constexpr int32 ParallelNormals_MinVertices = 16 * 1024;
+static constexpr int32 ParallelGrid_MinVertices = 64 * 64;
 
 void UMeshStaticLibrary::CalculateNormals(
 	const TArray<FVector>&		Vertices,
@@ -7,35 +12,122 @@ void UMeshStaticLibrary::CalculateNormals(
 )
 {
 	const int32 VertexCount = Vertices.Num();
+	const int32 TriangleCount = Indices.Num() / 3;
 	check(Indices.Num() % 3 == 0);
 
-	OutNormals.Init(FVector::ZeroVector, VertexCount);
+	auto GetFaceNormal = [&](const int32 Triangle) -> FVector
+		{
+			const FVector& V0 = Vertices[Indices[Triangle * 3]];
+			const FVector& V1 = Vertices[Indices[Triangle * 3 + 1]];
+			const FVector& V2 = Vertices[Indices[Triangle * 3 + 2]];
+
+			FVector FaceNormal = (V2 - V0) ^ (V1 - V0);   // clockwise → outward
 
-	for (int32 i = 0; i < Indices.Num(); i += 3)
-	{
-		const int32 I0 = Indices[i];
-		const int32 I1 = Indices[i + 1];
-		const int32 I2 = Indices[i + 2];
+			FaceNormal *= -1.0f;
+			return FaceNormal;
+		};
 
-		const FVector& V0 = Vertices[I0];
-		const FVector& V1 = Vertices[I1];
-		const FVector& V2 = Vertices[I2];
+	if (VertexCount < ParallelNormals_MinVertices)
+	{
+		OutNormals.Init(FVector::ZeroVector, VertexCount);
 
-		FVector FaceNormal = (V2 - V0) ^ (V1 - V0);   // clockwise → outward
+		for (int32 t = 0; t < TriangleCount; t++)
+		{
+			const FVector FaceNormal = GetFaceNormal(t);
 
-		FaceNormal *= -1.0f;
+			if (!FaceNormal.IsNearlyZero())
+			{
+				OutNormals[Indices[t * 3]] += FaceNormal;
+				OutNormals[Indices[t * 3 + 1]] += FaceNormal;
+				OutNormals[Indices[t * 3 + 2]] += FaceNormal;
+			}
+		}
 
-		if (!FaceNormal.IsNearlyZero())
+		for (FVector& N : OutNormals)
 		{
-			OutNormals[I0] += FaceNormal;
-			OutNormals[I1] += FaceNormal;
-			OutNormals[I2] += FaceNormal;
+			N.Normalize(0.0001f);   // Safe‑normalize; leaves zero for isolated verts
 		}
+		return;
 	}
 
-	for (FVector& N : OutNormals)
+	// Big meshes: the face normals are computed in parallel, then every vertex gathers the ones of its own triangles,
+	// so no two tasks ever write to the same normal
+	TArray<FVector> FaceNormals;
+	FaceNormals.SetNumUninitialized(TriangleCount);
+
+	ParallelFor(TriangleCount, [&](const int32 t)
+		{
+			const FVector FaceNormal = GetFaceNormal(t);
+			FaceNormals[t] = FaceNormal.IsNearlyZero() ? FVector::ZeroVector : FaceNormal;
+		});
+
+	// Vertex to triangle adjacency, in a compressed row layout
+	TArray<int32> FirstCorner;
+	FirstCorner.SetNumZeroed(VertexCount + 1);
+
+	for (const int32 I : Indices)
+		FirstCorner[I + 1]++;
+
+	for (int32 v = 0; v < VertexCount; v++)
+		FirstCorner[v + 1] += FirstCorner[v];
+
+	TArray<int32> Fill = FirstCorner;
+	TArray<int32> CornerTriangles;
+	CornerTriangles.SetNumUninitialized(Indices.Num());
+
+	for (int32 i = 0; i < Indices.Num(); i++)
+		CornerTriangles[Fill[Indices[i]]++] = i / 3;
+
+	OutNormals.SetNumUninitialized(VertexCount);
+
+	ParallelFor(VertexCount, [&](const int32 v)
+		{
+			FVector N = FVector::ZeroVector;
+
+			for (int32 c = FirstCorner[v]; c < FirstCorner[v + 1]; c++)
+				N += FaceNormals[CornerTriangles[c]];
+
+			N.Normalize(0.0001f);
+			OutNormals[v] = N;
+		});
+}
+
+void UMeshStaticLibrary::CalculateGridNormalsAndTangents(
+	const FVector*				grid,
+	const int32					gridWidth,
+	const int32					minX,
+	const int32					minY,
+	const int32					maxX,
+	const int32					maxY,
+	FVector*					outNormals,
+	FProcMeshTangent*			outTangents
+)
+{
+	check(minX >= 1 && minY >= 1 && maxX < gridWidth && maxX > minX && maxY > minY);
+
+	const int32 RowLength = maxX - minX;
+
+	// Every row only reads its own neighbours and writes its own outputs, so the rows can go in any order
+	auto DoRow = [&](const int32 Row)
+		{
+			const int32 Y = minY + Row;
+			FVector* Normals = outNormals + Row * RowLength;
+			FProcMeshTangent* Tangents = outTangents + Row * RowLength;
+
+			for (int32 X = minX; X < maxX; X++)
+			{
+				GetGridNormalAndTangent(grid, gridWidth, Y * gridWidth + X, Normals[X - minX], Tangents[X - minX]);
+			}
+		};
+
+	const int32 Rows = maxY - minY;
+	if (Rows * RowLength < ParallelGrid_MinVertices)
 	{
-		N.Normalize(0.0001f);   // Safe‑normalize; leaves zero for isolated verts
+		for (int32 Row = 0; Row < Rows; Row++)
+			DoRow(Row);
+	}
+	else
+	{
+		ParallelFor(Rows, DoRow);
 	}
 }
-
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Containers/Map.h"
 
+#include "ProceduralMeshComponent.h"
 #include "../Structures/MeshData.h"
 
 #include "MeshFunctionLibrary.generated.h"
@@ -20,6 +21,41 @@ public:
         const TArray<int32>&            triangles,
         TArray<FVector>&                normals
     );
+
+    // Normal and tangent of the grid vertex at Indx, from the central differences with its four neighbours.
+    // The normal always points up and the tangent follows +X, which is the direction the U coordinate grows in
+    static FORCEINLINE void GetGridNormalAndTangent(
+        const FVector*                  grid,
+        const int32                     gridWidth,
+        const int32                     Indx,
+        FVector&                        outNormal,
+        FProcMeshTangent&               outTangent
+    )
+    {
+        const FVector dCol = grid[Indx + 1] - grid[Indx - 1];
+        const FVector dRow = grid[Indx + gridWidth] - grid[Indx - gridWidth];
+
+        // The rows and columns of the border grids don't always run along +X and +Y, so the sign comes from Z instead
+        FVector N = dCol ^ dRow;
+        N *= (N.Z < 0.0) ? -1.0 : 1.0;
+        N.Normalize(0.0001f);
+
+        outNormal = N;
+        outTangent = FProcMeshTangent(FVector(N.Z, 0.0, -N.X).GetSafeNormal(), false);
+    }
+
+    // Normals and tangents of the [minX, maxX) x [minY, maxY) window of a row major grid of vertices.
+    // The window must leave at least one padding vertex on each side, the outputs are written row by row
+    static void CalculateGridNormalsAndTangents(
+        const FVector*                  grid,
+        const int32                     gridWidth,
+        const int32                     minX,
+        const int32                     minY,
+        const int32                     maxX,
+        const int32                     maxY,
+        FVector*                        outNormals,
+        FProcMeshTangent*               outTangents
+    );
 };
 
 
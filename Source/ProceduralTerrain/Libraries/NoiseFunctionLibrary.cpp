@@ -0,0 +1,409 @@
+#include "NoiseFunctionLibrary.h"
+#include "Math/RandomStream.h"
+
+namespace NoiseKernel
+{
+    // Largest difference we accept between the kernel and FMath::PerlinNoise2D, noise itself is in (-1, 1)
+    static constexpr float  Tolerance = 1e-5f;
+
+    // Gradients of FMath's Grad2, indexed by (hash & 7)
+    static const float      GradX[8] = { 1.f,  1.f,  0.f, -1.f, -1.f, -1.f,  0.f,  1.f };
+    static const float      GradY[8] = { 0.f,  1.f,  1.f,  1.f,  0.f, -1.f, -1.f, -1.f };
+
+    // Gradient index picked at every lattice corner, periodic in 256 on both axes
+    struct FLatticeTable
+    {
+        uint8   gradients[256 * 256];
+        bool    bValid = false;
+
+        FLatticeTable();
+
+        FORCEINLINE uint8 Get(const int32 X, const int32 Y) const
+        {
+            return gradients[(Y & 255) * 256 + (X & 255)];
+        }
+    };
+
+    FORCEINLINE float SmoothCurve(const float X)
+    {
+        return X * X * X * (X * (X * 6.0f - 15.0f) + 10.0f);
+    }
+
+    // Derivative of the smooth curve, 30 * X^2 * (X - 1)^2
+    FORCEINLINE float SmoothCurveDeriv(const float X)
+    {
+        return 30.0f * X * X * (X * (X - 2.0f) + 1.0f);
+    }
+
+    FORCEINLINE float Grad(const uint8 Gradient, const float X, const float Y)
+    {
+        return GradX[Gradient] * X + GradY[Gradient] * Y;
+    }
+
+    FORCEINLINE VectorRegister4Float VectorSmoothCurve(const VectorRegister4Float& X)
+    {
+        const VectorRegister4Float X3 = VectorMultiply(VectorMultiply(X, X), X);
+        const VectorRegister4Float Inner = VectorSubtract(VectorMultiply(X, VectorSetFloat1(6.0f)), VectorSetFloat1(15.0f));
+
+        return VectorMultiply(X3, VectorAdd(VectorMultiply(X, Inner), VectorSetFloat1(10.0f)));
+    }
+
+    FORCEINLINE VectorRegister4Float VectorSmoothCurveDeriv(const VectorRegister4Float& X)
+    {
+        const VectorRegister4Float X2 = VectorMultiply(VectorMultiply(X, X), VectorSetFloat1(30.0f));
+        const VectorRegister4Float Inner = VectorAdd(VectorMultiply(X, VectorSubtract(X, VectorSetFloat1(2.0f))), VectorSetFloat1(1.0f));
+
+        return VectorMultiply(X2, Inner);
+    }
+
+    // FMath::Lerp, without a fused multiply-add so the result stays identical to the scalar one
+    FORCEINLINE VectorRegister4Float VectorLerpExact(const VectorRegister4Float& A, const VectorRegister4Float& B, const VectorRegister4Float& Alpha)
+    {
+        return VectorAdd(A, VectorMultiply(Alpha, VectorSubtract(B, A)));
+    }
+
+    FORCEINLINE VectorRegister4Float VectorGrad(const VectorRegister4Float& GX, const VectorRegister4Float& GY, const VectorRegister4Float& X, const VectorRegister4Float& Y)
+    {
+        return VectorAdd(VectorMultiply(GX, X), VectorMultiply(GY, Y));
+    }
+
+    static float Evaluate(const FLatticeTable& Table, const float X, const float Y)
+    {
+        const float Xfl = FMath::FloorToFloat(X);
+        const float Yfl = FMath::FloorToFloat(Y);
+        const int32 Xi = (int32)Xfl;
+        const int32 Yi = (int32)Yfl;
+        const float Xf = X - Xfl;
+        const float Yf = Y - Yfl;
+        const float Xm1 = Xf - 1.0f;
+        const float Ym1 = Yf - 1.0f;
+
+        const float U = SmoothCurve(Xf);
+        const float V = SmoothCurve(Yf);
+
+        return FMath::Lerp(
+            FMath::Lerp(Grad(Table.Get(Xi, Yi), Xf, Yf), Grad(Table.Get(Xi + 1, Yi), Xm1, Yf), U),
+            FMath::Lerp(Grad(Table.Get(Xi, Yi + 1), Xf, Ym1), Grad(Table.Get(Xi + 1, Yi + 1), Xm1, Ym1), U),
+            V);
+    }
+
+    static void Evaluate_Batch(const FLatticeTable& Table, const float* X, const float* Y, float* OutNoise, const int32 Num)
+    {
+        const VectorRegister4Float One = VectorSetFloat1(1.0f);
+
+        int32 i = 0;
+        for (; i + 4 <= Num; i += 4)
+        {
+            const VectorRegister4Float VX = VectorLoad(X + i);
+            const VectorRegister4Float VY = VectorLoad(Y + i);
+            const VectorRegister4Float Xfl = VectorFloor(VX);
+            const VectorRegister4Float Yfl = VectorFloor(VY);
+
+            // There is no gather on SSE, so the corner gradients are looked up per lane
+            alignas(16) float Xs[4], Ys[4];
+            alignas(16) float G00X[4], G00Y[4], G10X[4], G10Y[4], G01X[4], G01Y[4], G11X[4], G11Y[4];
+
+            VectorStoreAligned(Xfl, Xs);
+            VectorStoreAligned(Yfl, Ys);
+
+            for (int32 Lane = 0; Lane < 4; Lane++)
+            {
+                const int32 Xi = (int32)Xs[Lane];
+                const int32 Yi = (int32)Ys[Lane];
+
+                const uint8 A = Table.Get(Xi, Yi);
+                const uint8 B = Table.Get(Xi + 1, Yi);
+                const uint8 C = Table.Get(Xi, Yi + 1);
+                const uint8 D = Table.Get(Xi + 1, Yi + 1);
+
+                G00X[Lane] = GradX[A];  G00Y[Lane] = GradY[A];
+                G10X[Lane] = GradX[B];  G10Y[Lane] = GradY[B];
+                G01X[Lane] = GradX[C];  G01Y[Lane] = GradY[C];
+                G11X[Lane] = GradX[D];  G11Y[Lane] = GradY[D];
+            }
+
+            const VectorRegister4Float Xf = VectorSubtract(VX, Xfl);
+            const VectorRegister4Float Yf = VectorSubtract(VY, Yfl);
+            const VectorRegister4Float Xm1 = VectorSubtract(Xf, One);
+            const VectorRegister4Float Ym1 = VectorSubtract(Yf, One);
+
+            const VectorRegister4Float N00 = VectorGrad(VectorLoadAligned(G00X), VectorLoadAligned(G00Y), Xf, Yf);
+            const VectorRegister4Float N10 = VectorGrad(VectorLoadAligned(G10X), VectorLoadAligned(G10Y), Xm1, Yf);
+            const VectorRegister4Float N01 = VectorGrad(VectorLoadAligned(G01X), VectorLoadAligned(G01Y), Xf, Ym1);
+            const VectorRegister4Float N11 = VectorGrad(VectorLoadAligned(G11X), VectorLoadAligned(G11Y), Xm1, Ym1);
+
+            const VectorRegister4Float U = VectorSmoothCurve(Xf);
+            const VectorRegister4Float V = VectorSmoothCurve(Yf);
+
+            VectorStore(VectorLerpExact(VectorLerpExact(N00, N10, U), VectorLerpExact(N01, N11, U), V), OutNoise + i);
+        }
+
+        for (; i < Num; i++)
+        {
+            OutNoise[i] = Evaluate(Table, X[i], Y[i]);
+        }
+    }
+
+    // Noise and its derivatives, the derivative of lerp(A, B, T) being A' + T * (B' - A') + T' * (B - A)
+    static void Evaluate_Deriv(const FLatticeTable& Table, const float X, const float Y, float& OutNoise, float& OutDX, float& OutDY)
+    {
+        const float Xfl = FMath::FloorToFloat(X);
+        const float Yfl = FMath::FloorToFloat(Y);
+        const int32 Xi = (int32)Xfl;
+        const int32 Yi = (int32)Yfl;
+        const float Xf = X - Xfl;
+        const float Yf = Y - Yfl;
+        const float Xm1 = Xf - 1.0f;
+        const float Ym1 = Yf - 1.0f;
+
+        const uint8 A = Table.Get(Xi, Yi);
+        const uint8 B = Table.Get(Xi + 1, Yi);
+        const uint8 C = Table.Get(Xi, Yi + 1);
+        const uint8 D = Table.Get(Xi + 1, Yi + 1);
+
+        const float N00 = Grad(A, Xf, Yf);
+        const float N10 = Grad(B, Xm1, Yf);
+        const float N01 = Grad(C, Xf, Ym1);
+        const float N11 = Grad(D, Xm1, Ym1);
+
+        const float U = SmoothCurve(Xf);
+        const float V = SmoothCurve(Yf);
+        const float DU = SmoothCurveDeriv(Xf);
+        const float DV = SmoothCurveDeriv(Yf);
+
+        const float P = FMath::Lerp(N00, N10, U);
+        const float Q = FMath::Lerp(N01, N11, U);
+
+        const float PX = FMath::Lerp(GradX[A], GradX[B], U) + DU * (N10 - N00);
+        const float QX = FMath::Lerp(GradX[C], GradX[D], U) + DU * (N11 - N01);
+        const float PY = FMath::Lerp(GradY[A], GradY[B], U);
+        const float QY = FMath::Lerp(GradY[C], GradY[D], U);
+
+        OutNoise = FMath::Lerp(P, Q, V);
+        OutDX = FMath::Lerp(PX, QX, V);
+        OutDY = FMath::Lerp(PY, QY, V) + DV * (Q - P);
+    }
+
+    static void Evaluate_Batch_Deriv(const FLatticeTable& Table, const float* X, const float* Y, float* OutNoise, float* OutDX, float* OutDY, const int32 Num)
+    {
+        const VectorRegister4Float One = VectorSetFloat1(1.0f);
+
+        int32 i = 0;
+        for (; i + 4 <= Num; i += 4)
+        {
+            const VectorRegister4Float VX = VectorLoad(X + i);
+            const VectorRegister4Float VY = VectorLoad(Y + i);
+            const VectorRegister4Float Xfl = VectorFloor(VX);
+            const VectorRegister4Float Yfl = VectorFloor(VY);
+
+            alignas(16) float Xs[4], Ys[4];
+            alignas(16) float G00X[4], G00Y[4], G10X[4], G10Y[4], G01X[4], G01Y[4], G11X[4], G11Y[4];
+
+            VectorStoreAligned(Xfl, Xs);
+            VectorStoreAligned(Yfl, Ys);
+
+            for (int32 Lane = 0; Lane < 4; Lane++)
+            {
+                const int32 Xi = (int32)Xs[Lane];
+                const int32 Yi = (int32)Ys[Lane];
+
+                const uint8 A = Table.Get(Xi, Yi);
+                const uint8 B = Table.Get(Xi + 1, Yi);
+                const uint8 C = Table.Get(Xi, Yi + 1);
+                const uint8 D = Table.Get(Xi + 1, Yi + 1);
+
+                G00X[Lane] = GradX[A];  G00Y[Lane] = GradY[A];
+                G10X[Lane] = GradX[B];  G10Y[Lane] = GradY[B];
+                G01X[Lane] = GradX[C];  G01Y[Lane] = GradY[C];
+                G11X[Lane] = GradX[D];  G11Y[Lane] = GradY[D];
+            }
+
+            const VectorRegister4Float Xf = VectorSubtract(VX, Xfl);
+            const VectorRegister4Float Yf = VectorSubtract(VY, Yfl);
+            const VectorRegister4Float Xm1 = VectorSubtract(Xf, One);
+            const VectorRegister4Float Ym1 = VectorSubtract(Yf, One);
+
+            const VectorRegister4Float VG00X = VectorLoadAligned(G00X), VG00Y = VectorLoadAligned(G00Y);
+            const VectorRegister4Float VG10X = VectorLoadAligned(G10X), VG10Y = VectorLoadAligned(G10Y);
+            const VectorRegister4Float VG01X = VectorLoadAligned(G01X), VG01Y = VectorLoadAligned(G01Y);
+            const VectorRegister4Float VG11X = VectorLoadAligned(G11X), VG11Y = VectorLoadAligned(G11Y);
+
+            const VectorRegister4Float N00 = VectorGrad(VG00X, VG00Y, Xf, Yf);
+            const VectorRegister4Float N10 = VectorGrad(VG10X, VG10Y, Xm1, Yf);
+            const VectorRegister4Float N01 = VectorGrad(VG01X, VG01Y, Xf, Ym1);
+            const VectorRegister4Float N11 = VectorGrad(VG11X, VG11Y, Xm1, Ym1);
+
+            const VectorRegister4Float U = VectorSmoothCurve(Xf);
+            const VectorRegister4Float V = VectorSmoothCurve(Yf);
+            const VectorRegister4Float DU = VectorSmoothCurveDeriv(Xf);
+            const VectorRegister4Float DV = VectorSmoothCurveDeriv(Yf);
+
+            const VectorRegister4Float P = VectorLerpExact(N00, N10, U);
+            const VectorRegister4Float Q = VectorLerpExact(N01, N11, U);
+
+            const VectorRegister4Float PX = VectorAdd(VectorLerpExact(VG00X, VG10X, U), VectorMultiply(DU, VectorSubtract(N10, N00)));
+            const VectorRegister4Float QX = VectorAdd(VectorLerpExact(VG01X, VG11X, U), VectorMultiply(DU, VectorSubtract(N11, N01)));
+            const VectorRegister4Float PY = VectorLerpExact(VG00Y, VG10Y, U);
+            const VectorRegister4Float QY = VectorLerpExact(VG01Y, VG11Y, U);
+
+            VectorStore(VectorLerpExact(P, Q, V), OutNoise + i);
+            VectorStore(VectorLerpExact(PX, QX, V), OutDX + i);
+            VectorStore(VectorAdd(VectorLerpExact(PY, QY, V), VectorMultiply(DV, VectorSubtract(Q, P))), OutDY + i);
+        }
+
+        for (; i < Num; i++)
+        {
+            Evaluate_Deriv(Table, X[i], Y[i], OutNoise[i], OutDX[i], OutDY[i]);
+        }
+    }
+
+    // Largest difference between the kernel and FMath::PerlinNoise2D over random samples
+    static float Validate(const FLatticeTable& Table, const int32 NumSamples, const int32 Seed)
+    {
+        FRandomStream Stream(Seed);
+
+        TArray<float> X, Y, Batch, Reference;
+        X.SetNumUninitialized(NumSamples);
+        Y.SetNumUninitialized(NumSamples);
+        Batch.SetNumUninitialized(NumSamples);
+        Reference.SetNumUninitialized(NumSamples);
+
+        // Covering negative coordinates and the 256 wrap of the lattice too
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            X[i] = Stream.FRandRange(-1024.f, 1024.f);
+            Y[i] = Stream.FRandRange(-1024.f, 1024.f);
+        }
+
+        Evaluate_Batch(Table, X.GetData(), Y.GetData(), Batch.GetData(), NumSamples);
+        UNoiseFunctionLibrary::PerlinNoise2D_Batch_Scalar(X.GetData(), Y.GetData(), Reference.GetData(), NumSamples);
+
+        float MaxError = 0.f;
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            MaxError = FMath::Max(MaxError, FMath::Abs(Batch[i] - Reference[i]));
+        }
+
+        return MaxError;
+    }
+
+    // The engine keeps its permutation table private, but all the noise depends on is the gradient picked at each lattice corner,
+    // so we read it once from FMath::PerlinNoise2D itself. Right next to a corner the smooth curve is ~0, and the value is just
+    // the corner gradient dotted with the (A, B) offset, which is different for all the 8 gradients.
+    FLatticeTable::FLatticeTable()
+    {
+        constexpr float A = 1.f / 1024.f;
+        constexpr float B = 3.f / 1024.f;
+
+        // Dot products of the 8 gradients with (1, 3), in units of 1/1024
+        static const int32 Dots[8] = { 1, 4, 3, 2, -1, -4, -3, -2 };
+
+        for (int32 Y = 0; Y < 256; Y++)
+        {
+            for (int32 X = 0; X < 256; X++)
+            {
+                const float Value = FMath::PerlinNoise2D(FVector2D(X + A, Y + B));
+                const int32 Units = FMath::RoundToInt32(Value * 1024.f);
+
+                uint8 Gradient = 0;
+                while (Gradient < 8 && Dots[Gradient] != Units)
+                    Gradient++;
+
+                gradients[Y * 256 + X] = Gradient & 7;
+            }
+        }
+
+        bValid = Validate(*this, 4096, 1337) <= Tolerance;
+
+        if (!bValid)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Batch Perlin kernel does not match FMath::PerlinNoise2D, falling back to the scalar path"));
+        }
+    }
+
+    static const FLatticeTable& GetLatticeTable()
+    {
+        static FLatticeTable table;
+        return table;
+    }
+}
+
+bool UNoiseFunctionLibrary::IsBatchKernelEnabled()
+{
+    return NoiseKernel::GetLatticeTable().bValid;
+}
+
+float UNoiseFunctionLibrary::PerlinNoise2D(
+    const float     X,
+    const float     Y
+)
+{
+    return NoiseKernel::Evaluate(NoiseKernel::GetLatticeTable(), X, Y);
+}
+
+void UNoiseFunctionLibrary::PerlinNoise2D_Batch(
+    const float*    X,
+    const float*    Y,
+    float*          OutNoise,
+    const int32     Num
+)
+{
+    const NoiseKernel::FLatticeTable& Table = NoiseKernel::GetLatticeTable();
+
+    if (!Table.bValid)
+    {
+        PerlinNoise2D_Batch_Scalar(X, Y, OutNoise, Num);
+        return;
+    }
+
+    NoiseKernel::Evaluate_Batch(Table, X, Y, OutNoise, Num);
+}
+
+void UNoiseFunctionLibrary::PerlinNoise2D_Batch_Scalar(
+    const float*    X,
+    const float*    Y,
+    float*          OutNoise,
+    const int32     Num
+)
+{
+    for (int32 i = 0; i < Num; i++)
+    {
+        OutNoise[i] = FMath::PerlinNoise2D(FVector2D(X[i], Y[i]));
+    }
+}
+
+void UNoiseFunctionLibrary::PerlinNoise2D_Batch_Deriv(
+    const float*    X,
+    const float*    Y,
+    float*          OutNoise,
+    float*          OutDX,
+    float*          OutDY,
+    const int32     Num
+)
+{
+    const NoiseKernel::FLatticeTable& Table = NoiseKernel::GetLatticeTable();
+
+    if (Table.bValid)
+    {
+        NoiseKernel::Evaluate_Batch_Deriv(Table, X, Y, OutNoise, OutDX, OutDY, Num);
+        return;
+    }
+
+    // Without a valid lattice table there is nothing to differentiate analytically, so we fall back to central differences
+    constexpr float Epsilon = 1e-3f;
+
+    for (int32 i = 0; i < Num; i++)
+    {
+        OutNoise[i] = FMath::PerlinNoise2D(FVector2D(X[i], Y[i]));
+        OutDX[i] = (FMath::PerlinNoise2D(FVector2D(X[i] + Epsilon, Y[i])) - FMath::PerlinNoise2D(FVector2D(X[i] - Epsilon, Y[i]))) / (2.0f * Epsilon);
+        OutDY[i] = (FMath::PerlinNoise2D(FVector2D(X[i], Y[i] + Epsilon)) - FMath::PerlinNoise2D(FVector2D(X[i], Y[i] - Epsilon))) / (2.0f * Epsilon);
+    }
+}
+
+float UNoiseFunctionLibrary::ValidateBatchKernel(
+    const int32     NumSamples,
+    const int32     Seed
+)
+{
+    return NoiseKernel::Validate(NoiseKernel::GetLatticeTable(), NumSamples, Seed);
+}
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "NoiseFunctionLibrary.generated.h"
+
+UCLASS(BlueprintType)
+class UNoiseFunctionLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+public:
+
+    // Same value as FMath::PerlinNoise2D, read from the lattice table of the batch kernel
+    static float PerlinNoise2D(
+        const float                 X,
+        const float                 Y
+    );
+
+    // Evaluates FMath::PerlinNoise2D for a whole row or tile of samples, four lanes at a time
+    static void PerlinNoise2D_Batch(
+        const float*                X,
+        const float*                Y,
+        float*                      OutNoise,
+        const int32                 Num
+    );
+
+    // Same as PerlinNoise2D_Batch, also returning the analytic derivatives along X and Y
+    static void PerlinNoise2D_Batch_Deriv(
+        const float*                X,
+        const float*                Y,
+        float*                      OutNoise,
+        float*                      OutDX,
+        float*                      OutDY,
+        const int32                 Num
+    );
+
+    // Reference path, one FMath::PerlinNoise2D call per sample
+    static void PerlinNoise2D_Batch_Scalar(
+        const float*                X,
+        const float*                Y,
+        float*                      OutNoise,
+        const int32                 Num
+    );
+
+    UFUNCTION(BlueprintCallable, meta = (ReturnDisplayName = "MaxError", ToolTip = "Compares the batch kernel against FMath::PerlinNoise2D on random samples"))
+    static float ValidateBatchKernel(
+        const int32                 NumSamples = 4096,
+        const int32                 Seed = 1337
+    );
+
+    // False if the kernel failed its validation, in which case the batch calls fall back to FMath::PerlinNoise2D
+    static bool IsBatchKernelEnabled();
+};
@@ -13,7 +13,7 @@ public class ProceduralTerrain : ModuleRules
                                                             "MeshDescription","StaticMeshDescription","MeshConversion",
                                                             });
 
-		PrivateDependencyModuleNames.AddRange(new string[] {  });
+		PrivateDependencyModuleNames.AddRange(new string[] { "RenderCore", "RHI", "Json", "JsonUtilities" });
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
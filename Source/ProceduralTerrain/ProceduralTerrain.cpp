@@ -4,3 +4,32 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ProceduralTerrain, "ProceduralTerrain" );
+
+DEFINE_STAT(STAT_Terrain_RefreshDatas);
+DEFINE_STAT(STAT_Terrain_AskToDisplayChunks);
+DEFINE_STAT(STAT_Terrain_DispatchJobs);
+DEFINE_STAT(STAT_Terrain_UploadChunkLOD);
+DEFINE_STAT(STAT_Terrain_ChunkVisibility);
+DEFINE_STAT(STAT_Terrain_MemoryBudget);
+DEFINE_STAT(STAT_Terrain_ChunkTeardowns);
+DEFINE_STAT(STAT_Terrain_ClipmapUpdate);
+DEFINE_STAT(STAT_Terrain_ClipmapMesh);
+DEFINE_STAT(STAT_Terrain_GenerateChunkLOD);
+DEFINE_STAT(STAT_Terrain_Heightfield);
+DEFINE_STAT(STAT_Terrain_CenterMesh);
+DEFINE_STAT(STAT_Terrain_BorderMeshes);
+DEFINE_STAT(STAT_Terrain_DiskCacheRead);
+DEFINE_STAT(STAT_Terrain_DiskCacheWrite);
+DEFINE_STAT(STAT_Terrain_WriteParts);
+DEFINE_STAT(STAT_Terrain_GatherMeshBatches);
+DEFINE_STAT(STAT_Terrain_QueuedChunks);
+DEFINE_STAT(STAT_Terrain_JobsInFlight);
+DEFINE_STAT(STAT_Terrain_UploadBacklog);
+DEFINE_STAT(STAT_Terrain_ResidentChunks);
+DEFINE_STAT(STAT_Terrain_ResidentSections);
+DEFINE_STAT(STAT_Terrain_ResidentBytes);
+DEFINE_STAT(STAT_Terrain_UploadedChunkLODs);
+DEFINE_STAT(STAT_Terrain_UploadedParts);
+DEFINE_STAT(STAT_Terrain_UploadedBytes);
+DEFINE_STAT(STAT_Terrain_WindowCellsUpdated);
+DEFINE_STAT(STAT_Terrain_ClipmapSampledHeights);
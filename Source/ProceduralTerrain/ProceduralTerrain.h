@@ -3,4 +3,44 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
+// "stat terrain". The cycle counters also show up as events in Insights, the finer stages under them only have trace scopes
+DECLARE_STATS_GROUP(TEXT("Terrain"), STATGROUP_Terrain, STATCAT_Advanced);
+
+// Game thread
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Refresh Datas"), STAT_Terrain_RefreshDatas, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ask To Display Chunks"), STAT_Terrain_AskToDisplayChunks, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Dispatch Jobs"), STAT_Terrain_DispatchJobs, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Upload Chunk LOD"), STAT_Terrain_UploadChunkLOD, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Chunk Visibility"), STAT_Terrain_ChunkVisibility, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Memory Budget"), STAT_Terrain_MemoryBudget, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Chunk Teardowns"), STAT_Terrain_ChunkTeardowns, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Clipmap Update"), STAT_Terrain_ClipmapUpdate, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Clipmap Mesh"), STAT_Terrain_ClipmapMesh, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+
+// Workers
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Chunk LOD"), STAT_Terrain_GenerateChunkLOD, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Heightfield"), STAT_Terrain_Heightfield, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Center Mesh"), STAT_Terrain_CenterMesh, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Border Meshes"), STAT_Terrain_BorderMeshes, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Disk Cache Read"), STAT_Terrain_DiskCacheRead, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Disk Cache Write"), STAT_Terrain_DiskCacheWrite, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+
+// Render thread, terrain proxy only
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Write Parts (RT)"), STAT_Terrain_WriteParts, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Gather Mesh Batches (RT)"), STAT_Terrain_GatherMeshBatches, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+
+// Cleared every frame, every terrain adds its own on top
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Queued Chunks"), STAT_Terrain_QueuedChunks, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Jobs In Flight"), STAT_Terrain_JobsInFlight, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Upload Backlog"), STAT_Terrain_UploadBacklog, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Resident Chunks"), STAT_Terrain_ResidentChunks, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Resident Sections"), STAT_Terrain_ResidentSections, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Resident Chunk Bytes"), STAT_Terrain_ResidentBytes, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Uploaded Chunk LODs"), STAT_Terrain_UploadedChunkLODs, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Uploaded Parts"), STAT_Terrain_UploadedParts, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Uploaded Bytes"), STAT_Terrain_UploadedBytes, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Window Cells Updated"), STAT_Terrain_WindowCellsUpdated, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Clipmap Sampled Heights"), STAT_Terrain_ClipmapSampledHeights, STATGROUP_Terrain, PROCEDURALTERRAIN_API);
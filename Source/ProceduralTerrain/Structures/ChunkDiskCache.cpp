@@ -0,0 +1,686 @@
+#include "ChunkDiskCache.h"
+#include "MeshTopology.h"
+#include "../ProceduralTerrain.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// Every array of a tile is its own block, so the reads decompress straight from the mapping into the arrays
+struct FChunkTileBlockHeader
+{
+    uint32          rawBytes;
+    uint32          storedBytes;            //  Same as rawBytes if the block didn't shrink and is stored as it is
+};
+
+struct FChunkTilePartHeader
+{
+    FVector         origin;                 //  Compact parts only
+    int32           topologyLOD;            //  -1 if the part has its own triangles
+    int32           topologyPart;
+};
+
+struct FChunkTileReader
+{
+    const uint8*    cursor;
+    const uint8*    end;
+
+    template<typename T>
+    bool Read(T& out)
+    {
+        if (end - cursor < (int64)sizeof(T))
+            return false;
+
+        FMemory::Memcpy(&out, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    bool ReadBlock(TArray<T>& out)
+    {
+        FChunkTileBlockHeader header;
+        if (!Read(header) || header.rawBytes % sizeof(T) != 0 || header.storedBytes > header.rawBytes || end - cursor < (int64)header.storedBytes)
+            return false;
+
+        out.SetNumUninitialized(header.rawBytes / sizeof(T));
+
+        if (header.storedBytes == header.rawBytes)
+        {
+            FMemory::Memcpy(out.GetData(), cursor, header.rawBytes);
+        }
+        else if (!FCompression::UncompressMemory(NAME_Oodle, out.GetData(), header.rawBytes, cursor, header.storedBytes))
+        {
+            return false;
+        }
+
+        cursor += header.storedBytes;
+        return true;
+    }
+
+    bool ReadPartHeader(FVector& outOrigin, FMeshTopologyPtr& outTopology)
+    {
+        FChunkTilePartHeader header;
+        if (!Read(header))
+            return false;
+
+        outOrigin = header.origin;
+        outTopology = nullptr;
+
+        if (header.topologyLOD < 0)
+            return true;
+
+        if (header.topologyLOD >= 32 || header.topologyPart < 0 || header.topologyPart > static_cast<int32>(Direction::Center))
+            return false;
+
+        outTopology = FMeshTopologyCache::Get().Find((uint8)header.topologyLOD, static_cast<Direction>(header.topologyPart));
+        return outTopology.IsValid();
+    }
+};
+
+template<typename T>
+static void WriteBlock(TArray<uint8>& out, const TArray<T>& array)
+{
+    const int32 rawBytes = array.Num() * sizeof(T);
+    const int32 headerOffset = out.AddUninitialized(sizeof(FChunkTileBlockHeader));
+
+    int32 storedBytes = FMath::Max(FCompression::CompressMemoryBound(NAME_Oodle, rawBytes), rawBytes);
+    const int32 dataOffset = out.AddUninitialized(storedBytes);
+
+    if (rawBytes == 0
+        || !FCompression::CompressMemory(NAME_Oodle, out.GetData() + dataOffset, storedBytes, array.GetData(), rawBytes)
+        || storedBytes >= rawBytes)
+    {
+        storedBytes = rawBytes;
+        FMemory::Memcpy(out.GetData() + dataOffset, array.GetData(), rawBytes);
+    }
+
+    out.SetNum(dataOffset + storedBytes, EAllowShrinking::No);
+
+    const FChunkTileBlockHeader header = { (uint32)rawBytes, (uint32)storedBytes };
+    FMemory::Memcpy(out.GetData() + headerOffset, &header, sizeof(header));
+}
+
+static void WritePartHeader(TArray<uint8>& out, const FVector& origin, const FMeshTopologyPtr& topology)
+{
+    FChunkTilePartHeader header;
+    header.origin = origin;
+    header.topologyLOD = topology.IsValid() ? topology->LOD : -1;
+    header.topologyPart = topology.IsValid() ? static_cast<int32>(topology->part) : 0;
+
+    out.Append(reinterpret_cast<const uint8*>(&header), sizeof(header));
+}
+
+static void WritePart(TArray<uint8>& out, const FMeshData& mesh)
+{
+    WritePartHeader(out, FVector::ZeroVector, mesh.topology);
+    WriteBlock(out, mesh.vertices);
+    WriteBlock(out, mesh.triangles);
+    WriteBlock(out, mesh.UVs);
+    WriteBlock(out, mesh.normals);
+    WriteBlock(out, mesh.tangents);
+}
+
+static void WritePart(TArray<uint8>& out, const FCompactMeshData& mesh)
+{
+    WritePartHeader(out, mesh.origin, mesh.topology);
+    WriteBlock(out, mesh.positions);
+    WriteBlock(out, mesh.normals);
+    WriteBlock(out, mesh.tangents);
+    WriteBlock(out, mesh.triangles);
+}
+
+static bool ReadPart(FChunkTileReader& reader, FMeshData& mesh)
+{
+    FVector origin;
+    return reader.ReadPartHeader(origin, mesh.topology)
+        && reader.ReadBlock(mesh.vertices)
+        && reader.ReadBlock(mesh.triangles)
+        && reader.ReadBlock(mesh.UVs)
+        && reader.ReadBlock(mesh.normals)
+        && reader.ReadBlock(mesh.tangents);
+}
+
+static bool ReadPart(FChunkTileReader& reader, FCompactMeshData& mesh)
+{
+    return reader.ReadPartHeader(mesh.origin, mesh.topology)
+        && reader.ReadBlock(mesh.positions)
+        && reader.ReadBlock(mesh.normals)
+        && reader.ReadBlock(mesh.tangents)
+        && reader.ReadBlock(mesh.triangles);
+}
+
+// The center, then the normal borders and the downscaled ones, in the format the data was generated in
+static void WriteTile(TArray<uint8>& out, const FChunkLodData& data)
+{
+    if (data.compact)
+    {
+        WritePart(out, data.compactCenter);
+        for (int32 i = 0; i < 4; i++) WritePart(out, data.compactBorders_normal[i]);
+        for (int32 i = 0; i < 4; i++) WritePart(out, data.compactBorders_downscaled[i]);
+    }
+    else
+    {
+        WritePart(out, data.Center);
+        for (int32 i = 0; i < 4; i++) WritePart(out, data.borders_normal[i]);
+        for (int32 i = 0; i < 4; i++) WritePart(out, data.borders_downscaled[i]);
+    }
+}
+
+static bool ReadTile(FChunkTileReader& reader, const bool compact, FChunkLodData& data)
+{
+    data.compact = compact;
+    bool valid;
+
+    if (compact)
+    {
+        valid = ReadPart(reader, data.compactCenter);
+        for (int32 i = 0; i < 4; i++) valid = valid && ReadPart(reader, data.compactBorders_normal[i]);
+        for (int32 i = 0; i < 4; i++) valid = valid && ReadPart(reader, data.compactBorders_downscaled[i]);
+    }
+    else
+    {
+        valid = ReadPart(reader, data.Center);
+        for (int32 i = 0; i < 4; i++) valid = valid && ReadPart(reader, data.borders_normal[i]);
+        for (int32 i = 0; i < 4; i++) valid = valid && ReadPart(reader, data.borders_downscaled[i]);
+    }
+
+    return valid && reader.cursor == reader.end;
+}
+
+static FORCEINLINE int32 FloorDivide(const int32 value, const int32 divisor)
+{
+    return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+bool FChunkDiskCache::FRegion::Map_Locked()
+{
+    if (mappedRegion.IsValid())
+        return true;
+
+    mappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*path));
+    if (!mappedFile.IsValid() || mappedFile->GetFileSize() <= 0)
+    {
+        mappedFile.Reset();
+        return false;
+    }
+
+    mappedRegion.Reset(mappedFile->MapRegion(0, mappedFile->GetFileSize()));
+    if (!mappedRegion.IsValid())
+    {
+        mappedFile.Reset();
+        return false;
+    }
+    return true;
+}
+
+void FChunkDiskCache::FRegion::Unmap_Locked()
+{
+    // The region has to go before the file it maps
+    mappedRegion.Reset();
+    mappedFile.Reset();
+}
+
+bool FChunkDiskCache::FRegion::IsMapped_Locked(const FTileLocation& location) const
+{
+    return mappedRegion.IsValid() && location.offset + (int64)sizeof(FTileHeader) + location.payloadBytes <= mappedRegion->GetMappedSize();
+}
+
+void FChunkDiskCache::FRegion::ScanAppendedTiles_Locked(IFileHandle& file, const int64 fileBytes)
+{
+    int64 offset = validBytes;
+    while (fileBytes - offset >= (int64)sizeof(FTileHeader))
+    {
+        FTileHeader tileHeader;
+        if (!file.Seek(offset) || !file.Read(reinterpret_cast<uint8*>(&tileHeader), sizeof(FTileHeader))
+            || !IsTileHeaderValid(tileHeader, offset, fileBytes))
+            break;
+
+        const FTileKey key = { FIntPoint(tileHeader.chunkX, tileHeader.chunkY), tileHeader.LOD };
+        tiles.Add(key, { offset, tileHeader.payloadBytes, tileHeader.checksum, tileHeader.compact != 0 });
+
+        offset += sizeof(FTileHeader) + tileHeader.payloadBytes;
+    }
+    validBytes = offset;
+}
+
+bool FChunkDiskCache::IsTileHeaderValid(
+    const FTileHeader&          header,
+    const int64                 offset,
+    const int64                 fileBytes
+)
+{
+    return header.magic == TileMagic && header.payloadBytes <= fileBytes - offset - (int64)sizeof(FTileHeader);
+}
+
+FChunkDiskCache& FChunkDiskCache::Get()
+{
+    static FChunkDiskCache instance;
+    return instance;
+}
+
+FIntPoint FChunkDiskCache::GetRegionIndex(const FIntPoint& chunkIndex)
+{
+    return FIntPoint(FloorDivide(chunkIndex.X, RegionWidth), FloorDivide(chunkIndex.Y, RegionWidth));
+}
+
+void FChunkDiskCache::Open(const FString& directory, const int64 maxBytes)
+{
+    FScopeLock lock(&m_lock);
+
+    if (m_users++ > 0)
+    {
+        if (m_directory != directory)
+            UE_LOG(LogTemp, Warning, TEXT("Terrain disk cache: already open on %s, %s is ignored"), *m_directory, *directory);
+        return;
+    }
+
+    m_regions.Empty();
+    m_usedSettings.Empty();
+    m_directory = directory;
+    m_open = FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*m_directory);
+
+    // Nothing of the directory is mapped yet, so any of its settings can go
+    if (m_open && maxBytes > 0)
+        PruneSettings_Locked(maxBytes);
+}
+
+void FChunkDiskCache::Close()
+{
+    FScopeLock lock(&m_lock);
+
+    if (m_users == 0 || --m_users > 0)
+        return;
+
+    m_regions.Empty();
+    m_usedSettings.Empty();
+    m_open = false;
+}
+
+bool FChunkDiskCache::IsOpen() const
+{
+    FScopeLock lock(&m_lock);
+    return m_open;
+}
+
+FString FChunkDiskCache::GetSettingsDirectory_Locked(const uint32 settingsHash) const
+{
+    return FPaths::Combine(m_directory, FString::Printf(TEXT("Settings_%08X"), settingsHash));
+}
+
+void FChunkDiskCache::UseSettings_Locked(const uint32 settingsHash)
+{
+    const FString settingsDirectory = GetSettingsDirectory_Locked(settingsHash);
+    FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*settingsDirectory);
+
+    // Reads don't touch the region files, so the stamp is what tells a directory that is only hit from an unused one
+    FFileHelper::SaveStringToFile(FDateTime::UtcNow().ToString(), *FPaths::Combine(settingsDirectory, TEXT("LastUsed")));
+    m_usedSettings.Add(settingsHash);
+}
+
+void FChunkDiskCache::PruneSettings_Locked(const int64 maxBytes) const
+{
+    struct FSettingsDirectory
+    {
+        FString         path;
+        FDateTime       lastUsed = FDateTime::MinValue();
+        int64           bytes = 0;
+    };
+
+    IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+    TArray<FSettingsDirectory> directories;
+    platformFile.IterateDirectory(*m_directory, [&](const TCHAR* path, bool isDirectory)
+        {
+            if (isDirectory && FPaths::GetCleanFilename(path).StartsWith(TEXT("Settings_")))
+                directories.Add({ path });
+            return true;
+        });
+
+    for (FSettingsDirectory& directory : directories)
+    {
+        platformFile.IterateDirectoryStat(*directory.path, [&](const TCHAR*, const FFileStatData& stat)
+            {
+                if (!stat.bIsDirectory)
+                {
+                    directory.bytes += stat.FileSize;
+                    directory.lastUsed = FMath::Max(directory.lastUsed, stat.ModificationTime);
+                }
+                return true;
+            });
+    }
+
+    directories.Sort([](const FSettingsDirectory& A, const FSettingsDirectory& B) { return A.lastUsed > B.lastUsed; });
+
+    int64 keptBytes = 0;
+    for (int32 i = 0; i < directories.Num(); i++)
+    {
+        if (i > 0 && keptBytes + directories[i].bytes > maxBytes)
+        {
+            UE_LOG(LogTemp, Display, TEXT("Terrain disk cache: deleting %s, %.1f MB unused since %s"),
+                *directories[i].path, directories[i].bytes / (1024.0 * 1024.0), *directories[i].lastUsed.ToString());
+
+            platformFile.DeleteDirectoryRecursively(*directories[i].path);
+            continue;
+        }
+        keptBytes += directories[i].bytes;
+    }
+}
+
+FChunkDiskCache::FRegionPtr FChunkDiskCache::FindRegion(
+    const FIntPoint&            chunkIndex,
+    const uint32                settingsHash
+)
+{
+    FScopeLock lock(&m_lock);
+
+    if (!m_open)
+        return nullptr;
+
+    const FRegionKey key = { settingsHash, GetRegionIndex(chunkIndex) };
+
+    if (const FRegionPtr* region = m_regions.Find(key))
+        return *region;
+
+    if (!m_usedSettings.Contains(settingsHash))
+        UseSettings_Locked(settingsHash);
+
+    FRegionPtr region = OpenRegion_Locked(key);
+    m_regions.Add(key, region);
+    return region;
+}
+
+FChunkDiskCache::FRegionPtr FChunkDiskCache::OpenRegion_Locked(const FRegionKey& key) const
+{
+    FRegionPtr region = MakeShared<FRegion, ESPMode::ThreadSafe>();
+    region->path = FPaths::Combine(GetSettingsDirectory_Locked(key.settingsHash), FString::Printf(TEXT("r.%d.%d.tcr"), key.regionIndex.X, key.regionIndex.Y));
+
+    // Nothing on disk yet, the first store writes the file header
+    if (!region->Map_Locked())
+        return region;
+
+    const uint8* file = region->mappedRegion->GetMappedPtr();
+    const int64 fileBytes = region->mappedRegion->GetMappedSize();
+
+    FFileHeader fileHeader = {};
+    if (fileBytes >= (int64)sizeof(FFileHeader))
+        FMemory::Memcpy(&fileHeader, file, sizeof(FFileHeader));
+
+    const bool validHeader = fileHeader.magic == FileMagic
+        && fileHeader.version == Version
+        && fileHeader.settingsHash == key.settingsHash
+        && fileHeader.regionWidth == RegionWidth;
+
+    // Written by another version of the cache, it starts over
+    if (!validHeader)
+    {
+        region->Unmap_Locked();
+        FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*region->path);
+        return region;
+    }
+
+    int64 offset = sizeof(FFileHeader);
+    while (fileBytes - offset >= (int64)sizeof(FTileHeader))
+    {
+        FTileHeader tileHeader;
+        FMemory::Memcpy(&tileHeader, file + offset, sizeof(FTileHeader));
+
+        if (!IsTileHeaderValid(tileHeader, offset, fileBytes))
+            break;
+
+        const FTileKey key = { FIntPoint(tileHeader.chunkX, tileHeader.chunkY), tileHeader.LOD };
+        region->tiles.Add(key, { offset, tileHeader.payloadBytes, tileHeader.checksum, tileHeader.compact != 0 });
+
+        offset += sizeof(FTileHeader) + tileHeader.payloadBytes;
+    }
+    region->validBytes = offset;
+
+    return region;
+}
+
+void FChunkDiskCache::AddMiss(const bool corrupt)
+{
+    FScopeLock lock(&m_lock);
+
+    m_misses++;
+    if (corrupt)
+        m_corruptTiles++;
+}
+
+bool FChunkDiskCache::Contains(
+    const FIntPoint&            chunkIndex,
+    const uint8                 LOD,
+    const uint32                settingsHash
+)
+{
+    FRegionPtr region = FindRegion(chunkIndex, settingsHash);
+    if (!region.IsValid())
+        return false;
+
+    FReadScopeLock lock(region->lock);
+    return region->tiles.Contains({ chunkIndex, LOD });
+}
+
+FChunkLodData* FChunkDiskCache::Load(
+    const FIntPoint&            chunkIndex,
+    const uint8                 LOD,
+    const uint32                settingsHash
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_DiskCacheRead);
+
+    FRegionPtr region = FindRegion(chunkIndex, settingsHash);
+    if (!region.IsValid())
+        return nullptr;
+
+    const double startTime = FPlatformTime::Seconds();
+    const FTileKey key = { chunkIndex, LOD };
+
+    TUniquePtr<FChunkLodData> data;
+    FTileLocation location;
+
+    // Called with the lock of the region held, the tile has to be in the mapping
+    auto ReadMappedTile = [&]()
+        {
+            const uint8* payload = region->mappedRegion->GetMappedPtr() + location.offset + sizeof(FTileHeader);
+
+            if (FCrc::MemCrc32(payload, location.payloadBytes) == location.checksum)
+            {
+                FChunkTileReader reader = { payload, payload + location.payloadBytes };
+                data = MakeUnique<FChunkLodData>();
+
+                if (!ReadTile(reader, location.compact, *data))
+                    data.Reset();
+            }
+        };
+
+    bool needsMapping = false;
+    {
+        FReadScopeLock lock(region->lock);
+
+        const FTileLocation* found = region->tiles.Find(key);
+        if (!found)
+        {
+            AddMiss(false);
+            return nullptr;
+        }
+        location = *found;
+
+        if (region->IsMapped_Locked(location))
+            ReadMappedTile();
+        else
+            needsMapping = true;
+    }
+
+    // Appended after the file was mapped, the first reader of such a tile maps the file again with all the appends so far
+    if (needsMapping)
+    {
+        FWriteScopeLock lock(region->lock);
+
+        const FTileLocation* found = region->tiles.Find(key);
+        if (found && !region->IsMapped_Locked(*found))
+        {
+            region->Unmap_Locked();
+            region->Map_Locked();
+        }
+
+        if (!found || !region->IsMapped_Locked(*found))
+        {
+            AddMiss(false);
+            return nullptr;
+        }
+        location = *found;
+
+        ReadMappedTile();
+    }
+
+    // A damaged tile is forgotten, so the chunk gets generated and appended again
+    if (!data.IsValid())
+    {
+        {
+            FWriteScopeLock lock(region->lock);
+
+            const FTileLocation* found = region->tiles.Find(key);
+            if (found && found->offset == location.offset)
+                region->tiles.Remove(key);
+        }
+        AddMiss(true);
+        return nullptr;
+    }
+
+    {
+        FScopeLock lock(&m_lock);
+
+        m_hits++;
+        m_bytesRead += location.payloadBytes;
+        m_readSeconds += FPlatformTime::Seconds() - startTime;
+    }
+    return data.Release();
+}
+
+void FChunkDiskCache::Store(
+    const FIntPoint&            chunkIndex,
+    const uint8                 LOD,
+    const uint32                settingsHash,
+    const FChunkLodData&        data
+)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_DiskCacheWrite);
+
+    FRegionPtr region = FindRegion(chunkIndex, settingsHash);
+    if (!region.IsValid())
+        return;
+
+    const FTileKey key = { chunkIndex, LOD };
+    {
+        FReadScopeLock lock(region->lock);
+        if (region->tiles.Contains(key))
+            return;
+    }
+
+    const double startTime = FPlatformTime::Seconds();
+
+    // Compressed before taking the lock, the workers only wait on each other for the append itself
+    TArray<uint8> tile;
+    tile.AddUninitialized(sizeof(FTileHeader));
+    WriteTile(tile, data);
+
+    FTileHeader tileHeader;
+    tileHeader.magic = TileMagic;
+    tileHeader.chunkX = chunkIndex.X;
+    tileHeader.chunkY = chunkIndex.Y;
+    tileHeader.LOD = LOD;
+    tileHeader.compact = data.compact ? 1 : 0;
+    tileHeader.reserved = 0;
+    tileHeader.payloadBytes = tile.Num() - sizeof(FTileHeader);
+    tileHeader.checksum = FCrc::MemCrc32(tile.GetData() + sizeof(FTileHeader), tileHeader.payloadBytes);
+    FMemory::Memcpy(tile.GetData(), &tileHeader, sizeof(FTileHeader));
+
+    {
+        FWriteScopeLock lock(region->lock);
+
+        // Another worker got there first
+        if (region->tiles.Contains(key))
+            return;
+
+        TUniquePtr<IFileHandle> file(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*region->path, true, true));
+        if (!file.IsValid())
+            return;
+
+        if (region->validBytes == 0 && file->Size() == 0)
+        {
+            const FFileHeader fileHeader = { FileMagic, Version, settingsHash, RegionWidth };
+
+            if (!file->Write(reinterpret_cast<const uint8*>(&fileHeader), sizeof(FFileHeader)))
+                return;
+
+            region->validBytes = sizeof(FFileHeader);
+        }
+        else if (region->validBytes == 0)
+        {
+            // Created by another process since the region was opened
+            FFileHeader fileHeader = {};
+            if (!file->Seek(0) || !file->Read(reinterpret_cast<uint8*>(&fileHeader), sizeof(FFileHeader))
+                || fileHeader.magic != FileMagic || fileHeader.version != Version
+                || fileHeader.settingsHash != settingsHash || fileHeader.regionWidth != RegionWidth)
+                return;
+
+            region->validBytes = sizeof(FFileHeader);
+        }
+
+        // Whatever the file got since it was indexed was appended by someone else, it is kept and indexed too.
+        // An incomplete tile at the end may still be being written, the append goes after it
+        const int64 fileBytes = file->Size();
+        if (fileBytes > region->validBytes)
+            region->ScanAppendedTiles_Locked(*file, fileBytes);
+
+        if (region->tiles.Contains(key))
+            return;
+
+        if (!file->Seek(fileBytes) || !file->Write(tile.GetData(), tile.Num()) || !file->Flush())
+        {
+            // Only what this write added goes, the mapping has to let go of the file for it
+            region->Unmap_Locked();
+            file->Truncate(fileBytes);
+            return;
+        }
+
+        region->tiles.Add(key, { fileBytes, tileHeader.payloadBytes, tileHeader.checksum, data.compact });
+        if (region->validBytes == fileBytes)
+            region->validBytes += tile.Num();
+    }
+
+    FScopeLock lock(&m_lock);
+
+    m_writtenTiles++;
+    m_bytesWritten += tile.Num();
+    m_writeSeconds += FPlatformTime::Seconds() - startTime;
+}
+
+FChunkDiskCacheStats FChunkDiskCache::GetStats() const
+{
+    FScopeLock lock(&m_lock);
+
+    FChunkDiskCacheStats stats;
+    stats.open = m_open;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.corruptTiles = m_corruptTiles;
+    stats.writtenTiles = m_writtenTiles;
+    stats.regionFiles = m_regions.Num();
+    stats.bytesRead = m_bytesRead;
+    stats.bytesWritten = m_bytesWritten;
+    stats.readSeconds = m_readSeconds;
+    stats.writeSeconds = m_writeSeconds;
+    return stats;
+}
+
+void FChunkDiskCache::ResetStats()
+{
+    FScopeLock lock(&m_lock);
+
+    m_hits = m_misses = m_corruptTiles = m_writtenTiles = 0;
+    m_bytesRead = m_bytesWritten = 0;
+    m_readSeconds = m_writeSeconds = 0.0;
+}
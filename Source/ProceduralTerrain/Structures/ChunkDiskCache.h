@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Map.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
+#include "Async/MappedFileHandle.h"
+#include "MeshData.h"
+#include "ChunkDiskCache.generated.h"
+
+class IFileHandle;
+
+// Counters of the disk cache, since the last reset
+USTRUCT(BlueprintType)
+struct FChunkDiskCacheStats
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) bool        open = false;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       hits = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       misses = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       corruptTiles = 0;           //  Checksum or layout mismatches, they count as misses too
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       writtenTiles = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       regionFiles = 0;            //  Opened, for every settings
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       bytesRead = 0;              //  Compressed, as they are on disk
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       bytesWritten = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double      readSeconds = 0.0;          //  Checksum and decompression of the hits
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double      writeSeconds = 0.0;         //  Compression and append of the generated tiles
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double      windowFillSeconds = -1.0;   //  From Initialize until the first window was complete, -1 until then. Filled by the generator
+};
+
+// Persistent cache of the generated chunk LODs, a hit skips the generation entirely. Tiles are appended to region files of
+// RegionWidth^2 chunks, one directory per settings hash, and read back through a memory mapping of the file. Terrains with
+// different settings use their own directories side by side. Thread safe
+class FChunkDiskCache
+{
+private:
+    static constexpr uint32                 FileMagic = 0x43525450;         //  "PTRC"
+    static constexpr uint32                 TileMagic = 0x454C4954;         //  "TILE"
+    static constexpr uint32                 Version = 1;
+    static constexpr int32                  RegionWidth = 16;
+
+    struct FFileHeader
+    {
+        uint32          magic;
+        uint32          version;
+        uint32          settingsHash;
+        int32           regionWidth;
+    };
+
+    struct FTileHeader
+    {
+        uint32          magic;
+        int32           chunkX;
+        int32           chunkY;
+        uint8           LOD;
+        uint8           compact;
+        uint16          reserved;
+        uint32          payloadBytes;
+        uint32          checksum;           //  CRC32 of the payload, as stored
+    };
+
+    struct FTileKey
+    {
+        FIntPoint       chunkIndex;
+        uint8           LOD;
+
+        FORCEINLINE bool operator==(const FTileKey& Other) const
+        {
+            return chunkIndex == Other.chunkIndex && LOD == Other.LOD;
+        }
+
+        friend FORCEINLINE uint32 GetTypeHash(const FTileKey& Key)
+        {
+            return HashCombine(GetTypeHash(Key.chunkIndex), Key.LOD);
+        }
+    };
+
+    struct FTileLocation
+    {
+        int64           offset;             //  Of the tile header
+        uint32          payloadBytes;
+        uint32          checksum;
+        bool            compact;
+    };
+
+    // Only the header is checked, the checksum of a tile is verified when it is read
+    static bool IsTileHeaderValid(
+        const FTileHeader&          header,
+        const int64                 offset,
+        const int64                 fileBytes
+    );
+
+    // One region file. The appends keep its mapping, only a read of a tile past the mapped end maps the file again
+    struct FRegion
+    {
+        FString                             path;
+        FRWLock                             lock;
+        TMap<FTileKey, FTileLocation>       tiles;              //  The last tile written for a key wins
+        int64                               validBytes = 0;     //  Up to the last complete tile, the index is scanned again from there
+        TUniquePtr<IMappedFileHandle>       mappedFile;
+        TUniquePtr<IMappedFileRegion>       mappedRegion;
+
+        ~FRegion() { Unmap_Locked(); }
+
+        bool Map_Locked();
+        void Unmap_Locked();
+
+        bool IsMapped_Locked(const FTileLocation& location) const;
+
+        // Indexes the complete tiles another process appended after validBytes
+        void ScanAppendedTiles_Locked(IFileHandle& file, const int64 fileBytes);
+    };
+
+    typedef TSharedPtr<FRegion, ESPMode::ThreadSafe> FRegionPtr;
+
+    struct FRegionKey
+    {
+        uint32          settingsHash;
+        FIntPoint       regionIndex;
+
+        FORCEINLINE bool operator==(const FRegionKey& Other) const
+        {
+            return settingsHash == Other.settingsHash && regionIndex == Other.regionIndex;
+        }
+
+        friend FORCEINLINE uint32 GetTypeHash(const FRegionKey& Key)
+        {
+            return HashCombine(Key.settingsHash, GetTypeHash(Key.regionIndex));
+        }
+    };
+
+    mutable FCriticalSection                m_lock;
+    bool                                    m_open = false;
+    int32                                   m_users = 0;        //  Open calls not closed yet, the cache stays open until the last one
+    FString                                 m_directory;
+    TSet<uint32>                            m_usedSettings;     //  Settings whose directory was marked as used since the cache was opened
+    TMap<FRegionKey, FRegionPtr>            m_regions;          //  Refcounted, so a worker still reading a dropped region keeps it alive
+
+    int64                                   m_hits = 0;
+    int64                                   m_misses = 0;
+    int64                                   m_corruptTiles = 0;
+    int64                                   m_writtenTiles = 0;
+    int64                                   m_bytesRead = 0;
+    int64                                   m_bytesWritten = 0;
+    double                                  m_readSeconds = 0.0;
+    double                                  m_writeSeconds = 0.0;
+
+    FRegionPtr FindRegion(
+        const FIntPoint&            chunkIndex,
+        const uint32                settingsHash
+    );
+
+    FRegionPtr OpenRegion_Locked(const FRegionKey& key) const;
+
+    // Creates the directory of the settings and stamps it, the least recently used directories are the first to go
+    void UseSettings_Locked(const uint32 settingsHash);
+
+    // Deletes the least recently used settings directories until the others fit in maxBytes. The most recent one always stays
+    void PruneSettings_Locked(const int64 maxBytes) const;
+
+    FString GetSettingsDirectory_Locked(const uint32 settingsHash) const;
+
+    void AddMiss(const bool corrupt);
+
+public:
+    static FChunkDiskCache& Get();
+
+    // Region file the chunk is stored in. Only one process can write to a region at a time
+    static FIntPoint GetRegionIndex(const FIntPoint& chunkIndex);
+
+    // The tiles live in directory/Settings_<hash>. With maxBytes, the settings directories that weren't used for the
+    // longest are deleted until the others fit, 0 keeps them all. Every Open needs its Close, the cache is shared
+    // by every terrain and the first one to open it picks the directory
+    void Open(
+        const FString&              directory,
+        const int64                 maxBytes = 0
+    );
+
+    void Close();
+
+    bool IsOpen() const;
+
+    // Whether the chunk LOD has a tile, without reading nor checking it
+    bool Contains(
+        const FIntPoint&            chunkIndex,
+        const uint8                 LOD,
+        const uint32                settingsHash
+    );
+
+    // The cached chunk LOD, nullptr if it was never stored with these settings or if its tile is damaged
+    FChunkLodData* Load(
+        const FIntPoint&            chunkIndex,
+        const uint8                 LOD,
+        const uint32                settingsHash
+    );
+
+    // Appends the chunk LOD to its region file, unless it is already there
+    void Store(
+        const FIntPoint&            chunkIndex,
+        const uint8                 LOD,
+        const uint32                settingsHash,
+        const FChunkLodData&        data
+    );
+
+    FChunkDiskCacheStats GetStats() const;
+
+    void ResetStats();
+};
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Square of slots covering the chunks around the window, that wraps around as the window moves. A chunk keeps the same
+// slot while it stays in the covered area, so a move of one chunk only resets the row and column that left it, and
+// finding a chunk or its neighbors is a bit of arithmetic instead of a hash of its index
+template<typename SlotType>
+class TChunkRingGrid
+{
+private:
+    TArray<SlotType>    m_slots;
+    int32               m_width = 0;
+    FIntPoint           m_origin = FIntPoint::ZeroValue;        //  Chunk at the min corner of the covered area
+
+    FORCEINLINE int32 Wrap(const int32 value) const
+    {
+        const int32 wrapped = value % m_width;
+        return wrapped < 0 ? wrapped + m_width : wrapped;
+    }
+
+    FORCEINLINE SlotType& GetSlot(const int32 X, const int32 Y) { return m_slots[Wrap(Y) * m_width + Wrap(X)]; }
+
+    FORCEINLINE const SlotType& GetSlot(const int32 X, const int32 Y) const { return m_slots[Wrap(Y) * m_width + Wrap(X)]; }
+
+public:
+    FORCEINLINE int32 GetWidth() const { return m_width; }
+
+    FORCEINLINE const FIntPoint& GetOrigin() const { return m_origin; }
+
+    // Every slot is reset, whatever they held has to be released before
+    void Init(const int32 width, const FIntPoint& origin)
+    {
+        m_width = FMath::Max(width, 0);
+        m_origin = origin;
+        m_slots.Reset();
+        m_slots.SetNum(m_width * m_width);
+    }
+
+    FORCEINLINE bool Contains(const FIntPoint& chunkIndex) const
+    {
+        return (uint32)(chunkIndex.X - m_origin.X) < (uint32)m_width && (uint32)(chunkIndex.Y - m_origin.Y) < (uint32)m_width;
+    }
+
+    // nullptr out of the covered area
+    FORCEINLINE SlotType* Find(const FIntPoint& chunkIndex)
+    {
+        return Contains(chunkIndex) ? &GetSlot(chunkIndex.X, chunkIndex.Y) : nullptr;
+    }
+
+    FORCEINLINE const SlotType* Find(const FIntPoint& chunkIndex) const
+    {
+        return Contains(chunkIndex) ? &GetSlot(chunkIndex.X, chunkIndex.Y) : nullptr;
+    }
+
+    // Covers the area starting at newOrigin. leave(chunkIndex, slot) is called for every chunk out of it, then its slot is reset
+    template<typename LeaveFunc>
+    void MoveTo(const FIntPoint& newOrigin, LeaveFunc&& leave)
+    {
+        const FIntPoint move = newOrigin - m_origin;
+        if (move == FIntPoint::ZeroValue || m_width == 0)
+        {
+            m_origin = newOrigin;
+            return;
+        }
+
+        auto Release = [&](const int32 X, const int32 Y)
+            {
+                SlotType& slot = GetSlot(X, Y);
+                leave(FIntPoint(X, Y), slot);
+                slot = SlotType();
+            };
+
+        if (FMath::Abs(move.X) >= m_width || FMath::Abs(move.Y) >= m_width)
+        {
+            for (int32 Y = m_origin.Y; Y < m_origin.Y + m_width; Y++)
+            {
+                for (int32 X = m_origin.X; X < m_origin.X + m_width; X++)
+                    Release(X, Y);
+            }
+        }
+        else
+        {
+            // The columns that left, on every row of the old area, then the rows that left without those columns
+            const int32 leftMinX = move.X > 0 ? m_origin.X : m_origin.X + m_width + move.X;
+            const int32 leftMaxX = move.X > 0 ? m_origin.X + move.X : m_origin.X + m_width;
+            const int32 leftMinY = move.Y > 0 ? m_origin.Y : m_origin.Y + m_width + move.Y;
+            const int32 leftMaxY = move.Y > 0 ? m_origin.Y + move.Y : m_origin.Y + m_width;
+
+            const int32 keptMinX = move.X > 0 ? m_origin.X + move.X : m_origin.X;
+            const int32 keptMaxX = move.X > 0 ? m_origin.X + m_width : m_origin.X + m_width + move.X;
+
+            for (int32 Y = m_origin.Y; Y < m_origin.Y + m_width; Y++)
+            {
+                for (int32 X = leftMinX; X < leftMaxX; X++)
+                    Release(X, Y);
+            }
+
+            for (int32 Y = leftMinY; Y < leftMaxY; Y++)
+            {
+                for (int32 X = keptMinX; X < keptMaxX; X++)
+                    Release(X, Y);
+            }
+        }
+
+        m_origin = newOrigin;
+    }
+
+    // func(chunkIndex, slot) on every slot of the covered area
+    template<typename Func>
+    void ForEach(Func&& func)
+    {
+        for (int32 Y = m_origin.Y; Y < m_origin.Y + m_width; Y++)
+        {
+            for (int32 X = m_origin.X; X < m_origin.X + m_width; X++)
+                func(FIntPoint(X, Y), GetSlot(X, Y));
+        }
+    }
+
+    template<typename Func>
+    void ForEach(Func&& func) const
+    {
+        for (int32 Y = m_origin.Y; Y < m_origin.Y + m_width; Y++)
+        {
+            for (int32 X = m_origin.X; X < m_origin.X + m_width; X++)
+                func(FIntPoint(X, Y), GetSlot(X, Y));
+        }
+    }
+};
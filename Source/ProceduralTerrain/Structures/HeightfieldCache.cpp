@@ -0,0 +1,151 @@
+#include "HeightfieldCache.h"
+
+FHeightfieldCache& FHeightfieldCache::Get()
+{
+    static FHeightfieldCache instance;
+    return instance;
+}
+
+void FHeightfieldCache::SetBudget(const int64 budgetBytes)
+{
+    FScopeLock lock(&m_lock);
+
+    m_defaultBudgetBytes = FMath::Max<int64>(budgetBytes, 0);
+    UpdateBudget_Locked();
+}
+
+void FHeightfieldCache::AddTerrainBudget(const int64 budgetBytes)
+{
+    FScopeLock lock(&m_lock);
+
+    m_terrainBudgetBytes += FMath::Max<int64>(budgetBytes, 0);
+    m_terrainBudgets++;
+    UpdateBudget_Locked();
+}
+
+void FHeightfieldCache::RemoveTerrainBudget(const int64 budgetBytes)
+{
+    FScopeLock lock(&m_lock);
+
+    check(m_terrainBudgets > 0);
+    m_terrainBudgetBytes -= FMath::Max<int64>(budgetBytes, 0);
+
+    // Nobody generates chunks anymore, the heightfields would only sit there
+    if (--m_terrainBudgets == 0)
+    {
+        m_terrainBudgetBytes = 0;
+        m_entries.Empty();
+        m_lru.Empty();
+        m_residentBytes = 0;
+    }
+    UpdateBudget_Locked();
+}
+
+void FHeightfieldCache::UpdateBudget_Locked()
+{
+    m_budgetBytes = m_terrainBudgets > 0 ? m_terrainBudgetBytes : m_defaultBudgetBytes;
+    EvictToBudget_Locked();
+}
+
+FHeightfieldPtr FHeightfieldCache::Find(
+    const FHeightfieldKey&      key,
+    const uint8                 minLevel
+)
+{
+    FScopeLock lock(&m_lock);
+
+    FEntry* entry = m_entries.Find(key);
+    if (!entry || entry->heightfield->level < minLevel)
+    {
+        m_misses++;
+        return nullptr;
+    }
+
+    // Moving the key to the head of the list, so it becomes the most recently used one
+    m_lru.RemoveNode(entry->lruNode, false);
+    m_lru.AddHead(entry->lruNode);
+
+    m_hits++;
+    return entry->heightfield;
+}
+
+void FHeightfieldCache::Add(
+    const FHeightfieldKey&      key,
+    const FHeightfieldPtr&      heightfield
+)
+{
+    check(heightfield.IsValid());
+
+    FScopeLock lock(&m_lock);
+
+    // Another worker might have already cached this chunk while we were sampling it
+    if (const FEntry* existing = m_entries.Find(key))
+    {
+        if (existing->heightfield->level >= heightfield->level)
+            return;
+
+        Remove_Locked(key);
+    }
+
+    FEntry entry;
+    entry.heightfield = heightfield;
+    entry.bytes = heightfield->GetAllocatedSize();
+    entry.lruNode = new TDoubleLinkedList<FHeightfieldKey>::TDoubleLinkedListNode(key);
+
+    m_lru.AddHead(entry.lruNode);
+    m_residentBytes += entry.bytes;
+    m_entries.Add(key, MoveTemp(entry));
+
+    EvictToBudget_Locked();
+}
+
+void FHeightfieldCache::Empty()
+{
+    FScopeLock lock(&m_lock);
+
+    m_entries.Empty();
+    m_lru.Empty();
+    m_residentBytes = 0;
+}
+
+FHeightfieldCacheStats FHeightfieldCache::GetStats() const
+{
+    FScopeLock lock(&m_lock);
+
+    FHeightfieldCacheStats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.entries = m_entries.Num();
+    stats.residentBytes = m_residentBytes;
+    stats.budgetBytes = m_budgetBytes;
+    return stats;
+}
+
+void FHeightfieldCache::ResetStats()
+{
+    FScopeLock lock(&m_lock);
+
+    m_hits = m_misses = m_evictions = 0;
+}
+
+void FHeightfieldCache::EvictToBudget_Locked()
+{
+    // The heightfields themselves are refcounted, so a worker still reading an evicted one keeps it alive
+    while (m_residentBytes > m_budgetBytes && m_lru.GetTail())
+    {
+        const FHeightfieldKey leastRecentKey = m_lru.GetTail()->GetValue();
+        Remove_Locked(leastRecentKey);
+        m_evictions++;
+    }
+}
+
+void FHeightfieldCache::Remove_Locked(const FHeightfieldKey& key)
+{
+    FEntry entry;
+    if (m_entries.RemoveAndCopyValue(key, entry))
+    {
+        m_lru.RemoveNode(entry.lruNode);
+        m_residentBytes -= entry.bytes;
+    }
+}
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Map.h"
+#include "Containers/List.h"
+#include "Misc/ScopeLock.h"
+#include "HeightfieldCache.generated.h"
+
+// Identifies a cached heightfield: the chunk it belongs to and the settings it was sampled with
+struct FHeightfieldKey
+{
+    FIntPoint       chunkIndex;
+    uint32          settingsHash;
+
+    FHeightfieldKey() : chunkIndex(FIntPoint::ZeroValue), settingsHash(0) {}
+    FHeightfieldKey(const FIntPoint& chunkIndexIn, const uint32 settingsHashIn)
+        :   chunkIndex(chunkIndexIn),
+            settingsHash(settingsHashIn)
+    {}
+
+    FORCEINLINE bool operator==(const FHeightfieldKey& Other) const
+    {
+        return chunkIndex == Other.chunkIndex && settingsHash == Other.settingsHash;
+    }
+
+    friend FORCEINLINE uint32 GetTypeHash(const FHeightfieldKey& Key)
+    {
+        return HashCombine(GetTypeHash(Key.chunkIndex), Key.settingsHash);
+    }
+};
+
+// Z values of one chunk, sampled on a (2^level + 1)^2 grid
+struct FHeightfield
+{
+    uint8           level = 0;
+    TArray<float>   heights;
+    TArray<float>   gradientX;      // dZ/dX of every sample, only filled in the analytic normals mode
+    TArray<float>   gradientY;      // dZ/dY
+
+    FORCEINLINE bool HasGradients() const { return gradientX.Num() == heights.Num() && gradientY.Num() == heights.Num(); }
+
+    FORCEINLINE SIZE_T GetAllocatedSize() const
+    {
+        return sizeof(FHeightfield) + heights.GetAllocatedSize() + gradientX.GetAllocatedSize() + gradientY.GetAllocatedSize();
+    }
+};
+
+typedef TSharedPtr<const FHeightfield, ESPMode::ThreadSafe> FHeightfieldPtr;
+
+// Counters of the heightfield cache, since the last reset
+USTRUCT(BlueprintType)
+struct FHeightfieldCacheStats
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       hits = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       misses = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       evictions = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32       entries = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       residentBytes = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64       budgetBytes = 0;
+};
+
+// Thread safe, memory budgeted LRU cache of chunk heightfields, shared by all the generation workers
+class FHeightfieldCache
+{
+private:
+    struct FEntry
+    {
+        FHeightfieldPtr                                         heightfield;
+        TDoubleLinkedList<FHeightfieldKey>::TDoubleLinkedListNode* lruNode = nullptr;
+        int64                                                   bytes = 0;
+    };
+
+    mutable FCriticalSection                m_lock;
+    TMap<FHeightfieldKey, FEntry>           m_entries;
+    TDoubleLinkedList<FHeightfieldKey>      m_lru;              //  head is the most recently used key
+
+    int64                                   m_budgetBytes = 64ll * 1024 * 1024;
+    int64                                   m_defaultBudgetBytes = 64ll * 1024 * 1024;     //  While no terrain added its own
+    int64                                   m_terrainBudgetBytes = 0;
+    int32                                   m_terrainBudgets = 0;
+    int64                                   m_residentBytes = 0;
+
+    int32                                   m_hits = 0;
+    int32                                   m_misses = 0;
+    int32                                   m_evictions = 0;
+
+    void UpdateBudget_Locked();
+
+    void EvictToBudget_Locked();
+    void Remove_Locked(const FHeightfieldKey& key);
+
+public:
+    static FHeightfieldCache& Get();
+
+    ~FHeightfieldCache() { Empty(); }
+
+    // Budget of the cache while no terrain is using it, the commandlets run on this one
+    void SetBudget(const int64 budgetBytes);
+
+    // Every terrain adds its budget while it is initialized, the cache holds their sum
+    void AddTerrainBudget(const int64 budgetBytes);
+
+    // The cache is emptied once the last terrain removed its budget
+    void RemoveTerrainBudget(const int64 budgetBytes);
+
+    // Returns the cached heightfield if it was sampled at least as finely as minLevel
+    FHeightfieldPtr Find(
+        const FHeightfieldKey&      key,
+        const uint8                 minLevel
+    );
+
+    // Stores the heightfield unless a finer one is already cached for the same key
+    void Add(
+        const FHeightfieldKey&      key,
+        const FHeightfieldPtr&      heightfield
+    );
+
+    void Empty();
+
+    FHeightfieldCacheStats GetStats() const;
+
+    void ResetStats();
+};
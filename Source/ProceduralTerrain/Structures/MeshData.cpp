@@ -1,3 +1,189 @@
 ﻿#include "MeshData.h"
+#include "MeshTopology.h"
+#include "../ProceduralTerrain.h"
 #include "KismetProceduralMeshLibrary.h"
-#include "../Libraries/ChunkFunctionLibrary.h"
+
+const TArray<int32>& FMeshData::GetTriangles() const
+{
+    return topology.IsValid() ? topology->triangles : triangles;
+}
+
+uint32 FCompactMeshData::EncodeOctahedral(const FVector3f& N)
+{
+    const float L1 = FMath::Abs(N.X) + FMath::Abs(N.Y) + FMath::Abs(N.Z);
+    float X = (L1 > 0.f) ? N.X / L1 : 0.f;
+    float Y = (L1 > 0.f) ? N.Y / L1 : 0.f;
+
+    // The lower hemisphere is folded over the diagonals of the square
+    if (N.Z < 0.f)
+    {
+        const float FoldedX = (1.f - FMath::Abs(Y)) * (X >= 0.f ? 1.f : -1.f);
+        const float FoldedY = (1.f - FMath::Abs(X)) * (Y >= 0.f ? 1.f : -1.f);
+        X = FoldedX;
+        Y = FoldedY;
+    }
+
+    const int16 QX = (int16)FMath::RoundToInt32(FMath::Clamp(X, -1.f, 1.f) * 32767.f);
+    const int16 QY = (int16)FMath::RoundToInt32(FMath::Clamp(Y, -1.f, 1.f) * 32767.f);
+
+    return (uint32)(uint16)QX | ((uint32)(uint16)QY << 16);
+}
+
+FVector3f FCompactMeshData::DecodeOctahedral(const uint32 packed)
+{
+    float X = (float)(int16)(packed & 0xFFFF) / 32767.f;
+    float Y = (float)(int16)(packed >> 16) / 32767.f;
+    const float Z = 1.f - FMath::Abs(X) - FMath::Abs(Y);
+
+    if (Z < 0.f)
+    {
+        const float UnfoldedX = (1.f - FMath::Abs(Y)) * (X >= 0.f ? 1.f : -1.f);
+        const float UnfoldedY = (1.f - FMath::Abs(X)) * (Y >= 0.f ? 1.f : -1.f);
+        X = UnfoldedX;
+        Y = UnfoldedY;
+    }
+
+    return FVector3f(X, Y, Z).GetSafeNormal();
+}
+
+FCompactMeshData FCompactMeshData::FromMeshData(
+    const FMeshData&            meshData,
+    const FVector&              originIn
+)
+{
+    const int32 Num = meshData.vertices.Num();
+    check(meshData.normals.Num() == Num && meshData.tangents.Num() == Num);
+
+    FCompactMeshData compact;
+    compact.origin = originIn;
+    compact.topology = meshData.topology;
+
+    if (!meshData.topology.IsValid())
+        compact.triangles = meshData.triangles;
+
+    compact.positions.SetNumUninitialized(Num);
+    compact.normals.SetNumUninitialized(Num);
+    compact.tangents.SetNumUninitialized(Num);
+
+    for (int32 i = 0; i < Num; i++)
+    {
+        compact.positions[i] = FVector3f(meshData.vertices[i] - originIn);
+        compact.normals[i] = EncodeOctahedral(FVector3f(meshData.normals[i]));
+        compact.tangents[i] = (EncodeOctahedral(FVector3f(meshData.tangents[i].TangentX)) & ~1u)
+            | (meshData.tangents[i].bFlipTangentY ? 1u : 0u);
+    }
+
+    return compact;
+}
+
+void FCompactMeshData::ToMeshData(
+    FMeshData&                  outMeshData,
+    const float                 UVScale
+) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(FCompactMeshData::ToMeshData);
+
+    const int32 Num = positions.Num();
+
+    outMeshData.topology = topology;
+    outMeshData.triangles = triangles;
+
+    outMeshData.vertices.SetNumUninitialized(Num);
+    outMeshData.UVs.Reset();
+    outMeshData.normals.SetNumUninitialized(Num);
+    outMeshData.tangents.SetNumUninitialized(Num);
+
+    for (int32 i = 0; i < Num; i++)
+    {
+        outMeshData.vertices[i] = origin + FVector(positions[i]);
+        outMeshData.normals[i] = FVector(DecodeOctahedral(normals[i]));
+        outMeshData.tangents[i] = FProcMeshTangent(FVector(DecodeOctahedral(tangents[i] & ~1u)), (tangents[i] & 1u) != 0);
+    }
+
+    // Meshes with their own triangles also had their own UVs, which were XY * UVScale too
+    if (!topology.IsValid())
+    {
+        outMeshData.UVs.SetNumUninitialized(Num);
+        for (int32 i = 0; i < Num; i++)
+            outMeshData.UVs[i] = FVector2D(outMeshData.vertices[i].X, outMeshData.vertices[i].Y) * UVScale;
+    }
+}
+
+void FChunkLodData::Compact(const FVector& origin)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(FChunkLodData::Compact);
+
+    if (compact)
+        return;
+
+    compactCenter = FCompactMeshData::FromMeshData(Center, origin);
+    Center = FMeshData();
+
+    for (int32 i = 0; i < 4; i++)
+    {
+        compactBorders_normal[i] = FCompactMeshData::FromMeshData(borders_normal[i], origin);
+        compactBorders_downscaled[i] = FCompactMeshData::FromMeshData(borders_downscaled[i], origin);
+        borders_normal[i] = FMeshData();
+        borders_downscaled[i] = FMeshData();
+    }
+
+    compact = true;
+}
+
+const FMeshData& FChunkLodData::GetPart(
+    const Direction             dir,
+    const bool                  downscaled,
+    const float                 UVScale,
+    FMeshData&                  scratch
+) const
+{
+    const uint8 side = static_cast<uint8>(dir);
+
+    if (!compact)
+    {
+        if (dir == Direction::Center)
+            return Center;
+        return downscaled ? borders_downscaled[side] : borders_normal[side];
+    }
+
+    const FCompactMeshData& part = (dir == Direction::Center) ? compactCenter :
+        (downscaled ? compactBorders_downscaled[side] : compactBorders_normal[side]);
+
+    part.ToMeshData(scratch, UVScale);
+    return scratch;
+}
+
+SIZE_T FChunkLodData::GetAllocatedSize() const
+{
+    SIZE_T bytes = Center.GetAllocatedSize() + compactCenter.GetAllocatedSize();
+
+    for (int32 i = 0; i < 4; i++)
+    {
+        bytes += borders_normal[i].GetAllocatedSize() + borders_downscaled[i].GetAllocatedSize();
+        bytes += compactBorders_normal[i].GetAllocatedSize() + compactBorders_downscaled[i].GetAllocatedSize();
+    }
+    return bytes;
+}
+
+SIZE_T FChunkLodData::GetExpandedSize() const
+{
+    static constexpr SIZE_T VertexBytes = sizeof(FVector) * 2 + sizeof(FVector2D) + sizeof(FProcMeshTangent);
+
+    auto GetPartSize = [](const FMeshData& mesh, const FCompactMeshData& compactMesh) -> SIZE_T
+        {
+            const int32 Num = mesh.vertices.Num() + compactMesh.Num();
+            const TArray<int32>& triangles = compactMesh.Num() > 0 ?
+                (compactMesh.topology.IsValid() ? compactMesh.topology->triangles : compactMesh.triangles) : mesh.GetTriangles();
+
+            return Num * VertexBytes + triangles.Num() * sizeof(int32);
+        };
+
+    SIZE_T bytes = GetPartSize(Center, compactCenter);
+
+    for (int32 i = 0; i < 4; i++)
+    {
+        bytes += GetPartSize(borders_normal[i], compactBorders_normal[i]);
+        bytes += GetPartSize(borders_downscaled[i], compactBorders_downscaled[i]);
+    }
+    return bytes;
+}
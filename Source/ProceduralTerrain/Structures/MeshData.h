@@ -7,6 +7,9 @@
 #include "ProceduralMeshComponent.h"
 #include "MeshData.generated.h"
 
+struct FMeshTopology;
+typedef TSharedPtr<const FMeshTopology, ESPMode::ThreadSafe> FMeshTopologyPtr;
+
 // Structure to hold mesh data
 USTRUCT(BlueprintType)
 struct FMeshData
@@ -22,6 +25,9 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadOnly) TArray<FVector>             normals;
     UPROPERTY(EditAnywhere, BlueprintReadOnly) TArray<FProcMeshTangent>    tangents;
 
+    // Shared triangles of the chunk part, in which case triangles and UVs stay empty and the UVs come from the vertices
+    FMeshTopologyPtr                                                       topology;
+
     FMeshData() {}
 
 	// Copy constructor
@@ -31,6 +37,7 @@ public:
         , UVs(meshData.UVs)
         , normals(meshData.normals)
         , tangents(meshData.tangents)
+        , topology(meshData.topology)
     {
     }
 
@@ -41,15 +48,20 @@ public:
         , UVs(MoveTemp(Other.UVs))
         , normals(MoveTemp(Other.normals))
         , tangents(MoveTemp(Other.tangents))
+        , topology(MoveTemp(Other.topology))
     {
     }
 
 	// Pre-allocate arrays based on expected vertex count
-    FMeshData(const FVector2D vertexCount, const bool includeNormalsAndTangents = false)
+    FMeshData(const FVector2D vertexCount, const bool includeNormalsAndTangents = false, const bool includeTrianglesAndUVs = true)
     {
         vertices.Reserve(vertexCount.X * vertexCount.Y);
-        UVs.Reserve(vertexCount.X * vertexCount.Y);
-        triangles.Reserve((vertexCount.X - 1) * (vertexCount.Y - 1) * 6);
+
+        if (includeTrianglesAndUVs)
+        {
+            UVs.Reserve(vertexCount.X * vertexCount.Y);
+            triangles.Reserve((vertexCount.X - 1) * (vertexCount.Y - 1) * 6);
+        }
 
         if (includeNormalsAndTangents)
         {
@@ -58,6 +70,15 @@ public:
         }
     }
 
+    // The shared triangles if there are some, the owned ones otherwise
+    const TArray<int32>& GetTriangles() const;
+
+    FORCEINLINE SIZE_T GetAllocatedSize() const
+    {
+        return vertices.GetAllocatedSize() + triangles.GetAllocatedSize() + UVs.GetAllocatedSize()
+            + normals.GetAllocatedSize() + tangents.GetAllocatedSize();
+    }
+
     // Copy assignment
     FMeshData& operator=(const FMeshData& Other)
     {
@@ -68,6 +89,7 @@ public:
             UVs = Other.UVs;
             normals = Other.normals;
             tangents = Other.tangents;
+            topology = Other.topology;
         }
         return *this;
     }
@@ -82,12 +104,46 @@ public:
             UVs = MoveTemp(Other.UVs);
             normals = MoveTemp(Other.normals);
             tangents = MoveTemp(Other.tangents);
+            topology = MoveTemp(Other.topology);
         }
         return *this;
     }
 };
 
 
+// Storage format of a FMeshData: float positions relative to the chunk origin, and normals and tangents packed into
+// two 16 bit octahedral coordinates. UVs are not stored, they come from the positions like for the shared topologies.
+// It only expands back into a FMeshData when it gets uploaded
+struct FCompactMeshData
+{
+    FVector                 origin = FVector::ZeroVector;
+    TArray<FVector3f>       positions;
+    TArray<uint32>          normals;
+    TArray<uint32>          tangents;           //  The lowest bit holds bFlipTangentY
+    TArray<int32>           triangles;          //  Only if the source mesh had no shared topology
+    FMeshTopologyPtr        topology;
+
+    static FCompactMeshData FromMeshData(
+        const FMeshData&            meshData,
+        const FVector&              originIn
+    );
+
+    void ToMeshData(
+        FMeshData&                  outMeshData,
+        const float                 UVScale
+    ) const;
+
+    FORCEINLINE int32 Num() const { return positions.Num(); }
+
+    FORCEINLINE SIZE_T GetAllocatedSize() const
+    {
+        return positions.GetAllocatedSize() + normals.GetAllocatedSize() + tangents.GetAllocatedSize() + triangles.GetAllocatedSize();
+    }
+
+    static uint32 EncodeOctahedral(const FVector3f& N);
+    static FVector3f DecodeOctahedral(const uint32 packed);
+};
+
 // Directions for chunk borders
 UENUM(BlueprintType)
 enum class Direction : uint8 {
@@ -133,6 +189,11 @@ public:
         const int8 mask = (1u << static_cast<int>(direction));
         return (downscales_masked & mask) != 0;
     }
+
+    FORCEINLINE bool operator==(const FChunkLodInfos& other) const
+    {
+        return LOD == other.LOD && downscales_masked == other.downscales_masked;
+    }
 };
 
 // Structure to manage which LODs are active for a chunk
@@ -188,11 +249,33 @@ public:
     FMeshData           borders_normal[4];
     FMeshData           borders_downscaled[4];
 
+    // Same parts in the compact format, the ones above are empty if these are used
+    bool                compact = false;
+    FCompactMeshData    compactCenter;
+    FCompactMeshData    compactBorders_normal[4];
+    FCompactMeshData    compactBorders_downscaled[4];
+
     FChunkLodData() = default;
     FChunkLodData(const FChunkLodData& Other) = default;
     FChunkLodData(FChunkLodData&& Other) noexcept = default;
     FChunkLodData& operator=(const FChunkLodData& Other) = default;
     FChunkLodData& operator=(FChunkLodData&& Other) noexcept = default;
+
+    // Moves every part into the compact format, with positions relative to origin
+    void Compact(const FVector& origin);
+
+    // The part in the full format, expanded into scratch if the data is compact
+    const FMeshData& GetPart(
+        const Direction             dir,
+        const bool                  downscaled,
+        const float                 UVScale,
+        FMeshData&                  scratch
+    ) const;
+
+    SIZE_T GetAllocatedSize() const;
+
+    // What the same parts take in the full format, with their own triangles and UVs
+    SIZE_T GetExpandedSize() const;
 };
 
 // Structure to manage multiple LODs for a chunk
@@ -203,7 +286,9 @@ struct FChunkData
 
 private:
     TArray<FChunkLodData>   m_LODs;
+    TArray<FBox>            m_LODBounds;
     uint32                  m_LODMask = 0;
+    uint32                  m_LODDataMask = 0;          //  LODs whose data is still held, the others were released after their upload
 public:
 
     inline bool ContainsLOD(uint8 index) const 
@@ -212,16 +297,30 @@ public:
         return (m_LODMask & (1u << index)) != 0; 
     }
 
+    inline bool IsLODDataResident(uint8 index) const
+    {
+		check(index < 32);
+        return (m_LODDataMask & (1u << index)) != 0;
+    }
+
     FORCEINLINE FChunkLodData& GetLOD(uint8 index) 
     {
-		check(m_LODs.IsValidIndex(index));
+		check(m_LODs.IsValidIndex(index) && IsLODDataResident(index));
         return m_LODs[index]; 
     }
 
+    FORCEINLINE const FBox& GetLODBounds(uint8 index) const
+    {
+		check(m_LODBounds.IsValidIndex(index));
+        return m_LODBounds[index];
+    }
+
     void Reset()
     {
         m_LODs.Reset();
+        m_LODBounds.Reset();
         m_LODMask = 0;
+        m_LODDataMask = 0;
     }
 
 	// Initialize the chunk data with a maximum LOD
@@ -229,22 +328,60 @@ public:
     {
 		check(maxLOD < 32);
         m_LODs.SetNum(maxLOD + 1);
+        m_LODBounds.Init(FBox(ForceInit), maxLOD + 1);
         m_LODMask = 0;
+        m_LODDataMask = 0;
+    }
+
+    SIZE_T GetAllocatedSize() const
+    {
+        SIZE_T bytes = m_LODs.GetAllocatedSize();
+        for (const FChunkLodData& data : m_LODs)
+            bytes += data.GetAllocatedSize();
+        return bytes;
+    }
+
+    SIZE_T GetExpandedSize() const
+    {
+        SIZE_T bytes = m_LODs.GetAllocatedSize();
+        for (const FChunkLodData& data : m_LODs)
+            bytes += data.GetExpandedSize();
+        return bytes;
     }
 
     FORCEINLINE void RemoveLOD(uint8 index)
     {
 		check(m_LODs.IsValidIndex(index));
         m_LODs[index] = FChunkLodData{};
+        m_LODBounds[index] = FBox(ForceInit);
         m_LODMask &= (~(1u << index));
+        m_LODDataMask &= (~(1u << index));
     }
 
-    FORCEINLINE void AddNewLOD(uint8 index, FChunkLodData&& data)
+    FORCEINLINE void AddNewLOD(uint8 index, FChunkLodData&& data, const FBox& bounds)
     {
 		check(m_LODs.IsValidIndex(index));
 
         m_LODs[index] = MoveTemp(data);
+        m_LODBounds[index] = bounds;
         m_LODMask |= (1u << index);
+        m_LODDataMask |= (1u << index);
+    }
+
+    // Frees the data of the LOD, it still counts as present
+    FORCEINLINE void ReleaseLODData(uint8 index)
+    {
+		check(m_LODs.IsValidIndex(index));
+        m_LODs[index] = FChunkLodData{};
+        m_LODDataMask &= (~(1u << index));
+    }
+
+    // Gives back the data of a LOD that was released, it has to be the same the LOD was uploaded with
+    FORCEINLINE void RestoreLODData(uint8 index, FChunkLodData&& data)
+    {
+		check(m_LODs.IsValidIndex(index) && ContainsLOD(index));
+        m_LODs[index] = MoveTemp(data);
+        m_LODDataMask |= (1u << index);
     }
 
     FORCEINLINE int32 GetMaxLowerLOD(int32 maxLOD) const
@@ -0,0 +1,105 @@
+#include "MeshTopology.h"
+
+FMeshTopologyCache& FMeshTopologyCache::Get()
+{
+    static FMeshTopologyCache instance;
+    return instance;
+}
+
+FMeshTopologyPtr FMeshTopologyCache::Find(
+    const uint8                 LOD,
+    const Direction             part
+)
+{
+    const int32 slot = LOD * NumParts + static_cast<int32>(part);
+
+    FScopeLock lock(&m_lock);
+
+    if (m_topologies.IsValidIndex(slot) && m_topologies[slot].IsValid())
+        return m_topologies[slot];
+
+    // The triangles are small next to the vertices, building them while holding the lock keeps every part built only once
+    TSharedPtr<FMeshTopology, ESPMode::ThreadSafe> topology = MakeShared<FMeshTopology, ESPMode::ThreadSafe>();
+    topology->LOD = LOD;
+    topology->part = part;
+    topology->triangles = (part == Direction::Center) ? BuildCenterTriangles(LOD) : BuildBorderTriangles(LOD, part);
+
+    if (m_topologies.Num() <= slot)
+        m_topologies.SetNum(slot + 1);
+
+    m_topologies[slot] = topology;
+    return topology;
+}
+
+void FMeshTopologyCache::Empty()
+{
+    FScopeLock lock(&m_lock);
+
+    m_topologies.Empty();
+}
+
+int64 FMeshTopologyCache::GetResidentBytes() const
+{
+    FScopeLock lock(&m_lock);
+
+    int64 bytes = 0;
+    for (const FMeshTopologyPtr& topology : m_topologies)
+    {
+        if (topology.IsValid())
+            bytes += topology->GetAllocatedSize();
+    }
+    return bytes;
+}
+
+TArray<int32> FMeshTopologyCache::BuildCenterTriangles(const uint8 LOD)
+{
+    const int32 Width = (1 << LOD) - 1;
+
+    TArray<int32> triangles;
+    triangles.Reserve(FMath::Max(Width - 1, 0) * FMath::Max(Width - 1, 0) * 6);
+
+    for (int32 Y = 1; Y < Width; Y++)
+    {
+        for (int32 X = 1; X < Width; X++)
+        {
+            const int32 Indx = Y * Width + X;
+            const int32 B = Indx - Width;
+            const int32 C = B - 1;
+            const int32 D = Indx - 1;
+
+            triangles.Append({ Indx, B, C, Indx, C, D });
+        }
+    }
+
+    return triangles;
+}
+
+TArray<int32> FMeshTopologyCache::BuildBorderTriangles(const uint8 LOD, const Direction part)
+{
+    check(part != Direction::Center);
+
+    const int32 realWidth = (1 << LOD) + 3;
+    const bool mirrored = (part == Direction::Down || part == Direction::Left);
+
+    TArray<int32> triangles;
+    triangles.Reserve(FMath::Max(realWidth - 5, 0) * 6 + 6);
+
+    for (int32 i = realWidth - 2; i < 2 * realWidth - 7; i++)
+    {
+        const int32 A = i - (realWidth - 3);
+        const int32 B = A + 1;
+        const int32 C = i;
+
+        if (mirrored)
+            triangles.Append({ C, B, i + 1,  A, B, C });
+        else
+            triangles.Append({ C, i + 1, B,  A, C, B });
+    }
+
+    if (mirrored)
+        triangles.Append({ 1, realWidth - 2, 0,  realWidth - 3, 2 * realWidth - 7, realWidth - 4 });
+    else
+        triangles.Append({ 1, 0, realWidth - 2,  realWidth - 3, realWidth - 4, 2 * realWidth - 7 });
+
+    return triangles;
+}
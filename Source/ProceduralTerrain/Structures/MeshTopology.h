@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeLock.h"
+#include "MeshData.h"
+
+// Triangles of one part of a chunk. They only depend on the LOD and the direction of the part, never on the chunk,
+// so every chunk mesh references the same immutable copy instead of owning its own
+struct FMeshTopology
+{
+    uint8           LOD = 0;
+    Direction       part = Direction::Center;
+    TArray<int32>   triangles;
+
+    FORCEINLINE SIZE_T GetAllocatedSize() const
+    {
+        return sizeof(FMeshTopology) + triangles.GetAllocatedSize();
+    }
+};
+
+// Thread safe cache of the topologies, every one of them is built the first time a worker asks for it
+class FMeshTopologyCache
+{
+private:
+    static constexpr int32                  NumParts = 5;
+
+    mutable FCriticalSection                m_lock;
+    TArray<FMeshTopologyPtr>                m_topologies;       //  LOD * NumParts + part
+
+public:
+    static FMeshTopologyCache& Get();
+
+    FMeshTopologyPtr Find(
+        const uint8                 LOD,
+        const Direction             part
+    );
+
+    void Empty();
+
+    int64 GetResidentBytes() const;
+
+    // Same triangles the center builders used to emit, over the (2^LOD - 1)^2 inner vertices
+    static TArray<int32> BuildCenterTriangles(const uint8 LOD);
+
+    // Same triangles the border builders used to emit, over their two rows. Down and Left are mirrored
+    static TArray<int32> BuildBorderTriangles(const uint8 LOD, const Direction part);
+};
@@ -0,0 +1,523 @@
+#include "NoiseGraph.h"
+#include "../Libraries/NoiseFunctionLibrary.h"
+#include "../ProceduralTerrain.h"
+
+bool FNoiseProgram::m_profiling = false;
+
+// Shift between the octaves, so they don't all start on the same lattice corner
+static const FVector2D OctaveShift = FVector2D(37.17, 91.53);
+
+FNoiseGraph FNoiseGraph::MakeDefault()
+{
+    FNoiseGraph graph;
+    graph.nodes.AddDefaulted();
+    return graph;
+}
+
+uint32 FNoiseGraph::GetHash() const
+{
+    uint32 hash = GetTypeHash(outputNode);
+
+    for (const FNoiseGraphNode& node : nodes)
+    {
+        hash = HashCombine(hash, GetTypeHash(static_cast<uint8>(node.type)));
+        hash = HashCombine(hash, GetTypeHash(node.inputA));
+        hash = HashCombine(hash, GetTypeHash(node.inputB));
+        hash = HashCombine(hash, GetTypeHash(node.coordinates));
+        hash = HashCombine(hash, GetTypeHash(node.frequency));
+        hash = HashCombine(hash, GetTypeHash(node.amplitude));
+        hash = HashCombine(hash, GetTypeHash(node.offset));
+        hash = HashCombine(hash, GetTypeHash(node.octaves));
+        hash = HashCombine(hash, GetTypeHash(node.lacunarity));
+        hash = HashCombine(hash, GetTypeHash(node.gain));
+        hash = HashCombine(hash, GetTypeHash(node.warpStrength));
+    }
+
+    return hash;
+}
+
+struct FNoiseProgram::FScratch
+{
+    TArray<double>      coordsX;
+    TArray<double>      coordsY;
+    TArray<float>       values;
+
+    // Only allocated when the gradients are asked for: world space derivatives of the values,
+    // and the jacobian of every coordinate register but the world position one, which is the identity
+    TArray<float>       valuesDX;
+    TArray<float>       valuesDY;
+    TArray<float>       jacobians;
+
+    float               noiseX[TileSize];
+    float               noiseY[TileSize];
+    float               noise[TileSize];
+    float               noiseDX[TileSize];
+    float               noiseDY[TileSize];
+
+    FScratch(const int32 numCoordinateRegisters, const int32 numValueRegisters, const bool gradients)
+    {
+        coordsX.SetNumUninitialized(numCoordinateRegisters * TileSize);
+        coordsY.SetNumUninitialized(numCoordinateRegisters * TileSize);
+        values.SetNumUninitialized(numValueRegisters * TileSize);
+
+        if (gradients)
+        {
+            valuesDX.SetNumUninitialized(numValueRegisters * TileSize);
+            valuesDY.SetNumUninitialized(numValueRegisters * TileSize);
+            jacobians.SetNumUninitialized(numCoordinateRegisters * TileSize * 4);
+        }
+    }
+
+    FORCEINLINE double* X(const int32 reg)      { return coordsX.GetData() + reg * TileSize; }
+    FORCEINLINE double* Y(const int32 reg)      { return coordsY.GetData() + reg * TileSize; }
+    FORCEINLINE float* Value(const int32 reg)   { return values.GetData() + reg * TileSize; }
+    FORCEINLINE float* ValueDX(const int32 reg) { return valuesDX.GetData() + reg * TileSize; }
+    FORCEINLINE float* ValueDY(const int32 reg) { return valuesDY.GetData() + reg * TileSize; }
+
+    // dX/dWorldX, dX/dWorldY, dY/dWorldX, dY/dWorldY of a coordinate register, interleaved per sample
+    FORCEINLINE float* Jacobian(const int32 reg) { return jacobians.GetData() + reg * TileSize * 4; }
+};
+
+TSharedPtr<FNoiseProgram, ESPMode::ThreadSafe> FNoiseProgram::Compile(
+    const FNoiseGraph&      graph,
+    const float             frequencyScale,
+    FString*                outError
+)
+{
+    auto Fail = [outError](const FString& error) -> TSharedPtr<FNoiseProgram, ESPMode::ThreadSafe>
+        {
+            if (outError)
+                *outError = error;
+            return nullptr;
+        };
+
+    const int32 numNodes = graph.nodes.Num();
+    if (numNodes == 0)
+        return Fail(TEXT("The noise graph has no nodes"));
+
+    const int32 outputNode = graph.outputNode < 0 ? numNodes - 1 : graph.outputNode;
+    if (outputNode >= numNodes)
+        return Fail(FString::Printf(TEXT("Output node %d does not exist"), outputNode));
+
+    TSharedPtr<FNoiseProgram, ESPMode::ThreadSafe> program = MakeShared<FNoiseProgram, ESPMode::ThreadSafe>();
+
+    // Each node gets its own register: value registers for the heights, coordinate registers for the warps
+    TArray<int32> registers;
+    registers.Init(-1, numNodes);
+
+    auto IsWarp = [&](const int32 indx) { return graph.nodes[indx].type == ENoiseNodeType::DomainWarp; };
+
+    auto ValueInput = [&](const int32 nodeIndx, const int32 input, const bool optional, int32& outRegister) -> bool
+        {
+            outRegister = -1;
+            if (input < 0)
+                return optional;
+            if (input >= nodeIndx || IsWarp(input))
+                return false;
+            outRegister = registers[input];
+            return true;
+        };
+
+    for (int32 i = 0; i < numNodes; i++)
+    {
+        const FNoiseGraphNode& node = graph.nodes[i];
+
+        FInstruction inst;
+        inst.node = i;
+
+        if (node.coordinates >= 0 && (node.coordinates >= i || !IsWarp(node.coordinates)))
+            return Fail(FString::Printf(TEXT("Node %d reads its coordinates from node %d, which is not an earlier DomainWarp"), i, node.coordinates));
+
+        inst.coords = node.coordinates < 0 ? 0 : registers[node.coordinates];
+
+        switch (node.type)
+        {
+        case ENoiseNodeType::Perlin:
+        case ENoiseNodeType::FBm:
+        case ENoiseNodeType::Ridged:
+            inst.op = EOp::Octaves;
+            inst.ridged = node.type == ENoiseNodeType::Ridged;
+            inst.octaves = node.type == ENoiseNodeType::Perlin ? 1 : FMath::Clamp(node.octaves, 1, 16);
+            inst.frequency = (double)frequencyScale * (double)node.frequency;
+            inst.amplitude = node.amplitude;
+            inst.lacunarity = node.lacunarity;
+            inst.gain = node.gain;
+            inst.offset = node.offset;
+            break;
+
+        case ENoiseNodeType::DomainWarp:
+            inst.op = EOp::Warp;
+            inst.warpStrength = node.warpStrength;
+            if (!ValueInput(i, node.inputA, false, inst.srcA) || !ValueInput(i, node.inputB, true, inst.srcB))
+                return Fail(FString::Printf(TEXT("DomainWarp node %d needs earlier value nodes as its inputs"), i));
+            break;
+
+        case ENoiseNodeType::Add:
+        case ENoiseNodeType::Multiply:
+            inst.op = node.type == ENoiseNodeType::Add ? EOp::Add : EOp::Multiply;
+            if (!ValueInput(i, node.inputA, false, inst.srcA) || !ValueInput(i, node.inputB, false, inst.srcB))
+                return Fail(FString::Printf(TEXT("Node %d needs two earlier value nodes as its inputs"), i));
+            break;
+
+        case ENoiseNodeType::Constant:
+            inst.op = EOp::Constant;
+            inst.amplitude = node.amplitude;
+            break;
+        }
+
+        inst.dest = registers[i] = (inst.op == EOp::Warp) ? program->m_numCoordinateRegisters++ : program->m_numValueRegisters++;
+
+        program->m_instructions.Add(inst);
+        program->m_nodeTypes.Add(node.type);
+    }
+
+    if (IsWarp(outputNode))
+        return Fail(TEXT("The output node can't be a DomainWarp"));
+
+    program->m_outputRegister = registers[outputNode];
+    program->m_hash = HashCombine(graph.GetHash(), GetTypeHash(frequencyScale));
+    program->m_nodeCycles.SetNum(numNodes);
+    program->m_nodeSamples.SetNum(numNodes);
+
+    return program;
+}
+
+template<bool bGradients>
+void FNoiseProgram::EvaluateTile(
+    FScratch&       scratch,
+    const int32     num,
+    float*          outValues,
+    float*          outGradX,
+    float*          outGradY
+) const
+{
+    for (const FInstruction& inst : m_instructions)
+    {
+        const uint64 startCycles = m_profiling ? FPlatformTime::Cycles64() : 0;
+
+        switch (inst.op)
+        {
+        case EOp::Octaves:
+        {
+            float* dest = scratch.Value(inst.dest);
+            const double* X = scratch.X(inst.coords);
+            const double* Y = scratch.Y(inst.coords);
+
+            double frequency = inst.frequency;
+            float amplitude = inst.amplitude;
+            FVector2D offset = inst.offset;
+
+            FMemory::Memzero(dest, num * sizeof(float));
+
+            float* destDX = nullptr;
+            float* destDY = nullptr;
+            const float* jacobian = nullptr;
+
+            if constexpr (bGradients)
+            {
+                destDX = scratch.ValueDX(inst.dest);
+                destDY = scratch.ValueDY(inst.dest);
+                jacobian = inst.coords == 0 ? nullptr : scratch.Jacobian(inst.coords);
+
+                FMemory::Memzero(destDX, num * sizeof(float));
+                FMemory::Memzero(destDY, num * sizeof(float));
+            }
+
+            // All the octaves of the tile are fused here, one batch kernel call each
+            for (int32 octave = 0; octave < inst.octaves; octave++)
+            {
+                for (int32 i = 0; i < num; i++)
+                {
+                    scratch.noiseX[i] = (float)(X[i] * frequency + offset.X);
+                    scratch.noiseY[i] = (float)(Y[i] * frequency + offset.Y);
+                }
+
+                if constexpr (bGradients)
+                {
+                    UNoiseFunctionLibrary::PerlinNoise2D_Batch_Deriv(scratch.noiseX, scratch.noiseY, scratch.noise, scratch.noiseDX, scratch.noiseDY, num);
+
+                    // Back to world space, through the frequency and the jacobian of the coordinates
+                    for (int32 i = 0; i < num; i++)
+                    {
+                        float DX = scratch.noiseDX[i];
+                        float DY = scratch.noiseDY[i];
+
+                        if (jacobian)
+                        {
+                            const float* J = jacobian + i * 4;
+                            const float WorldDX = DX * J[0] + DY * J[2];
+                            const float WorldDY = DX * J[1] + DY * J[3];
+                            DX = WorldDX;
+                            DY = WorldDY;
+                        }
+
+                        scratch.noiseDX[i] = DX * (float)frequency;
+                        scratch.noiseDY[i] = DY * (float)frequency;
+                    }
+                }
+                else
+                {
+                    UNoiseFunctionLibrary::PerlinNoise2D_Batch(scratch.noiseX, scratch.noiseY, scratch.noise, num);
+                }
+
+                if (inst.ridged)
+                {
+                    for (int32 i = 0; i < num; i++)
+                    {
+                        const float ridge = 1.f - FMath::Abs(scratch.noise[i]);
+                        dest[i] += ridge * ridge * amplitude;
+
+                        if constexpr (bGradients)
+                        {
+                            const float slope = -2.f * ridge * FMath::Sign(scratch.noise[i]) * amplitude;
+                            destDX[i] += slope * scratch.noiseDX[i];
+                            destDY[i] += slope * scratch.noiseDY[i];
+                        }
+                    }
+                }
+                else
+                {
+                    for (int32 i = 0; i < num; i++)
+                    {
+                        dest[i] += scratch.noise[i] * amplitude;
+
+                        if constexpr (bGradients)
+                        {
+                            destDX[i] += scratch.noiseDX[i] * amplitude;
+                            destDY[i] += scratch.noiseDY[i] * amplitude;
+                        }
+                    }
+                }
+
+                frequency *= inst.lacunarity;
+                amplitude *= inst.gain;
+                offset += OctaveShift;
+            }
+            break;
+        }
+
+        case EOp::Warp:
+        {
+            const double* X = scratch.X(inst.coords);
+            const double* Y = scratch.Y(inst.coords);
+            const int32 srcB = inst.srcB >= 0 ? inst.srcB : inst.srcA;
+            const float* A = scratch.Value(inst.srcA);
+            const float* B = scratch.Value(srcB);
+            double* outX = scratch.X(inst.dest);
+            double* outY = scratch.Y(inst.dest);
+
+            for (int32 i = 0; i < num; i++)
+            {
+                outX[i] = X[i] + inst.warpStrength * A[i];
+                outY[i] = Y[i] + inst.warpStrength * B[i];
+            }
+
+            if constexpr (bGradients)
+            {
+                const float* jacobian = inst.coords == 0 ? nullptr : scratch.Jacobian(inst.coords);
+                const float* ADX = scratch.ValueDX(inst.srcA);
+                const float* ADY = scratch.ValueDY(inst.srcA);
+                const float* BDX = scratch.ValueDX(srcB);
+                const float* BDY = scratch.ValueDY(srcB);
+                float* outJacobian = scratch.Jacobian(inst.dest);
+
+                for (int32 i = 0; i < num; i++)
+                {
+                    const float* J = jacobian ? jacobian + i * 4 : nullptr;
+                    float* outJ = outJacobian + i * 4;
+
+                    outJ[0] = (J ? J[0] : 1.f) + inst.warpStrength * ADX[i];
+                    outJ[1] = (J ? J[1] : 0.f) + inst.warpStrength * ADY[i];
+                    outJ[2] = (J ? J[2] : 0.f) + inst.warpStrength * BDX[i];
+                    outJ[3] = (J ? J[3] : 1.f) + inst.warpStrength * BDY[i];
+                }
+            }
+            break;
+        }
+
+        case EOp::Add:
+        case EOp::Multiply:
+        {
+            float* dest = scratch.Value(inst.dest);
+            const float* A = scratch.Value(inst.srcA);
+            const float* B = scratch.Value(inst.srcB);
+
+            if (inst.op == EOp::Add)
+            {
+                for (int32 i = 0; i < num; i++)
+                    dest[i] = A[i] + B[i];
+
+                if constexpr (bGradients)
+                {
+                    float* destDX = scratch.ValueDX(inst.dest);
+                    float* destDY = scratch.ValueDY(inst.dest);
+                    const float* ADX = scratch.ValueDX(inst.srcA);
+                    const float* ADY = scratch.ValueDY(inst.srcA);
+                    const float* BDX = scratch.ValueDX(inst.srcB);
+                    const float* BDY = scratch.ValueDY(inst.srcB);
+
+                    for (int32 i = 0; i < num; i++)
+                    {
+                        destDX[i] = ADX[i] + BDX[i];
+                        destDY[i] = ADY[i] + BDY[i];
+                    }
+                }
+            }
+            else
+            {
+                if constexpr (bGradients)
+                {
+                    float* destDX = scratch.ValueDX(inst.dest);
+                    float* destDY = scratch.ValueDY(inst.dest);
+                    const float* ADX = scratch.ValueDX(inst.srcA);
+                    const float* ADY = scratch.ValueDY(inst.srcA);
+                    const float* BDX = scratch.ValueDX(inst.srcB);
+                    const float* BDY = scratch.ValueDY(inst.srcB);
+
+                    for (int32 i = 0; i < num; i++)
+                    {
+                        destDX[i] = ADX[i] * B[i] + A[i] * BDX[i];
+                        destDY[i] = ADY[i] * B[i] + A[i] * BDY[i];
+                    }
+                }
+
+                for (int32 i = 0; i < num; i++)
+                    dest[i] = A[i] * B[i];
+            }
+            break;
+        }
+
+        case EOp::Constant:
+        {
+            float* dest = scratch.Value(inst.dest);
+            for (int32 i = 0; i < num; i++)
+                dest[i] = inst.amplitude;
+
+            if constexpr (bGradients)
+            {
+                FMemory::Memzero(scratch.ValueDX(inst.dest), num * sizeof(float));
+                FMemory::Memzero(scratch.ValueDY(inst.dest), num * sizeof(float));
+            }
+            break;
+        }
+        }
+
+        if (m_profiling)
+        {
+            m_nodeCycles[inst.node].Add(FPlatformTime::Cycles64() - startCycles);
+            m_nodeSamples[inst.node].Add(num);
+        }
+    }
+
+    FMemory::Memcpy(outValues, scratch.Value(m_outputRegister), num * sizeof(float));
+
+    if constexpr (bGradients)
+    {
+        FMemory::Memcpy(outGradX, scratch.ValueDX(m_outputRegister), num * sizeof(float));
+        FMemory::Memcpy(outGradY, scratch.ValueDY(m_outputRegister), num * sizeof(float));
+    }
+}
+
+void FNoiseProgram::Evaluate(
+    const FVector2D*    positions,
+    float*              outValues,
+    const int32         num,
+    float*              outGradX,
+    float*              outGradY
+) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(FNoiseProgram::Evaluate);
+
+    const bool gradients = outGradX && outGradY;
+
+    FScratch scratch(m_numCoordinateRegisters, m_numValueRegisters, gradients);
+
+    for (int32 start = 0; start < num; start += TileSize)
+    {
+        const int32 count = FMath::Min(TileSize, num - start);
+
+        double* X = scratch.X(0);
+        double* Y = scratch.Y(0);
+        for (int32 i = 0; i < count; i++)
+        {
+            X[i] = positions[start + i].X;
+            Y[i] = positions[start + i].Y;
+        }
+
+        if (gradients)
+            EvaluateTile<true>(scratch, count, outValues + start, outGradX + start, outGradY + start);
+        else
+            EvaluateTile<false>(scratch, count, outValues + start, nullptr, nullptr);
+    }
+}
+
+void FNoiseProgram::EvaluateGrid(
+    const FVector2D&    origin,
+    const float         cell,
+    const int32         width,
+    const int32         height,
+    float*              outValues,
+    float*              outGradX,
+    float*              outGradY
+) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(FNoiseProgram::EvaluateGrid);
+
+    const bool gradients = outGradX && outGradY;
+
+    FScratch scratch(m_numCoordinateRegisters, m_numValueRegisters, gradients);
+
+    const int32 num = width * height;
+
+    for (int32 start = 0; start < num; start += TileSize)
+    {
+        const int32 count = FMath::Min(TileSize, num - start);
+
+        double* X = scratch.X(0);
+        double* Y = scratch.Y(0);
+        for (int32 i = 0; i < count; i++)
+        {
+            const int32 GridX = (start + i) % width;
+            const int32 GridY = (start + i) / width;
+
+            X[i] = origin.X + GridX * cell;
+            Y[i] = origin.Y + GridY * cell;
+        }
+
+        if (gradients)
+            EvaluateTile<true>(scratch, count, outValues + start, outGradX + start, outGradY + start);
+        else
+            EvaluateTile<false>(scratch, count, outValues + start, nullptr, nullptr);
+    }
+}
+
+TArray<FNoiseNodeTiming> FNoiseProgram::GetNodeTimings() const
+{
+    TArray<FNoiseNodeTiming> timings;
+    timings.Reserve(m_nodeCycles.Num());
+
+    for (int32 i = 0; i < m_nodeCycles.Num(); i++)
+    {
+        FNoiseNodeTiming& timing = timings.AddDefaulted_GetRef();
+        timing.node = i;
+        timing.type = m_nodeTypes[i];
+        timing.seconds = FPlatformTime::ToSeconds64(m_nodeCycles[i].GetValue());
+        timing.samples = m_nodeSamples[i].GetValue();
+    }
+
+    return timings;
+}
+
+void FNoiseProgram::ResetNodeTimings() const
+{
+    for (int32 i = 0; i < m_nodeCycles.Num(); i++)
+    {
+        m_nodeCycles[i].Reset();
+        m_nodeSamples[i].Reset();
+    }
+}
+
+void FNoiseProgram::SetProfiling(const bool enabled)
+{
+    m_profiling = enabled;
+}
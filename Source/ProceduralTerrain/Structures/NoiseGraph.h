@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "NoiseGraph.generated.h"
+
+// Operations a noise graph node can perform
+UENUM(BlueprintType)
+enum class ENoiseNodeType : uint8 {
+    Perlin      = 0,    // One octave of Perlin noise
+    FBm         = 1,    // Octaves of Perlin noise, each one with a higher frequency and a lower amplitude
+    Ridged      = 2,    // Same octaves, folded into sharp ridges
+    DomainWarp  = 3,    // Offsets the coordinates of the noise nodes reading it by the values of its inputs
+    Add         = 4,
+    Multiply    = 5,
+    Constant    = 6
+};
+
+// One node of a noise graph, nodes can only read the nodes that come before them
+USTRUCT(BlueprintType)
+struct FNoiseGraphNode
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) ENoiseNodeType  type = ENoiseNodeType::Perlin;
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) int32           inputA = -1;                    // Add, Multiply and DomainWarp (X offset)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) int32           inputB = -1;                    // Add, Multiply and DomainWarp (Y offset, X one is reused if -1)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) int32           coordinates = -1;               // DomainWarp node to read the coordinates from, -1 for the world position
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) float           frequency = 1.f;                // Relative to the noise scale of the terrain
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) float           amplitude = 1.f;                // Relative to the height multiplier of the terrain, the value of Constant
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) FVector2D       offset = FVector2D(0.1f);       // Added to the noise coordinates
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) int32           octaves = 1;
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) float           lacunarity = 2.f;               // Frequency multiplier between the octaves
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) float           gain = 0.5f;                    // Amplitude multiplier between the octaves
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) float           warpStrength = 0.f;             // World units the DomainWarp moves the coordinates by, per unit of its inputs
+};
+
+// Declarative description of the terrain height, compiled into a FNoiseProgram before the workers use it
+USTRUCT(BlueprintType)
+struct FNoiseGraph
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) TArray<FNoiseGraphNode>     nodes;
+    UPROPERTY(EditAnywhere, BlueprintReadWrite) int32                       outputNode = -1;    // -1 for the last node
+
+    // The single octave the terrain has always used
+    static FNoiseGraph MakeDefault();
+
+    uint32 GetHash() const;
+};
+
+// Time a node took over all the samples it evaluated since the last reset
+USTRUCT(BlueprintType)
+struct FNoiseNodeTiming
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int32            node = 0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) ENoiseNodeType   type = ENoiseNodeType::Perlin;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) double           seconds = 0.0;
+    UPROPERTY(EditAnywhere, BlueprintReadOnly) int64            samples = 0;
+};
+
+// Flat, register based form of a FNoiseGraph. Samples are evaluated in tiles: every instruction runs over
+// the whole tile before the next one, so the working set of a tile stays in the cache for the entire graph.
+class FNoiseProgram
+{
+public:
+    static constexpr int32 TileSize = 256;
+
+    static TSharedPtr<FNoiseProgram, ESPMode::ThreadSafe> Compile(
+        const FNoiseGraph&          graph,
+        const float                 frequencyScale,         // Noise scale of the terrain, every frequency is multiplied by it
+        FString*                    outError = nullptr
+    );
+
+    // The gradients are the world space derivatives of the values, only computed if both outputs are given
+    void Evaluate(
+        const FVector2D*            positions,
+        float*                      outValues,
+        const int32                 num,
+        float*                      outGradX = nullptr,
+        float*                      outGradY = nullptr
+    ) const;
+
+    // Same as Evaluate over the positions origin + (X, Y) * cell, without building them
+    void EvaluateGrid(
+        const FVector2D&            origin,
+        const float                 cell,
+        const int32                 width,
+        const int32                 height,
+        float*                      outValues,
+        float*                      outGradX = nullptr,
+        float*                      outGradY = nullptr
+    ) const;
+
+    FORCEINLINE uint32 GetHash() const { return m_hash; }
+
+    TArray<FNoiseNodeTiming> GetNodeTimings() const;
+    void ResetNodeTimings() const;
+
+    static void SetProfiling(const bool enabled);
+
+private:
+    enum class EOp : uint8
+    {
+        Octaves,
+        Warp,
+        Add,
+        Multiply,
+        Constant
+    };
+
+    struct FInstruction
+    {
+        EOp                 op = EOp::Constant;
+        bool                ridged = false;
+        int32               node = 0;               // Graph node the instruction was compiled from
+        int32               dest = 0;               // Value register, or coordinate register for Warp
+        int32               srcA = -1;
+        int32               srcB = -1;
+        int32               coords = 0;             // Coordinate register, 0 is the world position
+        int32               octaves = 1;
+        double              frequency = 1.0;
+        float               amplitude = 1.f;
+        float               lacunarity = 2.f;
+        float               gain = 0.5f;
+        FVector2D           offset = FVector2D::ZeroVector;
+        float               warpStrength = 0.f;
+    };
+
+    struct FScratch;
+
+    TArray<FInstruction>                    m_instructions;
+    int32                                   m_numValueRegisters = 0;
+    int32                                   m_numCoordinateRegisters = 1;
+    int32                                   m_outputRegister = 0;
+    uint32                                  m_hash = 0;
+
+    mutable TArray<FThreadSafeCounter64>    m_nodeCycles;
+    mutable TArray<FThreadSafeCounter64>    m_nodeSamples;
+    TArray<ENoiseNodeType>                  m_nodeTypes;
+
+    static bool                             m_profiling;
+
+    template<bool bGradients>
+    void EvaluateTile(
+        FScratch&                   scratch,
+        const int32                 num,
+        float*                      outValues,
+        float*                      outGradX,
+        float*                      outGradY
+    ) const;
+};
+
+typedef TSharedPtr<const FNoiseProgram, ESPMode::ThreadSafe> FNoiseProgramPtr;
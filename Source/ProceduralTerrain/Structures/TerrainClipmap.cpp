@@ -0,0 +1,228 @@
+#include "TerrainClipmap.h"
+#include "MeshTopology.h"
+#include "../Libraries/ChunkFunctionLibrary.h"
+#include "../ProceduralTerrain.h"
+
+void FTerrainClipmap::Initialize(
+    const FTerrainSettingsPtr&  settings,
+    const int32                 levels,
+    const int32                 resolution
+)
+{
+    m_settings = settings;
+    m_resolution = FMath::Max(resolution / 4 * 4, 8);
+
+    const int32 width = GetWidth();
+    const float finestCell = settings->chunkWidth / (float)(1 << settings->maxLOD);
+
+    m_levels.Reset();
+    m_levels.SetNum(FMath::Clamp(levels, 1, 16));
+
+    for (int32 i = 0; i < m_levels.Num(); i++)
+    {
+        m_levels[i].cell = finestCell * (float)(1 << i);
+        m_levels[i].heights.SetNumUninitialized(width * width);
+    }
+
+    // The finer level starts a quarter of the way in, or one cell further depending on where the observer is in the
+    // two cells the coarser origin snaps to
+    for (int32 variant = 0; variant < 5; variant++)
+    {
+        TSharedRef<FMeshTopology, ESPMode::ThreadSafe> topology = MakeShared<FMeshTopology, ESPMode::ThreadSafe>();
+
+        if (variant == 0)
+        {
+            topology->triangles = BuildTriangles(FIntPoint::ZeroValue, 0);
+        }
+        else
+        {
+            const FIntPoint holeMin(m_resolution / 4 + ((variant - 1) & 1), m_resolution / 4 + ((variant - 1) >> 1));
+            topology->triangles = BuildTriangles(holeMin, m_resolution / 2);
+        }
+        m_topologies[variant] = topology;
+    }
+}
+
+FIntPoint FTerrainClipmap::GetLevelOrigin(const FVector2D& observerPos, const float cell) const
+{
+    return FIntPoint(
+        2 * FMath::FloorToInt32(observerPos.X / (2.0 * cell)) - m_resolution / 2,
+        2 * FMath::FloorToInt32(observerPos.Y / (2.0 * cell)) - m_resolution / 2
+    );
+}
+
+int32 FTerrainClipmap::SampleRect(
+    FClipmapLevel&              level,
+    const FIntPoint&            min,
+    const FIntPoint&            size
+)
+{
+    if (size.X <= 0 || size.Y <= 0)
+        return 0;
+
+    const int32 num = size.X * size.Y;
+    m_stripHeights.SetNumUninitialized(num, EAllowShrinking::No);
+
+    UChunkFunctionLibrary::SampleHeights_Rect(*m_settings, FVector2D(min) * level.cell, level.cell, size.X, size.Y, m_stripHeights.GetData());
+
+    const int32 width = GetWidth();
+    for (int32 Y = 0; Y < size.Y; Y++)
+    {
+        float* row = level.heights.GetData() + Wrap(min.Y + Y) * width;
+        const float* strip = m_stripHeights.GetData() + Y * size.X;
+
+        for (int32 X = 0; X < size.X; X++)
+            row[Wrap(min.X + X)] = strip[X];
+    }
+    return num;
+}
+
+FClipmapUpdateResult FTerrainClipmap::Update(const FVector2D& observerPos)
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_ClipmapUpdate);
+
+    FClipmapUpdateResult result;
+    const int32 width = GetWidth();
+    bool finerMoved = false;
+
+    for (FClipmapLevel& level : m_levels)
+    {
+        const FIntPoint newOrigin = GetLevelOrigin(observerPos, level.cell);
+        const FIntPoint move = newOrigin - level.origin;
+        bool moved = true;
+
+        if (!level.valid || FMath::Abs(move.X) >= width || FMath::Abs(move.Y) >= width)
+        {
+            result.sampledHeights += SampleRect(level, newOrigin, FIntPoint(width));
+            level.valid = true;
+        }
+        else if (move != FIntPoint::ZeroValue)
+        {
+            // The columns the level uncovered on every row of the new area, then the rows it uncovered without those columns.
+            // They land in the slots of the vertices that left, so the buffer never moves
+            const int32 enterMinX = move.X > 0 ? newOrigin.X + width - move.X : newOrigin.X;
+            const int32 enterMaxX = move.X > 0 ? newOrigin.X + width : newOrigin.X - move.X;
+            const int32 enterMinY = move.Y > 0 ? newOrigin.Y + width - move.Y : newOrigin.Y;
+            const int32 enterMaxY = move.Y > 0 ? newOrigin.Y + width : newOrigin.Y - move.Y;
+
+            const int32 keptMinX = move.X > 0 ? newOrigin.X : newOrigin.X - move.X;
+            const int32 keptMaxX = move.X > 0 ? newOrigin.X + width - move.X : newOrigin.X + width;
+
+            result.sampledHeights += SampleRect(level, FIntPoint(enterMinX, newOrigin.Y), FIntPoint(enterMaxX - enterMinX, width));
+            result.sampledHeights += SampleRect(level, FIntPoint(keptMinX, enterMinY), FIntPoint(keptMaxX - keptMinX, enterMaxY - enterMinY));
+        }
+        else
+        {
+            moved = false;
+        }
+
+        level.origin = newOrigin;
+
+        // The hole of a level is where its finer level is, so it follows that one too
+        if (moved || finerMoved)
+            level.meshDirty = true;
+
+        result.movedLevels += moved ? 1 : 0;
+        finerMoved = moved;
+    }
+
+    INC_DWORD_STAT_BY(STAT_Terrain_ClipmapSampledHeights, result.sampledHeights);
+    return result;
+}
+
+int32 FTerrainClipmap::GetHoleVariant(const int32 levelIndex) const
+{
+    if (levelIndex == 0)
+        return 0;
+
+    const FClipmapLevel& level = m_levels[levelIndex];
+    const FClipmapLevel& finer = m_levels[levelIndex - 1];
+
+    // The origins are even, so the finer one is always on a vertex of this level
+    const int32 holeX = FMath::Clamp(finer.origin.X / 2 - level.origin.X - m_resolution / 4, 0, 1);
+    const int32 holeY = FMath::Clamp(finer.origin.Y / 2 - level.origin.Y - m_resolution / 4, 0, 1);
+
+    return 1 + holeX + 2 * holeY;
+}
+
+TArray<int32> FTerrainClipmap::BuildTriangles(const FIntPoint& holeMin, const int32 holeSize) const
+{
+    const int32 width = GetWidth();
+
+    TArray<int32> triangles;
+    triangles.Reserve((m_resolution * m_resolution - holeSize * holeSize) * 6);
+
+    // Same winding as the chunk centers, every cell from its max corner
+    for (int32 Y = 1; Y < width; Y++)
+    {
+        for (int32 X = 1; X < width; X++)
+        {
+            const bool inHole = X - 1 >= holeMin.X && X - 1 < holeMin.X + holeSize && Y - 1 >= holeMin.Y && Y - 1 < holeMin.Y + holeSize;
+            if (inHole)
+                continue;
+
+            const int32 Indx = Y * width + X;
+            const int32 B = Indx - width;
+            const int32 C = B - 1;
+            const int32 D = Indx - 1;
+
+            triangles.Append({ Indx, B, C, Indx, C, D });
+        }
+    }
+    return triangles;
+}
+
+void FTerrainClipmap::BuildLevelMesh(
+    const int32                 levelIndex,
+    FMeshData&                  outMesh
+) const
+{
+    SCOPE_CYCLE_COUNTER(STAT_Terrain_ClipmapMesh);
+
+    const FClipmapLevel& level = m_levels[levelIndex];
+    const int32 width = GetWidth();
+    const int32 num = width * width;
+    const float cell = level.cell;
+    const float UVScale = m_settings->UVScale;
+
+    // The outer border of every level but the coarsest meets the coarser level, which only has its even vertices
+    const bool stitch = levelIndex < m_levels.Num() - 1;
+
+    outMesh.vertices.SetNumUninitialized(num, EAllowShrinking::No);
+    outMesh.normals.SetNumUninitialized(num, EAllowShrinking::No);
+    outMesh.tangents.SetNumUninitialized(num, EAllowShrinking::No);
+    outMesh.UVs.SetNumUninitialized(num, EAllowShrinking::No);
+    outMesh.triangles.Reset();
+    outMesh.topology = m_topologies[GetHoleVariant(levelIndex)];
+
+    for (int32 Y = 0; Y < width; Y++)
+    {
+        for (int32 X = 0; X < width; X++)
+        {
+            float Z = GetHeight(level, X, Y);
+
+            // The odd vertices of the border are in the middle of a coarser edge, on which they are put so there is no crack
+            if (stitch && (Y == 0 || Y == m_resolution) && (X & 1))
+                Z = 0.5f * (GetHeight(level, X - 1, Y) + GetHeight(level, X + 1, Y));
+            else if (stitch && (X == 0 || X == m_resolution) && (Y & 1))
+                Z = 0.5f * (GetHeight(level, X, Y - 1) + GetHeight(level, X, Y + 1));
+
+            // Central differences, one sided on the border
+            const int32 X0 = FMath::Max(X - 1, 0);
+            const int32 X1 = FMath::Min(X + 1, m_resolution);
+            const int32 Y0 = FMath::Max(Y - 1, 0);
+            const int32 Y1 = FMath::Min(Y + 1, m_resolution);
+
+            const float gradX = (GetHeight(level, X1, Y) - GetHeight(level, X0, Y)) / ((X1 - X0) * cell);
+            const float gradY = (GetHeight(level, X, Y1) - GetHeight(level, X, Y0)) / ((Y1 - Y0) * cell);
+
+            const int32 Indx = Y * width + X;
+            const FVector position((level.origin.X + X) * (double)cell, (level.origin.Y + Y) * (double)cell, Z);
+
+            outMesh.vertices[Indx] = position;
+            outMesh.normals[Indx] = FVector(-gradX, -gradY, 1.0).GetSafeNormal();
+            outMesh.tangents[Indx] = FProcMeshTangent(FVector(1.0, 0.0, gradX).GetSafeNormal(), false);
+            outMesh.UVs[Indx] = FVector2D(position.X, position.Y) * UVScale;
+        }
+    }
+}
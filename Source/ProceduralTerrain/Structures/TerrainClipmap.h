@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshData.h"
+#include "TerrainSettings.h"
+
+// One ring of the clipmap: the heights of a grid of vertices spaced by the cell of the level, kept in a buffer that wraps
+// around as the level follows the observer, so a move only samples the strips it uncovers
+struct FClipmapLevel
+{
+    TArray<float>       heights;                        //  Vertex (X, Y) is at [Wrap(Y) * width + Wrap(X)]
+    float               cell = 0.0f;
+    FIntPoint           origin = FIntPoint::ZeroValue;  //  Vertex at the min corner, in cells of the level. Always even, so it sits on a vertex of the coarser level
+    int32               holeVariant = 0;                //  Which of the triangle sets the last mesh used, see FTerrainClipmap::GetHoleVariant
+    bool                valid = false;                  //  Heights filled around origin
+    bool                meshDirty = true;               //  It or its finer level moved since its mesh was last built
+};
+
+// What an update of the clipmap did
+struct FClipmapUpdateResult
+{
+    int32               sampledHeights = 0;
+    int32               movedLevels = 0;
+    int32               rebuiltLevels = 0;              //  Left to whoever builds the meshes of the dirty levels
+};
+
+// Nested grids of the same resolution centered on the observer, every level twice as coarse as the previous one and
+// with a hole where the finer one is. The finest cell is the one of the max LOD of the chunks, from the same settings
+class PROCEDURALTERRAIN_API FTerrainClipmap
+{
+private:
+    FTerrainSettingsPtr     m_settings;
+    TArray<FClipmapLevel>   m_levels;
+    int32                   m_resolution = 0;           //  Cells on a side of every level, a multiple of 4 so the finer level is centered on even vertices
+    FMeshTopologyPtr        m_topologies[5];            //  The whole grid for the finest level, then the 4 positions the hole of the finer level can take
+    TArray<float>           m_stripHeights;             //  Scratch of the strips being sampled
+
+    FORCEINLINE int32 GetWidth() const { return m_resolution + 1; }
+
+    FORCEINLINE int32 Wrap(const int32 value) const
+    {
+        const int32 wrapped = value % GetWidth();
+        return wrapped < 0 ? wrapped + GetWidth() : wrapped;
+    }
+
+    FORCEINLINE float GetHeight(const FClipmapLevel& level, const int32 X, const int32 Y) const
+    {
+        return level.heights[Wrap(level.origin.Y + Y) * GetWidth() + Wrap(level.origin.X + X)];
+    }
+
+    FIntPoint GetLevelOrigin(const FVector2D& observerPos, const float cell) const;
+
+    // Samples the vertices [min, min + size) of the level into its buffer, returns how many
+    int32 SampleRect(
+        FClipmapLevel&              level,
+        const FIntPoint&            min,
+        const FIntPoint&            size
+    );
+
+    // Triangles of the cells of the grid, without those in [holeMin, holeMin + holeSize) if holeSize isn't 0
+    TArray<int32> BuildTriangles(const FIntPoint& holeMin, const int32 holeSize) const;
+
+public:
+    void Initialize(
+        const FTerrainSettingsPtr&  settings,
+        const int32                 levels,
+        const int32                 resolution
+    );
+
+    // Moves every level around the observer. Only what a level uncovers is sampled, unless it jumped farther than its width
+    FClipmapUpdateResult Update(const FVector2D& observerPos);
+
+    // 0 for the finest level, then where the hole of the finer level is in this one, which moves by a cell on each axis
+    int32 GetHoleVariant(const int32 levelIndex) const;
+
+    // World vertices, normals, tangents and UVs of the level from its heights. The triangles are the shared ones of its hole variant
+    void BuildLevelMesh(
+        const int32                 levelIndex,
+        FMeshData&                  outMesh
+    ) const;
+
+    FORCEINLINE int32 Num() const { return m_levels.Num(); }
+
+    FORCEINLINE int32 GetResolution() const { return m_resolution; }
+
+    FORCEINLINE FClipmapLevel& GetLevel(const int32 levelIndex) { return m_levels[levelIndex]; }
+
+    FORCEINLINE const FClipmapLevel& GetLevel(const int32 levelIndex) const { return m_levels[levelIndex]; }
+
+    FORCEINLINE const FTerrainSettingsPtr& GetSettings() const { return m_settings; }
+};
@@ -0,0 +1,100 @@
+#include "TerrainSettings.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Dom/JsonObject.h"
+#include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+FTerrainSettingsPtr FTerrainSettings::Make(
+    FTerrainSettings&&          settings,
+    FString*                    outError
+)
+{
+    static FThreadSafeCounter versions;
+
+    if (!settings.noiseProgram.IsValid())
+    {
+        settings.noiseProgram = FNoiseProgram::Compile(settings.noiseGraph, settings.noiseScale, outError);
+
+        if (!settings.noiseProgram.IsValid())
+            return nullptr;
+    }
+
+    settings.version = (uint32)versions.Increment();
+
+    uint32 hash = GetTypeHash(settings.noiseScale);
+    hash = HashCombine(hash, GetTypeHash(settings.heightMultiplier));
+    hash = HashCombine(hash, GetTypeHash(settings.chunkWidth));
+    hash = HashCombine(hash, GetTypeHash(settings.maxLOD));
+    hash = HashCombine(hash, settings.noiseProgram->GetHash());
+    hash = HashCombine(hash, GetTypeHash(settings.analyticNormals));     // The heightfields of that mode also carry the gradients
+    settings.settingsHash = hash;
+
+    hash = HashCombine(hash, GetTypeHash(settings.UVScale));
+    hash = HashCombine(hash, GetTypeHash(settings.pyramidSampling));
+    hash = HashCombine(hash, GetTypeHash(settings.compactVertices));     // The tiles are stored in the format the data was generated in
+    settings.chunkDataHash = hash;
+
+    return MakeShared<const FTerrainSettings, ESPMode::ThreadSafe>(MoveTemp(settings));
+}
+
+bool FTerrainSettings::SaveSnapshot(const FString& path) const
+{
+    TSharedRef<FJsonObject> root = MakeShared<FJsonObject>();
+    root->SetNumberField(TEXT("noiseScale"), noiseScale);
+    root->SetNumberField(TEXT("heightMultiplier"), heightMultiplier);
+    root->SetNumberField(TEXT("chunkWidth"), chunkWidth);
+    root->SetNumberField(TEXT("UVScale"), UVScale);
+    root->SetNumberField(TEXT("maxLOD"), maxLOD);
+    root->SetBoolField(TEXT("pyramidSampling"), pyramidSampling);
+    root->SetBoolField(TEXT("analyticNormals"), analyticNormals);
+    root->SetBoolField(TEXT("compactVertices"), compactVertices);
+
+    const TSharedPtr<FJsonObject> graph = FJsonObjectConverter::UStructToJsonObject(noiseGraph);
+    if (!graph.IsValid())
+        return false;
+    root->SetObjectField(TEXT("noiseGraph"), graph);
+
+    // Only there to be checked against, the loaded settings get theirs from Make
+    root->SetNumberField(TEXT("chunkDataHash"), chunkDataHash);
+
+    FString JSON;
+    FJsonSerializer::Serialize(root, TJsonWriterFactory<>::Create(&JSON));
+    return FFileHelper::SaveStringToFile(JSON, *path);
+}
+
+bool FTerrainSettings::LoadSnapshot(
+    const FString&              path,
+    FTerrainSettings&           outSettings,
+    uint32*                     outChunkDataHash
+)
+{
+    FString JSON;
+    TSharedPtr<FJsonObject> root;
+    if (!FFileHelper::LoadFileToString(JSON, *path) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(JSON), root) || !root.IsValid())
+        return false;
+
+    FNoiseGraph graph;
+    const TSharedPtr<FJsonObject>* graphObject = nullptr;
+    if (!root->TryGetObjectField(TEXT("noiseGraph"), graphObject) || !FJsonObjectConverter::JsonObjectToUStruct((*graphObject).ToSharedRef(), &graph))
+        return false;
+
+    int32 maxLOD = outSettings.maxLOD;
+    root->TryGetNumberField(TEXT("noiseScale"), outSettings.noiseScale);
+    root->TryGetNumberField(TEXT("heightMultiplier"), outSettings.heightMultiplier);
+    root->TryGetNumberField(TEXT("chunkWidth"), outSettings.chunkWidth);
+    root->TryGetNumberField(TEXT("UVScale"), outSettings.UVScale);
+    root->TryGetNumberField(TEXT("maxLOD"), maxLOD);
+    root->TryGetBoolField(TEXT("pyramidSampling"), outSettings.pyramidSampling);
+    root->TryGetBoolField(TEXT("analyticNormals"), outSettings.analyticNormals);
+    root->TryGetBoolField(TEXT("compactVertices"), outSettings.compactVertices);
+
+    outSettings.maxLOD = (uint8)FMath::Clamp(maxLOD, 0, (int32)MaxSupportedLOD);
+    outSettings.noiseGraph = MoveTemp(graph);
+    outSettings.noiseProgram = nullptr;
+
+    if (outChunkDataHash)
+        root->TryGetNumberField(TEXT("chunkDataHash"), *outChunkDataHash);
+    return true;
+}
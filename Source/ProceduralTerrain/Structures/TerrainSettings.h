@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NoiseGraph.h"
+
+struct FTerrainSettings;
+typedef TSharedPtr<const FTerrainSettings, ESPMode::ThreadSafe> FTerrainSettingsPtr;
+
+// Every setting the chunk generation reads. Snapshots are never modified once made: a job keeps the one it was started
+// with, so changing the settings only affects the next jobs, and terrains with different settings can share the
+// workers and the caches since everything cached is keyed by the hashes
+struct FTerrainSettings
+{
+    // A LOD has (2^LOD + 3)^2 vertices and six indices per cell, past 14 the index counts overflow int32
+    static constexpr uint8 MaxSupportedLOD = 14;
+
+    // LOD 0 and 1 are never shown, so never generated either
+    static constexpr uint8 MinShownLOD = 2;
+
+    float               noiseScale = 0.0001f;
+    float               heightMultiplier = 2500;
+    float               chunkWidth = 12800;
+    float               UVScale = 0.1f;
+    uint8               maxLOD = 8;
+    bool                pyramidSampling = false;        //  Each LOD job only samples the resolution it needs
+    bool                analyticNormals = false;        //  Normals and tangents from the gradient of the noise
+    bool                compactVertices = false;        //  Chunk data stored compact, expanded for the upload
+    bool                releaseUploadedData = false;    //  Chunk components drop their data once it is uploaded
+    FNoiseGraph         noiseGraph = FNoiseGraph::MakeDefault();
+    FNoiseProgramPtr    noiseProgram;                   //  Compiled by Make if empty, so it has to be reset with the graph or the noise scale
+
+    // Filled by Make
+    uint32              version = 0;                    //  Order the snapshots were made in
+    uint32              settingsHash = 0;               //  Everything that affects the heights, what the heightfields are cached by
+    uint32              chunkDataHash = 0;              //  Same, with what only changes the meshes, what the disk cache is keyed by
+
+    FORCEINLINE FIntPoint GetChunkIndex(const FVector2D& Pos) const
+    {
+        return FIntPoint(FMath::RoundToInt32(Pos.X / chunkWidth), FMath::RoundToInt32(Pos.Y / chunkWidth));
+    }
+
+    // Compiles the noise graph if needed and freezes the settings. nullptr if the graph doesn't compile
+    static FTerrainSettingsPtr Make(
+        FTerrainSettings&&          settings,
+        FString*                    outError = nullptr
+    );
+
+    // Everything the hashes are made of, the noise graph included, as JSON. The commandlets load it back so what they
+    // bake or time is keyed like the terrain that wrote it
+    bool SaveSnapshot(const FString& path) const;
+
+    // Only the fields of the snapshot are replaced, the others keep what outSettings had. The chunk data hash the
+    // terrain had when it wrote it can be checked against the one Make gives the loaded settings
+    static bool LoadSnapshot(
+        const FString&              path,
+        FTerrainSettings&           outSettings,
+        uint32*                     outChunkDataHash = nullptr
+    );
+};
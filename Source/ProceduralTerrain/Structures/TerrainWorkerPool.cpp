@@ -0,0 +1,72 @@
+#include "TerrainWorkerPool.h"
+
+FTerrainWorkerPool& FTerrainWorkerPool::Get()
+{
+    static FTerrainWorkerPool instance;
+    return instance;
+}
+
+void FTerrainWorkerPool::AddUser(const int32 threads, const EThreadPriority priority)
+{
+    FScopeLock lock(&m_lock);
+
+    if (m_users++ > 0)
+    {
+        if (threads > m_threads)
+            UE_LOG(LogTemp, Warning, TEXT("The terrain worker pool already runs %d threads, %d were asked for"), m_threads, threads);
+        return;
+    }
+
+    m_threads = FMath::Max(threads, 1);
+    m_reservedWorkers = 0;
+    m_pool = FQueuedThreadPool::Allocate();
+    verify(m_pool->Create(m_threads, 256 * 1024, priority, TEXT("TerrainWorkerPool")));
+}
+
+void FTerrainWorkerPool::RemoveUser()
+{
+    FScopeLock lock(&m_lock);
+
+    check(m_users > 0);
+    if (--m_users > 0)
+        return;
+
+    ensure(m_reservedWorkers == 0);
+
+    m_pool->Destroy();
+    delete m_pool;
+    m_pool = nullptr;
+    m_threads = 0;
+    m_reservedWorkers = 0;
+}
+
+bool FTerrainWorkerPool::TryReserveWorker()
+{
+    FScopeLock lock(&m_lock);
+
+    if (!m_pool || m_reservedWorkers >= m_threads)
+        return false;
+
+    m_reservedWorkers++;
+    return true;
+}
+
+void FTerrainWorkerPool::ReleaseWorker()
+{
+    FScopeLock lock(&m_lock);
+
+    check(m_reservedWorkers > 0);
+    m_reservedWorkers--;
+}
+
+int32 FTerrainWorkerPool::GetFreeWorkers() const
+{
+    FScopeLock lock(&m_lock);
+    return m_threads - m_reservedWorkers;
+}
+
+int32 FTerrainWorkerPool::GetNumThreads() const
+{
+    FScopeLock lock(&m_lock);
+    return m_threads;
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/QueuedThreadPool.h"
+
+// Worker threads shared by every terrain, whatever their settings, so they don't each spawn their own. The jobs the
+// terrains hand to it together never outnumber its threads, so a job handed to the pool starts right away
+class PROCEDURALTERRAIN_API FTerrainWorkerPool
+{
+private:
+    mutable FCriticalSection                m_lock;
+    FQueuedThreadPool*                      m_pool = nullptr;
+    int32                                   m_users = 0;
+    int32                                   m_threads = 0;
+    int32                                   m_reservedWorkers = 0;
+
+public:
+    static FTerrainWorkerPool& Get();
+
+    // The first terrain creates the threads with its count and priority, the ones after it share them
+    void AddUser(
+        const int32                 threads,
+        const EThreadPriority       priority
+    );
+
+    // The last terrain destroys the threads, every job it reserved has to be done and released
+    void RemoveUser();
+
+    // Only valid between AddUser and RemoveUser
+    FORCEINLINE FQueuedThreadPool& GetPool() const
+    {
+        check(m_pool);
+        return *m_pool;
+    }
+
+    // A worker for one job, false if every thread is already taken by the jobs of the terrains
+    bool TryReserveWorker();
+
+    // Once the result of the job was picked up
+    void ReleaseWorker();
+
+    int32 GetFreeWorkers() const;
+
+    int32 GetNumThreads() const;
+};
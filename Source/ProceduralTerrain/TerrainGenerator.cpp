@@ -1,32 +1,186 @@
 ﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 #include "TerrainGenerator.h"
+#include "ProceduralTerrain.h"
 #include "Libraries/ChunkFunctionLibrary.h"
+#include "Structures/MeshTopology.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+
+static EThreadPriority ToThreadPriority(const ETerrainWorkerPriority priority)
+{
+	switch (priority)
+	{
+	case ETerrainWorkerPriority::Lowest:			return TPri_Lowest;
+	case ETerrainWorkerPriority::SlightlyBelow:		return TPri_SlightlyBelowNormal;
+	case ETerrainWorkerPriority::Normal:			return TPri_Normal;
+	default:										return TPri_BelowNormal;
+	}
+}
 
 void ATerrainGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
-	m_array_futureMeshDatas.Empty();
-	m_array_futureChunkLODs.Empty();
+	DestroyThreadPool();
+	ReleaseSharedCaches();
 
-	for (auto& Pair : m_map_chunkComponents)
+	for (FChunkUploadEntry& entry : m_array_uploadBacklog)
 	{
-		if (Pair.Value)
+		delete entry.data;
+	}
+	m_array_uploadBacklog.Empty();
+
+	m_array_jobQueue.Empty();
+	m_array_dirtyChunks.Empty();
+
+	// The terrain mesh goes first, so the chunks don't send their removal to it one by one
+	if (m_terrainMesh)
+	{
+		m_terrainMesh->DestroyComponent();
+		m_terrainMesh = nullptr;
+	}
+
+	if (m_clipmap)
+	{
+		m_clipmap->DestroyComponent();
+		m_clipmap = nullptr;
+	}
+
+	m_chunkGrid.ForEach([](const FIntPoint&, FChunkSlot& slot)
 		{
-			Pair.Value->DestroyComponent();
-		}
+			if (slot.component)
+			{
+				slot.component->DestroyComponent();
+			}
+		});
+	m_chunkGrid.Init(0, FIntPoint::ZeroValue);
+	m_queuedChunks = 0;
+
+	for (UChunkComponent* chunkComponent : m_array_chunkPool)
+	{
+		if (chunkComponent)
+			chunkComponent->DestroyComponent();
 	}
-	m_map_chunkComponents.Empty();
+	m_array_chunkPool.Empty();
+
+	for (UChunkComponent* chunkComponent : m_array_pendingTeardowns)
+	{
+		if (chunkComponent)
+			chunkComponent->DestroyComponent();
+	}
+	m_array_pendingTeardowns.Empty();
 }
 
 void ATerrainGenerator::Initialize(AActor* observedActor)
 {
-	m_array_futureMeshDatas.SetNum(m_maxThreads);
-	m_array_futureChunkLODs.SetNum(m_maxThreads);
-	m_freeThreads = m_maxThreads;
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::Initialize);
+
+	if (!m_usesWorkerPool)
+	{
+		FTerrainWorkerPool::Get().AddUser(FMath::Max<int32>(m_maxThreads, 1), ToThreadPriority(m_workerPriority));
+		m_usesWorkerPool = true;
+	}
+	ResetSchedulerStats();
+	ResetUploadStats();
+	ResetPoolStats();
+	ResetDiskCacheStats();
+	ResetClipmapStats();
+
+	m_stat_initializeTime = FPlatformTime::Seconds();
+	m_stat_windowFillSeconds = -1.0;
+
+	// The caches are shared with the other terrains, so this one only adds or takes back its own part
+	if (m_useDiskCache != m_usesDiskCache)
+	{
+		if (m_useDiskCache)
+		{
+			FChunkDiskCache::Get().Open(m_diskCacheDirectory.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TerrainCache")) : m_diskCacheDirectory,
+				(int64)m_diskCacheBudgetMB * 1024 * 1024);
+		}
+		else
+		{
+			FChunkDiskCache::Get().Close();
+		}
+		m_usesDiskCache = m_useDiskCache;
+	}
+
+	if (m_heightfieldBudgetBytes >= 0)
+		FHeightfieldCache::Get().RemoveTerrainBudget(m_heightfieldBudgetBytes);
+
+	m_heightfieldBudgetBytes = (int64)m_heightfieldCacheBudgetMB * 1024 * 1024;
+	FHeightfieldCache::Get().AddTerrainBudget(m_heightfieldBudgetBytes);
+
+	FString error;
+	m_settings = FTerrainSettings::Make(BuildSettings(), &error);
+	if (!m_settings.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Invalid noise graph on %s, using the one of the library: %s"), *GetName(), *error);
+		m_settings = UChunkFunctionLibrary::GetSettings();
+	}
+
+	if (m_useTerrainProxy && !m_terrainMesh)
+	{
+		m_terrainMesh = NewObject<UTerrainMeshComponent>(this, UTerrainMeshComponent::StaticClass());
+		m_terrainMesh->SetMaterial(0, m_terrainMaterial);
+		m_terrainMesh->AttachToComponent(
+			GetRootComponent(),
+			FAttachmentTransformRules::KeepRelativeTransform
+		);
+		m_terrainMesh->RegisterComponentWithWorld(GetWorld());
+	}
+
+	// The clipmap samples the same settings, its finest ring has the cell of the max LOD of the chunks
+	if (m_terrainMode == ETerrainMode::Clipmap)
+	{
+		if (!m_clipmap)
+		{
+			m_clipmap = NewObject<UTerrainClipmapComponent>(this, UTerrainClipmapComponent::StaticClass());
+			m_clipmap->AttachToComponent(
+				GetRootComponent(),
+				FAttachmentTransformRules::KeepRelativeTransform
+			);
+			m_clipmap->RegisterComponentWithWorld(GetWorld());
+		}
+
+		m_clipmap->InitializeClipmap(m_settings, m_clipmapLevels, m_clipmapResolution, m_clipmapCollision);
+
+		for (int32 levelIndex = 0; levelIndex < m_clipmap->GetClipmap().Num(); levelIndex++)
+			m_clipmap->SetMaterial(levelIndex, m_terrainMaterial);
+	}
+	else if (m_clipmap)
+	{
+		m_clipmap->DestroyComponent();
+		m_clipmap = nullptr;
+	}
+
+	// Registering components while streaming hitches, so a first batch is made up front. The clipmap doesn't use any
+	while (m_terrainMode == ETerrainMode::Chunks && m_array_chunkPool.Num() < FMath::Min(m_chunkPoolPrewarm, m_chunkPoolSize))
+	{
+		m_array_chunkPool.Add(AllocateChunkComponent());
+	}
 	 
 	m_observedActor = observedActor;
+	m_renderHalfWidth = (uint8)BuildLodMatrix(lodRepetitions, m_lodMatrix);
+
+	const int renderWidth = m_renderHalfWidth + m_renderHalfWidth;
+
+	BuildWindowShifts();
+	m_windowValid = false;
+
+	// The grid is sized for this window, so the chunks of a previous Initialize go with it
+	m_chunkGrid.ForEach([this](const FIntPoint& chunkIndex, FChunkSlot& slot)
+		{
+			EvictSlot(chunkIndex, slot);
+		});
+	m_chunkGrid.Init(renderWidth + 2 * FMath::Max(m_chunkGridMargin, 1), FIntPoint::ZeroValue);
+	m_array_jobQueue.Reset();
+	m_array_dirtyChunks.Reset();
+	m_queuedChunks = 0;
+}
+
+int32 ATerrainGenerator::BuildLodMatrix(const TArray<int>& lodRepetitions, TArray<FArrayUint8>& outMatrix)
+{
 	TArray<uint8>	lodMap_horizontal;
 
 	int32 currLod = 0;
@@ -36,90 +190,590 @@ void ATerrainGenerator::Initialize(AActor* observedActor)
 			lodMap_horizontal.Add(currLod);
 		currLod++;
 	}
-	m_renderHalfWidth = lodMap_horizontal.Num();
-
-	const int renderWidth = m_renderHalfWidth + m_renderHalfWidth;
-	const float chunkWidth = UChunkFunctionLibrary::GetChunkWidth();
+	const int32 halfWidth = lodMap_horizontal.Num();
+	const int32 renderWidth = halfWidth + halfWidth;
 
-	m_lodMatrix.SetNum(renderWidth);
+	outMatrix.SetNum(renderWidth);
 
 	int lodStartIdx = 0;
-	for (int32 Y = m_renderHalfWidth - 1; Y >= 0; Y--)
+	for (int32 Y = halfWidth - 1; Y >= 0; Y--)
 	{
 		FArrayUint8 temp = FArrayUint8(renderWidth);
 
 		for (int32 X = 0; X < lodStartIdx; X++)
 			temp.array[X] = temp.array[renderWidth - 1 - X] = 0;
 
-		for (int32 X = lodStartIdx; X < m_renderHalfWidth; X++)
+		for (int32 X = lodStartIdx; X < halfWidth; X++)
 		{
 			temp.array[X] = temp.array[renderWidth - 1 - X] = lodMap_horizontal[X - lodStartIdx];
 		}
 
-		m_lodMatrix[Y].array = m_lodMatrix[m_renderHalfWidth + lodStartIdx].array = temp.array;
+		outMatrix[Y].array = outMatrix[halfWidth + lodStartIdx].array = temp.array;
 		lodStartIdx++;
 	}
+	return halfWidth;
+}
+
+void ATerrainGenerator::BuildWindowShifts()
+{
+	const int32 renderWidth = m_renderHalfWidth + m_renderHalfWidth;
+
+	m_windowInfos.SetNum(renderWidth * renderWidth);
+
+	for (int32 Y = 0; Y < renderWidth; Y++)
+	{
+		for (int32 X = 0; X < renderWidth; X++)
+		{
+			const uint8 ThisLOD = (uint8)m_lodMatrix[Y].array[X];
+
+			if (ThisLOD < FTerrainSettings::MinShownLOD)
+			{
+				m_windowInfos[Y * renderWidth + X] = FChunkLodInfos();
+				continue;
+			}
+
+			// Neighbor sampling in the same render window
+			auto GetNeighborLOD = [&](int32 Ny, int32 Nx) -> uint8
+				{
+					if (Ny < 0 || Ny >= renderWidth || Nx < 0 || Nx >= renderWidth)
+						return ThisLOD;
+
+					return (uint8)m_lodMatrix[Ny].array[Nx];
+				};
+
+			// Left=X-1 Right=X+1 Up=Y-1 Down=Y+1
+			const uint8 LOD_Left = GetNeighborLOD(Y, X - 1);
+			const uint8 LOD_Right = GetNeighborLOD(Y, X + 1);
+			const uint8 LOD_Up = GetNeighborLOD(Y - 1, X);
+			const uint8 LOD_Down = GetNeighborLOD(Y + 1, X);
+
+			// Downscale this border if the neighbor is COARSER (lower LOD number)
+			const bool bDownscaleLeft = (LOD_Left > 1) && (LOD_Left < ThisLOD);
+			const bool bDownscaleRight = (LOD_Right > 1) && (LOD_Right < ThisLOD);
+			const bool bDownscaleUp = (LOD_Up > 1) && (LOD_Up < ThisLOD);
+			const bool bDownscaleDown = (LOD_Down > 1) && (LOD_Down < ThisLOD);
+
+			m_windowInfos[Y * renderWidth + X] = FChunkLodInfos(ThisLOD, bDownscaleLeft, bDownscaleRight, bDownscaleUp, bDownscaleDown);
+		}
+	}
+
+	auto IsInWindow = [renderWidth](const FIntPoint& cell)
+		{
+			return cell.X >= 0 && cell.X < renderWidth && cell.Y >= 0 && cell.Y < renderWidth;
+		};
+
+	// The window only moves by one chunk at a time while walking, so what each of those moves changes is known up front.
+	// A chunk at cell C of the new window was at cell C + move of the old one
+	for (int32 moveY = -1; moveY <= 1; moveY++)
+	{
+		for (int32 moveX = -1; moveX <= 1; moveX++)
+		{
+			FWindowShift& shift = m_windowShifts[(moveY + 1) * 3 + (moveX + 1)];
+			shift.changedCells.Reset();
+			shift.leftCells.Reset();
+
+			const FIntPoint move(moveX, moveY);
+
+			for (int32 Y = 0; Y < renderWidth; Y++)
+			{
+				for (int32 X = 0; X < renderWidth; X++)
+				{
+					const FIntPoint cell(X, Y);
+					const FChunkLodInfos& infos = m_windowInfos[Y * renderWidth + X];
+
+					const FIntPoint oldCell = cell + move;
+					if (IsInWindow(oldCell))
+					{
+						if (!(m_windowInfos[oldCell.Y * renderWidth + oldCell.X] == infos))
+							shift.changedCells.Add(cell);
+					}
+					else if (infos.LOD > 1)
+					{
+						shift.changedCells.Add(cell);
+					}
+
+					// Chunks outside of the window are always hidden, so only the shown ones have anything to undo
+					if (!IsInWindow(cell - move) && infos.LOD > 1)
+						shift.leftCells.Add(cell);
+				}
+			}
+		}
+	}
+}
+
+FTerrainSettings ATerrainGenerator::BuildSettings() const
+{
+	// Without changing the library settings for the other terrains
+	FTerrainSettings settings = *UChunkFunctionLibrary::GetSettings();
+	settings.compactVertices = m_compactChunkVertices;
+	settings.releaseUploadedData = m_releaseUploadedChunkData;
+
+	if (m_noiseGraph.nodes.Num() > 0)
+	{
+		settings.noiseGraph = m_noiseGraph;
+		settings.noiseProgram = nullptr;
+	}
+	return settings;
+}
+
+bool ATerrainGenerator::SaveSettingsSnapshot(const FString& path)
+{
+	// What Initialize would make right now, so it also works on a terrain that isn't playing
+	FString error;
+	const FTerrainSettingsPtr settings = FTerrainSettings::Make(BuildSettings(), &error);
+	if (!settings.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Invalid noise graph on %s, no snapshot written: %s"), *GetName(), *error);
+		return false;
+	}
+
+	const FString snapshotPath = path.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TerrainSnapshots"), GetName() + TEXT(".json")) : path;
+	if (!settings->SaveSnapshot(snapshotPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't write the settings snapshot of %s to %s"), *GetName(), *snapshotPath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Settings snapshot of %s written to %s, chunk data hash %08X"), *GetName(), *snapshotPath, settings->chunkDataHash);
+	return true;
+}
+
+void ATerrainGenerator::DestroyThreadPool()
+{
+	// The terrains together never hand the pool more jobs than it has threads, so every one of them is already running.
+	// They are cancelled first, so waiting is short
+	for (FChunkGenerationJob& job : m_array_runningJobs)
+		job.token->Cancel();
+
+	for (FChunkGenerationJob& job : m_array_runningJobs)
+	{
+		job.future.Wait();
+		delete job.future.Consume();
+		FTerrainWorkerPool::Get().ReleaseWorker();
+	}
+	m_array_runningJobs.Empty();
+
+	// The threads go with the last terrain
+	if (m_usesWorkerPool)
+	{
+		FTerrainWorkerPool::Get().RemoveUser();
+		m_usesWorkerPool = false;
+	}
+}
+
+void ATerrainGenerator::ReleaseSharedCaches()
+{
+	if (m_usesDiskCache)
+	{
+		FChunkDiskCache::Get().Close();
+		m_usesDiskCache = false;
+	}
+
+	if (m_heightfieldBudgetBytes >= 0)
+	{
+		FHeightfieldCache::Get().RemoveTerrainBudget(m_heightfieldBudgetBytes);
+		m_heightfieldBudgetBytes = -1;
+	}
+}
+
+UChunkComponent* ATerrainGenerator::AllocateChunkComponent()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::AllocateChunkComponent);
+
+	UChunkComponent* chunkComponent = NewObject<UChunkComponent>(this, UChunkComponent::StaticClass());
+	chunkComponent->UseSettings(m_settings);
+	m_stat_allocatedComponents++;
+
+	// With the terrain proxy the chunk is only registered once it needs collision
+	if (!m_terrainMesh)
+	{
+		chunkComponent->AttachToComponent(
+			GetRootComponent(),
+			FAttachmentTransformRules::KeepRelativeTransform
+		);
+
+		chunkComponent->RegisterComponentWithWorld(GetWorld());
+	}
+	return chunkComponent;
+}
+
+UChunkComponent* ATerrainGenerator::GetOrCreateChunkComponent(const FIntPoint& chunkIdx)
+{
+	FChunkSlot* slot = m_chunkGrid.Find(chunkIdx);
+	if (!slot)
+		return nullptr;
+
+	if (slot->component)
+		return slot->component;
+
+	UChunkComponent* chunkComponent;
+	if (m_array_chunkPool.Num() > 0)
+	{
+		chunkComponent = m_array_chunkPool.Pop(EAllowShrinking::No);
+		m_stat_poolHits++;
+
+		// It may have been reset under the snapshot of a previous Initialize
+		chunkComponent->UseSettings(m_settings);
+	}
+	else
+	{
+		chunkComponent = AllocateChunkComponent();
+		m_stat_poolMisses++;
+	}
+
+	if (m_terrainMesh)
+		chunkComponent->UseTerrainMesh(m_terrainMesh, chunkIdx);
+
+	slot->component = chunkComponent;
+	return chunkComponent;
+}
+
+void ATerrainGenerator::ProcessChunkTeardowns()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Terrain_ChunkTeardowns);
+
+	const int32 count = FMath::Min(m_array_pendingTeardowns.Num(), FMath::Max(m_maxChunkTeardownsPerFrame, 1));
+
+	for (int32 i = 0; i < count; i++)
+	{
+		UChunkComponent* chunkComponent = m_array_pendingTeardowns.Pop(EAllowShrinking::No);
+		if (!IsValid(chunkComponent))
+			continue;
+
+		if (m_array_chunkPool.Num() < m_chunkPoolSize)
+		{
+			chunkComponent->ResetForReuse();
+			m_array_chunkPool.Add(chunkComponent);
+		}
+		else
+		{
+			chunkComponent->DestroyComponent();
+			m_stat_destroyedComponents++;
+		}
+	}
 }
 
 void ATerrainGenerator::Refresh_Datas(
 )
 {
-	uint8 spawnedChunks = 0;
-	for (int i = 0; i < m_maxThreads; i++)
+	SCOPE_CYCLE_COUNTER(STAT_Terrain_RefreshDatas);
+
+	PublishFrameStats();
+	ProcessChunkTeardowns();
+
+	// The finished jobs free their worker right away, their results wait in the backlog
+	for (int i = m_array_runningJobs.Num() - 1; i >= 0; i--)
 	{
-		if (m_array_futureMeshDatas[i].IsReady())
+		if (m_array_runningJobs[i].future.IsReady())
 		{
-			const FVector2D chunkIdx = { m_array_futureChunkLODs[i].X, m_array_futureChunkLODs[i].Y };
+			FChunkGenerationJob job = MoveTemp(m_array_runningJobs[i]);
+			m_array_runningJobs.RemoveAtSwap(i, 1, EAllowShrinking::No);
+
+			FChunkLodData* newData = job.future.Consume();
+			FTerrainWorkerPool::Get().ReleaseWorker();
 
-			UChunkComponent* chunkComponent;
-			if (!m_map_chunkComponents.Contains(chunkIdx))
+			if (!newData)
 			{
-				chunkComponent = NewObject<UChunkComponent>(this, UChunkComponent::StaticClass());
+				// The chunk may want that LOD again by now, and the window only looks at it if told to
+				MarkChunkDirty(job.chunkIndex);
+				m_stat_abortedJobs++;
+				continue;
+			}
 
-				chunkComponent->AttachToComponent(
-					GetRootComponent(),
-					FAttachmentTransformRules::KeepRelativeTransform
-				);
+			m_stat_completedJobs++;
+			m_stat_jobSeconds += FPlatformTime::Seconds() - job.dispatchTime;
 
-				chunkComponent->RegisterComponentWithWorld(GetWorld());
+			m_array_uploadBacklog.Add({ job.chunkIndex, job.LOD, newData, 0.0 });
+		}
+	}
 
-				m_map_chunkComponents.Add(chunkIdx, chunkComponent);
-			}
-			else
+	m_stat_maxBacklogLength = FMath::Max(m_stat_maxBacklogLength, m_array_uploadBacklog.Num());
+
+	// How long the first window takes, which is what the disk cache shortens on a warm start
+	if (m_stat_windowFillSeconds < 0.0 && m_windowValid && m_queuedChunks == 0
+		&& m_array_runningJobs.IsEmpty() && m_array_uploadBacklog.IsEmpty())
+	{
+		m_stat_windowFillSeconds = FPlatformTime::Seconds() - m_stat_initializeTime;
+	}
+
+	if (m_array_uploadBacklog.IsEmpty())
+		return;
+
+	// The observer may have moved since the jobs were queued, so the distances are taken again
+	const float chunkWidth = m_settings->chunkWidth;
+	const FVector2D observerPos = m_observedActor ? FVector2D(m_observedActor->GetActorLocation()) : FVector2D::ZeroVector;
+
+	for (FChunkUploadEntry& entry : m_array_uploadBacklog)
+	{
+		entry.distanceSquared = FVector2D::DistSquared((FVector2D(entry.chunkIndex) + FVector2D(0.5, 0.5)) * chunkWidth, observerPos);
+	}
+
+	// Sorted the farthest first, so the closest ones are popped from the end
+	m_array_uploadBacklog.Sort([](const FChunkUploadEntry& A, const FChunkUploadEntry& B)
+		{
+			return A.distanceSquared > B.distanceSquared;
+		});
+
+	const double startTime = FPlatformTime::Seconds();
+	const double budgetSeconds = m_uploadBudgetMs / 1000.0;
+	int32 spawnedChunks = 0;
+	int32 droppedChunks = 0;
+
+	while (m_array_uploadBacklog.Num() > 0)
+	{
+		// The closest chunk always goes, so a single upload over the budget can't stall the backlog
+		if (spawnedChunks > 0 && FPlatformTime::Seconds() - startTime >= budgetSeconds)
+			break;
+
+		if (m_maxChunkGenerationPerFrame > 0 && spawnedChunks >= m_maxChunkGenerationPerFrame)
+			break;
+
+		const FChunkUploadEntry entry = m_array_uploadBacklog.Pop(EAllowShrinking::No);
+
+		// Nothing to give it to if the chunk left the grid while it was generated
+		if (UChunkComponent* chunkComponent = GetOrCreateChunkComponent(entry.chunkIndex))
+		{
+			chunkComponent->AddLodData(*(entry.data), entry.LOD);
+			MarkChunkDirty(entry.chunkIndex);
+			spawnedChunks++;
+		}
+		else
+		{
+			droppedChunks++;
+		}
+
+		delete entry.data;
+	}
+
+	const double uploadMs = (FPlatformTime::Seconds() - startTime) * 1000.0;
+
+	m_stat_uploadedChunkLODs += spawnedChunks;
+	m_stat_droppedChunkLODs += droppedChunks;
+	m_stat_uploadFrames++;
+	m_stat_lastFrameUploadMs = uploadMs;
+	m_stat_maxFrameUploadMs = FMath::Max(m_stat_maxFrameUploadMs, uploadMs);
+
+	if (uploadMs > m_uploadBudgetMs)
+		m_stat_framesOverBudget++;
+
+	EnforceMemoryBudget();
+}
+
+void ATerrainGenerator::PublishFrameStats() const
+{
+#if STATS
+	if (!FThreadStats::IsCollectingData())
+		return;
+
+	// The counters are cleared every frame, so the terrains each add their own state once per frame
+	INC_DWORD_STAT_BY(STAT_Terrain_QueuedChunks, m_queuedChunks);
+	INC_DWORD_STAT_BY(STAT_Terrain_JobsInFlight, m_array_runningJobs.Num());
+	INC_DWORD_STAT_BY(STAT_Terrain_UploadBacklog, m_array_uploadBacklog.Num());
+
+	// Every resident LOD has its center and both variants of its four borders. The bytes are the data and render side
+	// ones the memory budget counts
+	int64 chunks = 0;
+	int64 sections = 0;
+	int64 bytes = 0;
+	m_chunkGrid.ForEach([&](const FIntPoint&, const FChunkSlot& slot)
+		{
+			if (!slot.component)
+				return;
+
+			chunks++;
+			for (uint8 LOD = 1; LOD <= m_settings->maxLOD; LOD++)
 			{
-				chunkComponent = m_map_chunkComponents[chunkIdx];
+				if (slot.component->ContainsLOD(LOD))
+					sections += 9;
+				bytes += slot.component->GetLODResidentBytes(LOD);
 			}
+		});
+
+	INC_DWORD_STAT_BY(STAT_Terrain_ResidentChunks, chunks);
+	INC_DWORD_STAT_BY(STAT_Terrain_ResidentSections, sections);
+	INC_DWORD_STAT_BY(STAT_Terrain_ResidentBytes, bytes);
+#endif
+}
+
+void ATerrainGenerator::EvictChunk(const FIntPoint& chunkIndex)
+{
+	if (FChunkSlot* slot = m_chunkGrid.Find(chunkIndex))
+		EvictSlot(chunkIndex, *slot);
+}
+
+void ATerrainGenerator::EvictSlot(const FIntPoint& chunkIndex, FChunkSlot& slot)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::EvictChunk);
+
+	SetQueuedLOD(slot, 0);
+	slot.wantedLOD = 0;
+
+	UChunkComponent* chunkComponent = slot.component;
+	slot.component = nullptr;
+	if (!chunkComponent)
+		return;
+
+	// A teleport takes shown chunks out of the grid, their sections would stay until the teardown
+	if (chunkComponent->GetExpectedLodInfos().LOD != 0)
+		HideChunk(chunkComponent, FPlatformTime::Seconds());
+
+	if (m_terrainMesh)
+		m_terrainMesh->RemoveChunk(chunkIndex);
+
+	m_set_visibleChunks.Remove(chunkComponent);
+
+	// The reset clears every section, so it waits for its turn in ProcessChunkTeardowns
+	m_array_pendingTeardowns.Add(chunkComponent);
+}
+
+void ATerrainGenerator::SetQueuedLOD(FChunkSlot& slot, const uint8 LOD)
+{
+	m_queuedChunks += (LOD != 0 ? 1 : 0) - (slot.queuedLOD != 0 ? 1 : 0);
+	slot.queuedLOD = LOD;
+}
+
+void ATerrainGenerator::MarkChunkDirty(const FIntPoint& chunkIndex)
+{
+	FChunkSlot* slot = m_chunkGrid.Find(chunkIndex);
+	if (!slot || slot->dirty)
+		return;
+
+	slot->dirty = true;
+	m_array_dirtyChunks.Add(chunkIndex);
+}
+
+void ATerrainGenerator::MoveChunkGrid(const FIntPoint& corner)
+{
+	const int32 margin = (m_chunkGrid.GetWidth() - (m_renderHalfWidth + m_renderHalfWidth)) / 2;
+
+	m_chunkGrid.MoveTo(corner - FIntPoint(m_renderHalfWidth + margin), [this](const FIntPoint& chunkIndex, FChunkSlot& slot)
+		{
+			if (slot.component)
+				m_stat_evictedChunks++;
+
+			EvictSlot(chunkIndex, slot);
+		});
+}
+
+void ATerrainGenerator::EnforceMemoryBudget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Terrain_MemoryBudget);
+
+	if (m_chunkMemoryBudgetMB <= 0)
+		return;
 
-			FChunkLodData* newData = m_array_futureMeshDatas[i].Consume();
+	const int64 budgetBytes = (int64)m_chunkMemoryBudgetMB * 1024 * 1024;
+	const uint8 maxLOD = m_settings->maxLOD;
 
-			chunkComponent->AddLodData(*(newData),
-										m_array_futureChunkLODs[i].Z);
+	int64 residentBytes = 0;
+	m_chunkGrid.ForEach([&](const FIntPoint&, const FChunkSlot& slot)
+		{
+			if (!slot.component)
+				return;
 
-			delete newData;
+			for (uint8 LOD = 1; LOD <= maxLOD; LOD++)
+				residentBytes += slot.component->GetLODResidentBytes(LOD);
+		});
 
-			m_freeThreads++;
+	if (residentBytes <= budgetBytes)
+		return;
+
+	// A chunk out of the window goes as a whole, a chunk in it only loses the LODs it neither shows nor wants
+	struct FEvictionCandidate
+	{
+		FIntPoint		chunkIndex;
+		uint8			LOD;			//	0 for the whole chunk
+		int64			bytes;
+		double			score;
+	};
+	TArray<FEvictionCandidate> candidates;
+
+	const double now = FPlatformTime::Seconds();
+	const float chunkWidth = m_settings->chunkWidth;
+	const FVector2D observerPos = m_observedActor ? FVector2D(m_observedActor->GetActorLocation()) : FVector2D::ZeroVector;
+
+	// The older a LOD is, the sooner it goes, and its distance to the observer stretches its age
+	auto GetScore = [&](const FIntPoint& chunkIndex, const double lastUsed)
+		{
+			const double distance = FVector2D::Distance((FVector2D(chunkIndex) + FVector2D(0.5, 0.5)) * chunkWidth, observerPos) / chunkWidth;
+			return (now - lastUsed) * (1.0 + distance * m_evictionDistanceWeight);
+		};
+
+	m_chunkGrid.ForEach([&](const FIntPoint& chunkIndex, const FChunkSlot& slot)
+		{
+			const UChunkComponent* chunk = slot.component;
+			if (!chunk)
+				return;
 
-			if (spawnedChunks == m_maxChunkGenerationPerFrame)
+			if (slot.wantedLOD == 0)
+			{
+				int64 bytes = 0;
+				double lastUsed = 0.0;
+				for (uint8 LOD = 1; LOD <= maxLOD; LOD++)
+				{
+					bytes += chunk->GetLODResidentBytes(LOD);
+					lastUsed = FMath::Max(lastUsed, chunk->GetLODLastUsed(LOD));
+				}
+				candidates.Add({ chunkIndex, 0, bytes, GetScore(chunkIndex, lastUsed) });
 				return;
+			}
+
+			for (uint8 LOD = 1; LOD <= maxLOD; LOD++)
+			{
+				if (LOD == slot.wantedLOD || LOD == chunk->GetExpectedLodInfos().LOD || chunk->GetLODResidentBytes(LOD) == 0)
+					continue;
+
+				candidates.Add({ chunkIndex, LOD, (int64)chunk->GetLODResidentBytes(LOD), GetScore(chunkIndex, chunk->GetLODLastUsed(LOD)) });
+			}
+		});
+
+	candidates.Sort([](const FEvictionCandidate& A, const FEvictionCandidate& B)
+		{
+			return A.score > B.score;
+		});
+
+	for (const FEvictionCandidate& candidate : candidates)
+	{
+		if (residentBytes <= budgetBytes)
+			break;
+
+		if (candidate.LOD == 0)
+		{
+			EvictChunk(candidate.chunkIndex);
+			m_stat_evictedChunks++;
 		}
+		else
+		{
+			m_chunkGrid.Find(candidate.chunkIndex)->component->RemoveLOD(candidate.LOD);
+			m_stat_evictedLODs++;
+		}
+		residentBytes -= candidate.bytes;
 	}
 }
 
-FORCEINLINE bool ATerrainGenerator::IsChunkLodGenerated(const FVector2D& chunkIndex, const uint8 LOD)
+FORCEINLINE bool ATerrainGenerator::IsChunkLodGenerated(const FIntPoint& chunkIndex, const uint8 LOD)
 
 {
-	return(m_map_chunkComponents.Contains(chunkIndex) &&
-			m_map_chunkComponents[chunkIndex]->ContainsLOD(LOD));
+	const FChunkSlot* slot = m_chunkGrid.Find(chunkIndex);
+	return(slot && slot->component &&
+			slot->component->ContainsLOD(LOD));
 }
 
-bool ATerrainGenerator::IsChunkLodUnderGeneration(const FVector2D& chunkIndex, const uint8 LOD)
+bool ATerrainGenerator::IsChunkLodUnderGeneration(const FIntPoint& chunkIndex, const uint8 LOD)
 
 {
-	for (int i = 0; i < m_maxThreads; i++)
+	for (const FChunkGenerationJob& job : m_array_runningJobs)
+	{
+		if (job.chunkIndex == chunkIndex && job.LOD == LOD)
+		{
+			return true;
+		}
+	}
+
+	// Generated but not uploaded yet
+	for (const FChunkUploadEntry& entry : m_array_uploadBacklog)
 	{
-		if (m_array_futureChunkLODs[i].X == chunkIndex.X &&
-			m_array_futureChunkLODs[i].Y == chunkIndex.Y &&
-			m_array_futureChunkLODs[i].Z == LOD)
+		if (entry.chunkIndex == chunkIndex && entry.LOD == LOD)
 		{
 			return true;
 		}
@@ -127,13 +781,194 @@ bool ATerrainGenerator::IsChunkLodUnderGeneration(const FVector2D& chunkIndex, c
 	return false;
 }
 
+FHeightfieldCacheStats ATerrainGenerator::GetHeightfieldCacheStats() const
+{
+	return FHeightfieldCache::Get().GetStats();
+}
+
+FChunkMemoryStats ATerrainGenerator::GetChunkMemoryStats() const
+{
+	FChunkMemoryStats stats;
+	stats.residentBytesPerLOD.Init(0, (m_settings.IsValid() ? m_settings->maxLOD : 0) + 1);
+
+	m_chunkGrid.ForEach([&](const FIntPoint& chunkIndex, const FChunkSlot& slot)
+		{
+			if (!slot.component)
+				return;
+
+			stats.chunks++;
+			stats.residentBytes += slot.component->GetResidentBytes();
+			stats.expandedBytes += slot.component->GetExpandedBytes();
+
+			for (int32 LOD = 0; LOD < stats.residentBytesPerLOD.Num(); LOD++)
+				stats.residentBytesPerLOD[LOD] += slot.component->GetLODResidentBytes(LOD);
+
+			const int64 releasedBytes = slot.component->GetReleasedBytes();
+			if (releasedBytes > 0)
+			{
+				stats.releasedBytes += releasedBytes;
+				stats.releasedBytesPerChunk.Add({ FVector2D(chunkIndex), releasedBytes });
+			}
+		});
+
+	stats.budgetBytes = (int64)FMath::Max(m_chunkMemoryBudgetMB, 0) * 1024 * 1024;
+	stats.evictedChunks = m_stat_evictedChunks;
+	stats.evictedLODs = m_stat_evictedLODs;
+	return stats;
+}
+
+FChunkDiskCacheStats ATerrainGenerator::GetDiskCacheStats() const
+{
+	FChunkDiskCacheStats stats = FChunkDiskCache::Get().GetStats();
+	stats.windowFillSeconds = m_stat_windowFillSeconds;
+	return stats;
+}
+
+void ATerrainGenerator::ResetDiskCacheStats()
+{
+	FChunkDiskCache::Get().ResetStats();
+}
+
+FTerrainRenderStats ATerrainGenerator::GetTerrainRenderStats() const
+{
+	FTerrainRenderStats stats;
+
+	stats.usesTerrainProxy = m_terrainMesh != nullptr;
+	stats.gameThreadUploadSeconds = FPlatformTime::ToSeconds64(FTerrainRenderCounters::gameThreadUploadCycles.GetValue());
+	stats.gameThreadVisibilitySeconds = FPlatformTime::ToSeconds64(FTerrainRenderCounters::gameThreadVisibilityCycles.GetValue());
+	stats.renderThreadUploadSeconds = FPlatformTime::ToSeconds64(FTerrainRenderCounters::renderThreadUploadCycles.GetValue());
+	stats.renderThreadGatherSeconds = FPlatformTime::ToSeconds64(FTerrainRenderCounters::renderThreadGatherCycles.GetValue());
+	stats.uploadedParts = FTerrainRenderCounters::uploadedParts.GetValue();
+	stats.visibilityUpdates = FTerrainRenderCounters::visibilityUpdates.GetValue();
+	stats.sectionChangesThisFrame = FTerrainRenderCounters::sectionChangesFrame == GFrameCounter ? FTerrainRenderCounters::sectionChangesThisFrame : 0;
+	stats.maxSectionChangesPerFrame = FTerrainRenderCounters::maxSectionChangesPerFrame;
+	stats.framesWithSectionChanges = FTerrainRenderCounters::framesWithSectionChanges;
+	stats.drawRanges = FTerrainRenderCounters::drawRanges.GetValue();
+
+	m_chunkGrid.ForEach([&](const FIntPoint&, const FChunkSlot& slot)
+		{
+			if (slot.component && slot.component->IsRegistered())
+				stats.registeredChunkComponents++;
+		});
+
+	if (m_terrainMesh)
+	{
+		stats.bufferPages = m_terrainMesh->GetNumBufferPages();
+		stats.bufferBytes = m_terrainMesh->GetBufferBytes();
+	}
+	return stats;
+}
+
+void ATerrainGenerator::ResetTerrainRenderStats()
+{
+	FTerrainRenderCounters::Reset();
+}
+
+const FChunkLodData* ATerrainGenerator::GetChunkLodData(const FIntPoint& chunkIndex, const uint8 LOD)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::GetChunkLodData);
+
+	const FChunkSlot* slot = m_chunkGrid.Find(chunkIndex);
+	UChunkComponent* chunkComponent = slot ? slot->component : nullptr;
+	if (!chunkComponent || !chunkComponent->ContainsLOD(LOD))
+		return nullptr;
+
+	if (const FChunkLodData* data = chunkComponent->FindLODData(LOD))
+		return data;
+
+	// The generation is deterministic, so the data comes back the same as the one that was uploaded
+	FChunkLodData* data = &UChunkFunctionLibrary::GenerateChunkData_LOD(*m_settings, FVector2D(chunkIndex) * m_settings->chunkWidth, LOD);
+	chunkComponent->RestoreLODData(LOD, MoveTemp(*data));
+	delete data;
+
+	return chunkComponent->FindLODData(LOD);
+}
+
+FChunkSchedulerStats ATerrainGenerator::GetSchedulerStats() const
+{
+	FChunkSchedulerStats stats;
+
+	stats.queueDepth = m_queuedChunks;
+	stats.maxQueueDepth = m_stat_maxQueueDepth;
+	stats.runningJobs = m_array_runningJobs.Num();
+	stats.workerThreads = m_usesWorkerPool ? FTerrainWorkerPool::Get().GetNumThreads() : 0;
+	stats.dispatchedJobs = m_stat_dispatchedJobs;
+	stats.completedJobs = m_stat_completedJobs;
+	stats.cancelledJobs = m_stat_cancelledJobs;
+	stats.abortedJobs = m_stat_abortedJobs;
+
+	const double elapsed = FPlatformTime::Seconds() - m_stat_startTime;
+	stats.completedJobsPerSecond = elapsed > 0.0 ? m_stat_completedJobs / elapsed : 0.0;
+	stats.averageJobSeconds = m_stat_completedJobs > 0 ? m_stat_jobSeconds / m_stat_completedJobs : 0.0;
+	return stats;
+}
+
+void ATerrainGenerator::ResetSchedulerStats()
+{
+	m_stat_dispatchedJobs = 0;
+	m_stat_completedJobs = 0;
+	m_stat_cancelledJobs = 0;
+	m_stat_abortedJobs = 0;
+	m_stat_maxQueueDepth = 0;
+	m_stat_jobSeconds = 0.0;
+	m_stat_startTime = FPlatformTime::Seconds();
+}
+
+FChunkUploadStats ATerrainGenerator::GetUploadStats() const
+{
+	FChunkUploadStats stats;
+
+	stats.backlogLength = m_array_uploadBacklog.Num();
+	stats.maxBacklogLength = m_stat_maxBacklogLength;
+	stats.uploadedChunkLODs = m_stat_uploadedChunkLODs;
+	stats.droppedChunkLODs = m_stat_droppedChunkLODs;
+	stats.uploadFrames = m_stat_uploadFrames;
+	stats.framesOverBudget = m_stat_framesOverBudget;
+	stats.lastFrameUploadMs = m_stat_lastFrameUploadMs;
+	stats.maxFrameUploadMs = m_stat_maxFrameUploadMs;
+	return stats;
+}
+
+void ATerrainGenerator::ResetUploadStats()
+{
+	m_stat_maxBacklogLength = 0;
+	m_stat_uploadedChunkLODs = 0;
+	m_stat_droppedChunkLODs = 0;
+	m_stat_uploadFrames = 0;
+	m_stat_framesOverBudget = 0;
+	m_stat_lastFrameUploadMs = 0.0;
+	m_stat_maxFrameUploadMs = 0.0;
+}
+
+FChunkPoolStats ATerrainGenerator::GetPoolStats() const
+{
+	FChunkPoolStats stats;
+
+	stats.pooledComponents = m_array_chunkPool.Num();
+	stats.pendingTeardowns = m_array_pendingTeardowns.Num();
+	stats.poolHits = m_stat_poolHits;
+	stats.poolMisses = m_stat_poolMisses;
+	stats.hitRate = (m_stat_poolHits + m_stat_poolMisses) > 0 ? (double)m_stat_poolHits / (m_stat_poolHits + m_stat_poolMisses) : 0.0;
+	stats.allocatedComponents = m_stat_allocatedComponents;
+	stats.destroyedComponents = m_stat_destroyedComponents;
+	return stats;
+}
+
+void ATerrainGenerator::ResetPoolStats()
+{
+	m_stat_poolHits = 0;
+	m_stat_poolMisses = 0;
+	m_stat_allocatedComponents = 0;
+	m_stat_destroyedComponents = 0;
+}
+
 FVector2D ATerrainGenerator::GetClosestCorner()
 {
 	const FVector2D actorPos = FVector2D(m_observedActor->GetActorLocation().X,
 		m_observedActor->GetActorLocation().Y);
-	const FVector2D divVal = (actorPos / UChunkFunctionLibrary::GetChunkWidth());
+	const FVector2D divVal = (actorPos / m_settings->chunkWidth);
 
-	const float chunkWidth = UChunkFunctionLibrary::GetChunkWidth();
+	const float chunkWidth = m_settings->chunkWidth;
 
 	const FVector2D leftUp = FVector2D(FMath::FloorToFloat(divVal.X), FMath::FloorToFloat(divVal.Y));
 	const FVector2D rightUp = leftUp + FVector2D(1, 0);
@@ -159,126 +994,368 @@ void ATerrainGenerator::AskToGenerate_Data(
 	const bool					forceIfEmptyThread
 )
 {
+	const FIntPoint chunkIdx((int32)chunkIndex.X, (int32)chunkIndex.Y);
+
 	if (!forceIfEmptyThread)
-	{		
-		// If the data is alread in the queue, we update its LOD.
-		if (m_map_chunkDatasToGenerate.Contains(chunkIndex))
-		{
-			m_map_chunkDatasToGenerate[chunkIndex] = LOD;
-		}else // Otherwise we add it into the queue
-		{
-			m_map_chunkDatasToGenerate.Add(chunkIndex, LOD);
-		}
+	{
+		QueueChunkLOD(chunkIdx, LOD);
 		return;
 	}
 
-	// If no free threads, we retun.
-	if (m_freeThreads == 0) return;
+	// If no free workers, we return.
+	if (GetFreeWorkers() == 0) return;
+
+	if (FChunkSlot* slot = m_chunkGrid.Find(chunkIdx))
+		SetQueuedLOD(*slot, 0);
+
+	StartGeneration(chunkIdx, LOD, true);
+}
+
+void ATerrainGenerator::QueueChunkLOD(const FIntPoint& chunkIndex, const uint8 LOD)
+{
+	// The queue only keeps the latest LOD of a chunk, an entry pushed for an older one gets skipped once popped
+	FChunkSlot* slot = m_chunkGrid.Find(chunkIndex);
+	if (!slot || slot->queuedLOD == LOD)
+		return;
+
+	SetQueuedLOD(*slot, LOD);
+
+	const float chunkWidth = m_settings->chunkWidth;
+	const FVector2D chunkCenter = (FVector2D(chunkIndex) + FVector2D(0.5, 0.5)) * chunkWidth;
+	const FVector2D observerPos = m_observedActor ? FVector2D(m_observedActor->GetActorLocation()) : FVector2D::ZeroVector;
+
+	m_array_jobQueue.HeapPush({ chunkIndex, LOD, FVector2D::DistSquared(chunkCenter, observerPos) });
+	m_stat_maxQueueDepth = FMath::Max(m_stat_maxQueueDepth, m_queuedChunks);
+}
+
+void ATerrainGenerator::StartGeneration(const FIntPoint& chunkIndex, const uint8 LOD, const bool forced)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::StartGeneration);
+
+	if (!m_usesWorkerPool || !FTerrainWorkerPool::Get().TryReserveWorker())
+		return;
+
+	FChunkGenerationJob& job = m_array_runningJobs.AddDefaulted_GetRef();
+	job.chunkIndex = chunkIndex;
+	job.LOD = LOD;
+	job.dispatchTime = FPlatformTime::Seconds();
+	job.forced = forced;
+	job.token = MakeShared<FChunkJobToken, ESPMode::ThreadSafe>();
+	job.future = AsyncPool(FTerrainWorkerPool::Get().GetPool(), [chunkIndex, LOD, token = job.token, settings = m_settings]() {
+		return UChunkFunctionLibrary::TryGenerateChunkData_LOD(*settings, FVector2D(chunkIndex) * settings->chunkWidth, LOD, *token);
+		});
 
-	// We iterate through the threads, and if their futures are invalid, that means they are free and we add another working proccess
-	for (int i = 0; i < m_maxThreads; i++)
+	m_stat_dispatchedJobs++;
+}
+
+void ATerrainGenerator::CancelStaleJobs()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::CancelStaleJobs);
+
+	for (FChunkGenerationJob& job : m_array_runningJobs)
 	{
-		if (!m_array_futureMeshDatas[i].IsValid())
+		// Whoever forced it wants that LOD whatever the window shows
+		if (job.forced || job.token->IsCancelled())
+			continue;
+
+		// A job is stale once its chunk left the window, or once the chunk wants another LOD than the one being built
+		const FChunkSlot* slot = m_chunkGrid.Find(job.chunkIndex);
+		if (!slot || slot->wantedLOD != job.LOD)
 		{
-			m_array_futureMeshDatas[i] = Async(EAsyncExecution::ThreadPool, [chunkIndex, LOD]() {
-				return &(UChunkFunctionLibrary::GenerateChunkData_LOD(FVector2D(chunkIndex * UChunkFunctionLibrary::GetChunkWidth()), LOD));
-				});
-			m_map_chunkDatasToGenerate.Remove(chunkIndex);
-			m_array_futureChunkLODs[i] = FVector(chunkIndex, LOD);
-			m_freeThreads--;
-			return;
+			job.token->Cancel();
+			m_stat_cancelledJobs++;
 		}
 	}
-	return;
 }
 
-inline void ATerrainGenerator::AskToGenerate_PossibleData()
-
+void ATerrainGenerator::AskToGenerate_PossibleData()
 {
-	if(m_freeThreads == 0 || m_map_chunkDatasToGenerate.IsEmpty())
-		return;
+	SCOPE_CYCLE_COUNTER(STAT_Terrain_DispatchJobs);
 
-	// We just take the first chunk in the queue
-	auto entry = m_map_chunkDatasToGenerate.begin();
+	// We start the closest queued chunks until every worker is busy
+	while (GetFreeWorkers() > 0 && m_array_jobQueue.Num() > 0)
+	{
+		FChunkJobRequest request;
+		m_array_jobQueue.HeapPop(request, EAllowShrinking::No);
 
-	// Then force it to be generated, meaning, its not gonna go to the queue, but directly start the generation on some free thread
-	AskToGenerate_Data(entry->Key, entry->Value, true);
+		FChunkSlot* slot = m_chunkGrid.Find(request.chunkIndex);
+		if (!slot || slot->queuedLOD != request.LOD)
+			continue;
+
+		SetQueuedLOD(*slot, 0);
+
+		if (IsChunkLodGenerated(request.chunkIndex, request.LOD) || IsChunkLodUnderGeneration(request.chunkIndex, request.LOD))
+			continue;
+
+		StartGeneration(request.chunkIndex, request.LOD);
+	}
 }
 
 void ATerrainGenerator::AskToDisplayChunks()
 {
-	for (auto it : m_array_visibleChunks)
+	SCOPE_CYCLE_COUNTER(STAT_Terrain_AskToDisplayChunks);
+
+	// No chunk is ever queued in the clipmap mode, so the rest has nothing to do
+	if (m_terrainMode == ETerrainMode::Clipmap)
+	{
+		UpdateClipmap();
+		return;
+	}
+
+	const double now = FPlatformTime::Seconds();
+	const FVector2D closestCorner = GetClosestCorner();
+	const FIntPoint corner((int32)closestCorner.X, (int32)closestCorner.Y);
+	const FIntPoint move = corner - m_windowCorner;
+
+	int32 updatedCells = 0;
+
+	// Nothing changes while the observer stays around the same corner, but for the chunks that got a LOD or lost a job.
+	// A walk moves the window by one chunk, anything longer is a teleport and the window is built again.
+	// The grid moves first, its margin keeps the old window in it for a walk
+	if (!m_windowValid || FMath::Abs(move.X) > 1 || FMath::Abs(move.Y) > 1)
 	{
-		it->SetFutureLOD(FChunkLodInfos());
+		updatedCells = (m_renderHalfWidth + m_renderHalfWidth) * (m_renderHalfWidth + m_renderHalfWidth);
+		MoveChunkGrid(corner);
+		RebuildWindow(corner, now);
 	}
+	else if (move != FIntPoint::ZeroValue)
+	{
+		const FWindowShift& shift = m_windowShifts[(move.Y + 1) * 3 + (move.X + 1)];
+		updatedCells = shift.changedCells.Num() + shift.leftCells.Num();
+		MoveChunkGrid(corner);
+		ShiftWindow(corner, now);
+	}
+	else if (m_array_dirtyChunks.IsEmpty())
+	{
+		return;
+	}
+
+	updatedCells += m_array_dirtyChunks.Num();
 
 	const int32 renderWidth = m_renderHalfWidth + m_renderHalfWidth;
-	m_array_visibleChunks.Empty(renderWidth * renderWidth);
+	const FIntPoint startIdx = m_windowCorner - FIntPoint(m_renderHalfWidth);
+
+	for (const FIntPoint& chunkIdx : m_array_dirtyChunks)
+	{
+		FChunkSlot* slot = m_chunkGrid.Find(chunkIdx);
+		if (!slot || !slot->dirty)
+			continue;
+
+		slot->dirty = false;
+
+		const FIntPoint cell = chunkIdx - startIdx;
+		if (cell.X < 0 || cell.X >= renderWidth || cell.Y < 0 || cell.Y >= renderWidth)
+			continue;
+
+		UpdateWindowChunk(chunkIdx, m_windowInfos[cell.Y * renderWidth + cell.X], now);
+	}
+	m_array_dirtyChunks.Reset();
+
+	INC_DWORD_STAT_BY(STAT_Terrain_WindowCellsUpdated, updatedCells);
+
+	CancelStaleJobs();
+}
+
+void ATerrainGenerator::RebuildWindow(const FIntPoint& corner, const double now)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::RebuildWindow);
+
+	m_array_jobQueue.Reset();
+	m_array_dirtyChunks.Reset();
+	m_chunkGrid.ForEach([this](const FIntPoint&, FChunkSlot& slot)
+		{
+			SetQueuedLOD(slot, 0);
+			slot.wantedLOD = 0;
+			slot.dirty = false;
+		});
 
-	const FVector2D startIdx = GetClosestCorner() - m_renderHalfWidth;
+	m_windowCorner = corner;
+	m_windowValid = true;
+
+	const int32 renderWidth = m_renderHalfWidth + m_renderHalfWidth;
+	const FIntPoint startIdx = corner - FIntPoint(m_renderHalfWidth);
 
 	for (int32 Y = 0; Y < renderWidth; Y++)
 	{
 		for (int32 X = 0; X < renderWidth; X++)
 		{
 			// FIX: X is X, Y is Y
-			const FVector2D chunkIdx = startIdx + FVector2D(X, Y);
+			UpdateWindowChunk(startIdx + FIntPoint(X, Y), m_windowInfos[Y * renderWidth + X], now);
+		}
+	}
 
-			const uint8 ThisLOD = (uint8)m_lodMatrix[Y].array[X];
+	// Whatever the old window still shows in the margin is outside of the new one
+	m_chunkGrid.ForEach([&](const FIntPoint& chunkIndex, FChunkSlot& slot)
+		{
+			const FIntPoint cell = chunkIndex - startIdx;
+			if (cell.X >= 0 && cell.X < renderWidth && cell.Y >= 0 && cell.Y < renderWidth)
+				return;
 
-			if (ThisLOD > 1)
-			{
-				// Neighbor sampling in the same render window
-				auto GetNeighborLOD = [&](int32 Ny, int32 Nx) -> uint8
-					{
-						if (Ny < 0 || Ny >= renderWidth || Nx < 0 || Nx >= renderWidth)
-							return ThisLOD;
+			if (slot.component && slot.component->GetExpectedLodInfos().LOD != 0)
+				HideChunk(slot.component, now);
+		});
+}
 
-						return (uint8)m_lodMatrix[Ny].array[Nx];
-					};
+void ATerrainGenerator::ShiftWindow(const FIntPoint& corner, const double now)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ATerrainGenerator::ShiftWindow);
 
-				// Left=X-1 Right=X+1 Up=Y-1 Down=Y+1
-				const uint8 LOD_Left = GetNeighborLOD(Y, X - 1);
-				const uint8 LOD_Right = GetNeighborLOD(Y, X + 1);
-				const uint8 LOD_Up = GetNeighborLOD(Y - 1, X);
-				const uint8 LOD_Down = GetNeighborLOD(Y + 1, X);
+	const FIntPoint move = corner - m_windowCorner;
+	const FWindowShift& shift = m_windowShifts[(move.Y + 1) * 3 + (move.X + 1)];
 
-				// Downscale this border if the neighbor is COARSER (lower LOD number)
-				const bool bDownscaleLeft = (LOD_Left > 1) && (LOD_Left < ThisLOD);
-				const bool bDownscaleRight = (LOD_Right > 1) && (LOD_Right < ThisLOD);
-				const bool bDownscaleUp = (LOD_Up > 1) && (LOD_Up < ThisLOD);
-				const bool bDownscaleDown = (LOD_Down > 1) && (LOD_Down < ThisLOD);
+	const FIntPoint oldStartIdx = m_windowCorner - FIntPoint(m_renderHalfWidth);
+	const FIntPoint startIdx = corner - FIntPoint(m_renderHalfWidth);
 
-				if (m_map_chunkComponents.Contains(chunkIdx))
-				{
-					UChunkComponent* component = m_map_chunkComponents[chunkIdx];
+	m_windowCorner = corner;
 
-					if (component->ContainsLOD(ThisLOD))
-					{
-						component->SetFutureLOD(FChunkLodInfos(ThisLOD, bDownscaleLeft, bDownscaleRight, bDownscaleUp, bDownscaleDown));
-						m_array_visibleChunks.Add(component);
-					}
-					else
-					{
-						AskToGenerate_Data(chunkIdx, ThisLOD, false);
-						component->SetFutureVisibilityToClosestLOD(ThisLOD);
-					}
-				}
-				else
-				{
-					AskToGenerate_Data(chunkIdx, ThisLOD, false);
-				}
-			}
-			else
-			{
-				if (m_map_chunkComponents.Contains(chunkIdx))
-				{
-					m_map_chunkComponents[chunkIdx]->SetFutureLOD(FChunkLodInfos());
-				}
-			}
-		}
+	for (const FIntPoint& cell : shift.leftCells)
+	{
+		FChunkSlot* slot = m_chunkGrid.Find(oldStartIdx + cell);
+		if (!slot)
+			continue;
+
+		slot->wantedLOD = 0;
+		SetQueuedLOD(*slot, 0);
+
+		if (slot->component)
+			HideChunk(slot->component, now);
 	}
+
+	const int32 renderWidth = m_renderHalfWidth + m_renderHalfWidth;
+	for (const FIntPoint& cell : shift.changedCells)
+	{
+		UpdateWindowChunk(startIdx + cell, m_windowInfos[cell.Y * renderWidth + cell.X], now);
+	}
+
+	// Every queued chunk got closer or farther
+	RefreshJobQueue();
 }
 
+void ATerrainGenerator::UpdateWindowChunk(
+	const FIntPoint&		chunkIdx,
+	const FChunkLodInfos&	infos,
+	const double			now
+)
+{
+	// The grid covers the window and its margin, so every chunk of the window has a slot
+	FChunkSlot* slot = m_chunkGrid.Find(chunkIdx);
+	if (!slot)
+		return;
+
+	UChunkComponent* component = slot->component;
 
+	// Only the changed cells get here, so the LOD a chunk kept showing since then is stamped before it's replaced
+	if (component && component->GetExpectedLodInfos().LOD >= 1)
+		component->TouchLOD(component->GetExpectedLodInfos().LOD, now);
+
+	if (infos.LOD < FTerrainSettings::MinShownLOD)
+	{
+		slot->wantedLOD = 0;
+		SetQueuedLOD(*slot, 0);
+
+		if (component)
+			HideChunk(component, now);
+		return;
+	}
+
+	slot->wantedLOD = infos.LOD;
+
+	if (!component)
+	{
+		QueueChunkLOD(chunkIdx, infos.LOD);
+		return;
+	}
+
+	if (component->ContainsLOD(infos.LOD))
+	{
+		SetQueuedLOD(*slot, 0);
+
+		component->SetFutureLOD(infos);
+		m_set_visibleChunks.Add(component);
+	}
+	else
+	{
+		QueueChunkLOD(chunkIdx, infos.LOD);
 
+		// A chunk that was visible shows its closest LOD without downscaled borders
+		component->SetFutureVisibilityToClosestLOD(infos.LOD, m_set_visibleChunks.Remove(component) > 0);
+	}
+
+	// Whatever LOD the chunk shows now is the most recently used one, for the memory budget
+	if (component->GetExpectedLodInfos().LOD >= 1)
+		component->TouchLOD(component->GetExpectedLodInfos().LOD, now);
+}
+
+void ATerrainGenerator::HideChunk(UChunkComponent* chunkComponent, const double now)
+{
+	// The LOD was shown up to now, it must not look older than the ones that just started showing to the memory budget
+	if (chunkComponent->GetExpectedLodInfos().LOD >= 1)
+		chunkComponent->TouchLOD(chunkComponent->GetExpectedLodInfos().LOD, now);
+
+	chunkComponent->SetFutureLOD(FChunkLodInfos());
+	m_set_visibleChunks.Remove(chunkComponent);
+}
+
+void ATerrainGenerator::RefreshJobQueue()
+{
+	const float chunkWidth = m_settings->chunkWidth;
+	const FVector2D observerPos = m_observedActor ? FVector2D(m_observedActor->GetActorLocation()) : FVector2D::ZeroVector;
+
+	// Also drops the entries of the LODs that aren't wanted anymore
+	m_array_jobQueue.Reset();
+	m_chunkGrid.ForEach([&](const FIntPoint& chunkIndex, const FChunkSlot& slot)
+		{
+			if (slot.queuedLOD == 0)
+				return;
+
+			const FVector2D chunkCenter = (FVector2D(chunkIndex) + FVector2D(0.5, 0.5)) * chunkWidth;
+			m_array_jobQueue.Add({ chunkIndex, slot.queuedLOD, FVector2D::DistSquared(chunkCenter, observerPos) });
+		});
+	m_array_jobQueue.Heapify();
+}
+
+void ATerrainGenerator::UpdateClipmap()
+{
+	if (!m_clipmap || !m_observedActor)
+		return;
+
+	const uint64 startCycles = FPlatformTime::Cycles64();
+
+	const FVector observerLocation = m_observedActor->GetActorLocation();
+	const FClipmapUpdateResult result = m_clipmap->UpdateClipmap(FVector2D(observerLocation.X, observerLocation.Y));
+
+	const double frameMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - startCycles);
+
+	// The first update fills every ring, like the first window fills every chunk
+	if (m_stat_windowFillSeconds < 0.0)
+		m_stat_windowFillSeconds = FPlatformTime::Seconds() - m_stat_initializeTime;
+
+	m_stat_clipmapFrames++;
+	m_stat_clipmapSeconds += frameMs / 1000.0;
+	m_stat_lastClipmapMs = frameMs;
+	m_stat_maxClipmapMs = FMath::Max(m_stat_maxClipmapMs, frameMs);
+	m_stat_clipmapSampledHeights += result.sampledHeights;
+	m_stat_clipmapRebuiltLevels += result.rebuiltLevels;
+}
+
+FTerrainClipmapStats ATerrainGenerator::GetClipmapStats() const
+{
+	FTerrainClipmapStats stats;
+	stats.frames = m_stat_clipmapFrames;
+	stats.lastFrameMs = m_stat_lastClipmapMs;
+	stats.averageFrameMs = m_stat_clipmapFrames > 0 ? m_stat_clipmapSeconds * 1000.0 / m_stat_clipmapFrames : 0.0;
+	stats.maxFrameMs = m_stat_maxClipmapMs;
+	stats.sampledHeights = m_stat_clipmapSampledHeights;
+	stats.rebuiltLevels = m_stat_clipmapRebuiltLevels;
+	return stats;
+}
+
+void ATerrainGenerator::ResetClipmapStats()
+{
+	m_stat_clipmapFrames = 0;
+	m_stat_clipmapSeconds = 0.0;
+	m_stat_lastClipmapMs = 0.0;
+	m_stat_maxClipmapMs = 0.0;
+	m_stat_clipmapSampledHeights = 0;
+	m_stat_clipmapRebuiltLevels = 0;
+}
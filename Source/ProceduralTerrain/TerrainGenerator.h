@@ -5,40 +5,304 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Components/ChunkComponent.h"
+#include "Components/TerrainMeshComponent.h"
+#include "Components/TerrainClipmapComponent.h"
 #include "Libraries/MeshFunctionLibrary.h"
 #include "Libraries/ChunkFunctionLibrary.h"
+#include "Structures/ChunkRingGrid.h"
+#include "Structures/TerrainWorkerPool.h"
 #include "HAL/ThreadSafeCounter.h"
 #include "Misc/ScopeLock.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Async/Future.h"
 #include "TerrainGenerator.generated.h"
 
+// Priority of the threads of the terrain worker pool
+UENUM(BlueprintType)
+enum class ETerrainWorkerPriority : uint8 {
+	Lowest			= 0,
+	BelowNormal		= 1,
+	SlightlyBelow	= 2,
+	Normal			= 3
+};
+
+// How the terrain is meshed around the observer
+UENUM(BlueprintType)
+enum class ETerrainMode : uint8 {
+	Chunks			= 0,		//	Chunk components with a LOD per chunk, generated on the worker pool
+	Clipmap			= 1			//	Nested rings centered on the observer, updated on the game thread
+};
+
+// Depth of the generation queue and throughput of the workers since the last reset
+USTRUCT(BlueprintType)
+struct FChunkSchedulerStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		queueDepth = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		maxQueueDepth = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		runningJobs = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		workerThreads = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		dispatchedJobs = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		completedJobs = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		cancelledJobs = 0;				//	Superseded or left the window while running
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		abortedJobs = 0;				//	Cancelled ones that stopped early, the others finished before noticing
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		completedJobsPerSecond = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		averageJobSeconds = 0.0;		//	From the dispatch to the result being picked up
+};
+
+// Cells of the render window to go through when its corner moves by one chunk, in window coordinates
+struct FWindowShift
+{
+	TArray<FIntPoint>	changedCells;		//	Cells of the new window whose chunk shows something else than before, or just entered the window
+	TArray<FIntPoint>	leftCells;			//	Cells of the old window that were shown and are out of the new one
+};
+
+// Everything the terrain keeps about one chunk around the window, in its slot of the ring grid
+struct FChunkSlot
+{
+	UChunkComponent*	component = nullptr;
+	uint8				queuedLOD = 0;			//	LOD the queue wants generated, 0 if the chunk isn't queued
+	uint8				wantedLOD = 0;			//	LOD the window wants shown, 0 out of the window or under LOD 2
+	bool				dirty = false;			//	Already in the dirty chunks
+};
+
+// A queued chunk LOD, the closest chunks come first and the finer LOD wins between equally close ones
+struct FChunkJobRequest
+{
+	FIntPoint		chunkIndex;
+	uint8			LOD;
+	double			distanceSquared;
+
+	FORCEINLINE bool operator<(const FChunkJobRequest& other) const
+	{
+		return distanceSquared < other.distanceSquared || (distanceSquared == other.distanceSquared && LOD > other.LOD);
+	}
+};
+
+// A chunk LOD being generated on the worker pool
+struct FChunkGenerationJob
+{
+	TFuture<FChunkLodData*>		future;				//	nullptr once the job aborted
+	FChunkJobTokenPtr			token;
+	FIntPoint					chunkIndex;
+	uint8						LOD;
+	double						dispatchTime;
+	bool						forced = false;		//	Asked for through AskToGenerate_Data, the window doesn't cancel it
+};
+
+// A generated chunk LOD waiting for its turn to be handed to the chunk component
+struct FChunkUploadEntry
+{
+	FIntPoint					chunkIndex;
+	uint8						LOD;
+	FChunkLodData*				data;
+	double						distanceSquared;
+};
+
+// How much of the per-frame upload budget the backlog takes, since the last reset
+USTRUCT(BlueprintType)
+struct FChunkUploadStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		backlogLength = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		maxBacklogLength = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		uploadedChunkLODs = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		droppedChunkLODs = 0;			//	Generated for a chunk that left the grid meanwhile
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		uploadFrames = 0;				//	Frames that uploaded anything
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		framesOverBudget = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		lastFrameUploadMs = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		maxFrameUploadMs = 0.0;
+};
+
+// Reuse of the chunk components since the last reset
+USTRUCT(BlueprintType)
+struct FChunkPoolStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		pooledComponents = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		pendingTeardowns = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		poolHits = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		poolMisses = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		hitRate = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		allocatedComponents = 0;		//	NewObject calls, the prewarm included
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		destroyedComponents = 0;		//	Torn down with the pool already full
+};
+
+// Chunk data a chunk component dropped after uploading it
+USTRUCT(BlueprintType)
+struct FChunkReleasedBytes
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) FVector2D	chunkIndex = FVector2D::ZeroVector;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		bytes = 0;
+};
+
+// Cost of the clipmap updates since the last reset
+USTRUCT(BlueprintType)
+struct FTerrainClipmapStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		frames = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		lastFrameMs = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		averageFrameMs = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) double		maxFrameMs = 0.0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		sampledHeights = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		rebuiltLevels = 0;		//	Mesh sections updated or recreated
+};
+
+// CPU memory held by the LOD data of the chunk components
+USTRUCT(BlueprintType)
+struct FChunkMemoryStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int32		chunks = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		residentBytes = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		expandedBytes = 0;		//	Same data with full FMeshData vertices and its own triangles and UVs
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) TArray<int64>	residentBytesPerLOD;	//	Data and render bytes, what the memory budget is checked against
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		budgetBytes = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		evictedChunks = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		evictedLODs = 0;		//	Unused LODs of chunks still in the window
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) int64		releasedBytes = 0;		//	Chunk data dropped after its upload
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) TArray<FChunkReleasedBytes>	releasedBytesPerChunk;
+};
+
 UCLASS(Blueprintable)
 class PROCEDURALTERRAIN_API ATerrainGenerator : public AActor
 {
 	GENERATED_BODY()
 protected:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Chunks, or a clipmap of rings around the observer for flyovers. Read by Initialize"))
+	ETerrainMode									m_terrainMode = ETerrainMode::Chunks;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", ClampMax = "16", ToolTip = "Rings of the clipmap, each one twice as coarse as the previous. The finest has the cell of the max LOD of the chunks"))
+	int32											m_clipmapLevels = 8;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "8", ToolTip = "Cells on a side of every ring of the clipmap, rounded down to a multiple of 4"))
+	int32											m_clipmapResolution = 128;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Collision on the finest ring of the clipmap, cooked off the game thread whenever it moves. The coarser rings never collide"))
+	bool											m_clipmapCollision = true;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Most chunk LODs of this terrain generated at once. The worker pool is shared by every terrain, the first one to initialize sets its thread count"))
 	uint8											m_maxThreads;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Priority of the threads of the terrain worker pool, if this terrain is the one that creates it"))
+	ETerrainWorkerPriority							m_workerPriority = ETerrainWorkerPriority::BelowNormal;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Most chunk LODs handed to the chunk components in one frame, 0 for no limit"))
 	uint8											m_maxChunkGenerationPerFrame;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Milliseconds a frame can spend handing generated chunk LODs to the chunk components, the closest one still goes if it alone is over"))
+	float											m_uploadBudgetMs = 2.0f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Memory the chunk LODs can hold, data and render side, before the least recently used ones get evicted. 0 for no limit"))
+	int32											m_chunkMemoryBudgetMB = 512;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "How much the distance to the observer, in chunks, adds to the age of a LOD when picking what to evict"))
+	float											m_evictionDistanceWeight = 1.0f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Chunk components created and registered by Initialize, ready to be given to new chunks"))
+	int32											m_chunkPoolPrewarm = 64;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Most reset chunk components kept for reuse, the others are destroyed"))
+	int32											m_chunkPoolSize = 256;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Evicted chunk components reset per frame, the rest wait for the next ones"))
+	int32											m_maxChunkTeardownsPerFrame = 4;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TArray<int>										lodRepetitions;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", ToolTip = "Chunks kept around the render window on each side, the ones farther away are evicted as the window moves"))
+	int32											m_chunkGridMargin = 2;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Memory this terrain adds to the budget of the heightfield cache, which every terrain shares"))
+	int32											m_heightfieldCacheBudgetMB = 64;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Graph the terrain height is evaluated from, the default single octave is used if it has no nodes"))
+	FNoiseGraph										m_noiseGraph;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Stores the generated chunk data with float chunk relative positions and packed normals"))
+	bool											m_compactChunkVertices = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Chunk components drop their chunk data once it is uploaded, it is generated again if something asks for it"))
+	bool											m_releaseUploadedChunkData = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Keeps the generated chunk LODs on disk, keyed by the settings, so the next sessions read them back instead of generating them"))
+	bool											m_useDiskCache = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Directory of the disk cache, Saved/TerrainCache if empty"))
+	FString											m_diskCacheDirectory;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Disk the cached settings can take, the ones unused for the longest are deleted when the cache opens past it. 0 for no limit"))
+	int32											m_diskCacheBudgetMB = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Draws every chunk through one terrain primitive with pooled buffers, instead of a mesh component per chunk"))
+	bool											m_useTerrainProxy = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "Material of the terrain primitive"))
+	UMaterialInterface*								m_terrainMaterial = nullptr;
 
 
 private:
 	AActor*											m_observedActor;
 
-	uint8											m_freeThreads;
+	UPROPERTY()
+	UTerrainMeshComponent*							m_terrainMesh = nullptr;
+
+	UPROPERTY()
+	UTerrainClipmapComponent*						m_clipmap = nullptr;				//	Only in the clipmap mode
+
+	FTerrainSettingsPtr								m_settings;							//	Snapshot Initialize made, every job of the terrain captures it
+
 	uint8											m_renderHalfWidth;
 
 	TArray<FArrayUint8>								m_lodMatrix;
+	TArray<FChunkLodInfos>							m_windowInfos;						//	LOD and downscaled borders of every cell of the window, row major, from the LOD matrix
+	FWindowShift									m_windowShifts[9];					//	One per corner move of -1..1 chunk on each axis
+	FIntPoint										m_windowCorner;
+	bool											m_windowValid = false;				//	Set once the window was built around m_windowCorner
+	TArray<FIntPoint>								m_array_dirtyChunks;				//	Chunks of the window to look at again, a LOD of theirs arrived or a job of theirs aborted
+
+	TChunkRingGrid<FChunkSlot>						m_chunkGrid;						//	Window and its margin, with the component, queued and wanted LOD of every chunk
+	int32											m_queuedChunks = 0;
+	TArray<FChunkJobRequest>						m_array_jobQueue;					//	Heap of the queued chunks, entries whose LOD isn't wanted anymore are skipped
+
+	bool											m_usesWorkerPool = false;			//	Added as a user of the shared pool, which only runs terrain jobs so they don't wait behind the engine tasks
+	bool											m_usesDiskCache = false;			//	Holds an Open of the disk cache
+	int64											m_heightfieldBudgetBytes = -1;		//	Added to the heightfield cache, -1 if nothing was
+	TArray<FChunkGenerationJob>						m_array_runningJobs;				//	Never more than the threads of the pool
+	TArray<FChunkUploadEntry>						m_array_uploadBacklog;				//	Generated chunk LODs that didn't fit the upload budget yet
+
+	UPROPERTY()
+	TArray<UChunkComponent*>						m_array_chunkPool;					//	Reset chunk components, registered unless the terrain proxy draws them
+	UPROPERTY()
+	TArray<UChunkComponent*>						m_array_pendingTeardowns;			//	Evicted chunk components waiting for their reset
 
-	TMap<FVector2D, UChunkComponent*>				m_map_chunkComponents; 
-	TMap<FVector2D, uint8>							m_map_chunkDatasToGenerate;			//	chunk datas in queue or being generated right now
+	int64											m_stat_dispatchedJobs = 0;
+	int64											m_stat_completedJobs = 0;
+	int64											m_stat_cancelledJobs = 0;
+	int64											m_stat_abortedJobs = 0;
+	int32											m_stat_maxQueueDepth = 0;
+	double											m_stat_jobSeconds = 0.0;
+	double											m_stat_startTime = 0.0;
 
-	TArray<TFuture<FChunkLodData*>>					m_array_futureMeshDatas;			//	chunk datas that are begin generated right now
-	TArray<FVector>									m_array_futureChunkLODs;			//	chunk data LODs that are being generated now
+	int32											m_stat_maxBacklogLength = 0;
+	int64											m_stat_uploadedChunkLODs = 0;
+	int64											m_stat_droppedChunkLODs = 0;
+	int64											m_stat_uploadFrames = 0;
+	int64											m_stat_framesOverBudget = 0;
+	double											m_stat_lastFrameUploadMs = 0.0;
+	double											m_stat_maxFrameUploadMs = 0.0;
 
-	TArray<UChunkComponent*>						m_array_visibleChunks;
+	int64											m_stat_evictedChunks = 0;
+	int64											m_stat_evictedLODs = 0;
+
+	int64											m_stat_poolHits = 0;
+	int64											m_stat_poolMisses = 0;
+	int64											m_stat_allocatedComponents = 0;
+	int64											m_stat_destroyedComponents = 0;
+
+	double											m_stat_initializeTime = 0.0;
+	double											m_stat_windowFillSeconds = -1.0;
+
+	int64											m_stat_clipmapFrames = 0;
+	double											m_stat_clipmapSeconds = 0.0;
+	double											m_stat_lastClipmapMs = 0.0;
+	double											m_stat_maxClipmapMs = 0.0;
+	int64											m_stat_clipmapSampledHeights = 0;
+	int64											m_stat_clipmapRebuiltLevels = 0;
+
+	TSet<UChunkComponent*>							m_set_visibleChunks;				//	Chunks showing the LOD the window wants for them
 
 public:	
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
@@ -46,31 +310,152 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void Initialize(AActor* observedActor);
 
-	UFUNCTION(BlueprintCallable, meta = (ReturnDisplayName = "Success", ToolTip = "Returns true if there was a free thread that started the requested generation"))
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Writes the settings of this terrain, its noise graph included, for the -Snapshot= of TerrainBake and TerrainBenchmark. Saved/TerrainSnapshots/<name>.json if no path is given"))
+	bool SaveSettingsSnapshot(const FString& path);
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Queues the chunk LOD, or starts it right away on a free worker if forced"))
 	void AskToGenerate_Data(						//	Asks to generate some new chunk data
 		const FVector2D				chunkIndex,
 		const uint8					LOD,
 		const bool					forceIfEmptyThread
 	);
 
-	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Starts some generation if any of the threads are free"))
-	FORCEINLINE void AskToGenerate_PossibleData();
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Starts the closest queued chunks until every worker is busy"))
+	void AskToGenerate_PossibleData();
 	
 	UFUNCTION(BlueprintCallable)
 	void AskToDisplayChunks();						// Checks for the necessary meshes that need to be visible and sets their visibilities				
 					 
 	UFUNCTION(BlueprintCallable)
-	void Refresh_Datas();							// Saves any calculated future mesh data into the chunk components
+	void Refresh_Datas();							// Saves the calculated chunk datas into the chunk components, the closest first and within the upload budget
 
 	FORCEINLINE bool IsChunkLodGenerated(
-		const FVector2D&		chunkIndex,
+		const FIntPoint&		chunkIndex,
 		const uint8				LOD
 	);
 
 	bool IsChunkLodUnderGeneration(
-		const FVector2D&		chunkIndex,
+		const FIntPoint&		chunkIndex,
 		const uint8				LOD
 	);
 
 	FORCEINLINE FVector2D GetClosestCorner();
+
+	// Within the jobs of this terrain, and the workers the other terrains left
+	FORCEINLINE int32 GetFreeWorkers() const
+	{
+		return m_usesWorkerPool ? FMath::Clamp((int32)m_maxThreads - m_array_runningJobs.Num(), 0, FTerrainWorkerPool::Get().GetFreeWorkers()) : 0;
+	}
+
+	void QueueChunkLOD(							//	Nothing if the chunk is out of the grid or already queued for that LOD
+		const FIntPoint&		chunkIndex,
+		const uint8				LOD
+	);
+
+	void StartGeneration(
+		const FIntPoint&		chunkIndex,
+		const uint8				LOD,
+		const bool				forced = false
+	);
+
+	FTerrainSettings BuildSettings() const;		//	The library settings with the ones of this terrain on top, not frozen yet
+
+	void DestroyThreadPool();					//	Waits for the jobs of this terrain and leaves the shared pool
+
+	void ReleaseSharedCaches();					//	Gives back what this terrain holds of the disk and heightfield caches
+
+	void CancelStaleJobs();						//	Cancels the running jobs whose chunk LOD the window doesn't want anymore
+
+	UChunkComponent* GetOrCreateChunkComponent(const FIntPoint& chunkIndex);		//	nullptr out of the chunk grid
+
+	void EnforceMemoryBudget();					//	Evicts chunks out of the window and unused LODs, least recently used and farthest first
+
+	void EvictChunk(const FIntPoint& chunkIndex);
+
+	void EvictSlot(const FIntPoint& chunkIndex, FChunkSlot& slot);
+
+	void SetQueuedLOD(FChunkSlot& slot, const uint8 LOD);		//	0 takes the chunk out of the queue
+
+	void MarkChunkDirty(const FIntPoint& chunkIndex);
+
+	void MoveChunkGrid(const FIntPoint& corner);				//	Evicts the chunks the grid doesn't cover anymore
+
+	UChunkComponent* AllocateChunkComponent();
+
+	void ProcessChunkTeardowns();				//	Resets a few of the evicted chunk components and puts them back in the pool
+
+	void PublishFrameStats() const;				//	Queue, jobs and resident chunks of the terrain, into the counters of "stat terrain"
+
+	// Rows of the render window with the LOD of every chunk, from how many chunks every LOD is repeated over from the edge. Returns the half width
+	static int32 BuildLodMatrix(
+		const TArray<int>&		lodRepetitions,
+		TArray<FArrayUint8>&	outMatrix
+	);
+
+	void BuildWindowShifts();					//	Window infos and shifts, from the LOD matrix
+
+	void RebuildWindow(const FIntPoint& corner, const double now);
+
+	void ShiftWindow(const FIntPoint& corner, const double now);
+
+	// Shows the LOD the window wants for the chunk, or the closest one it has while the wanted one is generated
+	void UpdateWindowChunk(
+		const FIntPoint&		chunkIndex,
+		const FChunkLodInfos&	infos,
+		const double			now
+	);
+
+	void HideChunk(UChunkComponent* chunkComponent, const double now);
+
+	void RefreshJobQueue();						//	Rebuilds the heap of the queued chunks with their current distance
+
+	void UpdateClipmap();						//	Moves the clipmap around the observer, in place of the window in the clipmap mode
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Hit, miss and eviction counters of the heightfield cache"))
+	FHeightfieldCacheStats GetHeightfieldCacheStats() const;
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Bytes held by the LOD data of every chunk component, and what it would take in the full vertex format"))
+	FChunkMemoryStats GetChunkMemoryStats() const;
+
+	// The data of a generated chunk LOD, generated again on this thread if its chunk component released it. nullptr if the LOD was never generated
+	const FChunkLodData* GetChunkLodData(
+		const FIntPoint&		chunkIndex,
+		const uint8				LOD
+	);
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Queue depth and throughput of the generation workers since the last reset"))
+	FChunkSchedulerStats GetSchedulerStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetSchedulerStats();
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Backlog length and budget overruns of the upload of the generated chunk LODs since the last reset"))
+	FChunkUploadStats GetUploadStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetUploadStats();
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Hit rate and allocations of the chunk component pool since the last reset"))
+	FChunkPoolStats GetPoolStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetPoolStats();
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Hits, misses and read and write times of the disk cache since the last reset, with how long the first window took to fill"))
+	FChunkDiskCacheStats GetDiskCacheStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetDiskCacheStats();
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Game and render thread costs of drawing the chunks since the last reset, for whichever path the terrain uses"))
+	FTerrainRenderStats GetTerrainRenderStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetTerrainRenderStats();
+
+	UFUNCTION(BlueprintCallable, meta = (ToolTip = "Per frame cost of the clipmap updates since the last reset, with the heights they sampled"))
+	FTerrainClipmapStats GetClipmapStats() const;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetClipmapStats();
 };
@@ -0,0 +1,75 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "../Libraries/NoiseFunctionLibrary.h"
+#include "Math/RandomStream.h"
+
+// The batch kernel is only worth it if it gives the same heights as FMath::PerlinNoise2D, the terrains of both paths have to match
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNoiseBatchMatchesScalarTest, "ProceduralTerrain.Noise.PerlinNoise2DBatch",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FNoiseBatchMatchesScalarTest::RunTest(const FString& Parameters)
+{
+    static constexpr float Tolerance = 1e-5f;
+
+    // Otherwise the batch calls quietly run the scalar path and the comparison below proves nothing
+    TestTrue(TEXT("Batch kernel enabled"), UNoiseFunctionLibrary::IsBatchKernelEnabled());
+
+    FRandomStream stream(1337);
+
+    // Not a multiple of the four lanes, so the tail of the row goes through the scalar remainder too
+    static constexpr int32 NumSamples = 4099;
+
+    TArray<float> X, Y, batch;
+    X.SetNumUninitialized(NumSamples);
+    Y.SetNumUninitialized(NumSamples);
+    batch.SetNumUninitialized(NumSamples);
+
+    for (int32 i = 0; i < NumSamples; i++)
+    {
+        X[i] = stream.FRandRange(-1024.f, 1024.f);
+        Y[i] = stream.FRandRange(-1024.f, 1024.f);
+    }
+
+    // Right on the lattice corners and the 256 wrap, where the floor and the fade are the most likely to differ
+    for (int32 i = 0; i < 64; i++)
+    {
+        X[i] = (float)(i * 8 - 256);
+        Y[i] = (float)(256 - i * 8);
+    }
+
+    UNoiseFunctionLibrary::PerlinNoise2D_Batch(X.GetData(), Y.GetData(), batch.GetData(), NumSamples);
+
+    float maxError = 0.f;
+    int32 worstSample = 0;
+    for (int32 i = 0; i < NumSamples; i++)
+    {
+        const float error = FMath::Abs(batch[i] - FMath::PerlinNoise2D(FVector2D(X[i], Y[i])));
+        if (error > maxError)
+        {
+            maxError = error;
+            worstSample = i;
+        }
+    }
+
+    if (maxError > Tolerance)
+    {
+        AddError(FString::Printf(TEXT("PerlinNoise2D_Batch is %g away from FMath::PerlinNoise2D at (%f, %f)"), maxError, X[worstSample], Y[worstSample]));
+    }
+
+    // Short rows, split differently between the four lanes and the remainder
+    for (int32 num = 1; num < 8; num++)
+    {
+        UNoiseFunctionLibrary::PerlinNoise2D_Batch(X.GetData(), Y.GetData(), batch.GetData(), num);
+
+        for (int32 i = 0; i < num; i++)
+        {
+            TestNearlyEqual(FString::Printf(TEXT("Row of %d, sample %d"), num, i), batch[i], FMath::PerlinNoise2D(FVector2D(X[i], Y[i])), Tolerance);
+        }
+    }
+
+    return true;
+}
+
+#endif
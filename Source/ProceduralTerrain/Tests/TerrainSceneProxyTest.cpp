@@ -0,0 +1,124 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "../Components/TerrainMeshComponent.h"
+#include "../Components/TerrainSceneProxy.h"
+#include "Engine/World.h"
+#include "RenderingThread.h"
+#include "UObject/Package.h"
+
+// Square grid of (size x size) vertices, two triangles per cell
+static FMeshData MakeGridPart(const int32 size, const FVector& origin)
+{
+    FMeshData part;
+    for (int32 Y = 0; Y < size; Y++)
+        for (int32 X = 0; X < size; X++)
+            part.vertices.Add(origin + FVector(X * 100.0, Y * 100.0, 0.0));
+
+    for (int32 Y = 0; Y < size - 1; Y++)
+    {
+        for (int32 X = 0; X < size - 1; X++)
+        {
+            const int32 i = Y * size + X;
+            part.triangles.Append({ i, i + size, i + 1, i + 1, i + size, i + size + 1 });
+        }
+    }
+    return part;
+}
+
+// The draw ranges the proxy would emit for the visible parts, read on the render thread
+static TArray<TPair<const FTerrainBufferPage*, FMeshBatchElement>> GatherDrawRanges(const FTerrainSceneProxy& proxy)
+{
+    TArray<TPair<const FTerrainBufferPage*, FMeshBatchElement>> ranges;
+    FTerrainRenderDataPtr renderData = proxy.GetRenderData();
+
+    ENQUEUE_RENDER_COMMAND(GatherTerrainDrawRanges)(
+        [renderData, &ranges](FRHICommandListImmediate& RHICmdList)
+        {
+            renderData->ForEachVisiblePart([&ranges](const FTerrainBufferPage& page, const FTerrainPartAllocation& allocation)
+                {
+                    FMeshBatchElement element;
+                    FTerrainSceneProxy::SetDrawRange(element, allocation);
+                    ranges.Add({ &page, element });
+                });
+        });
+    FlushRenderingCommands();
+
+    return ranges;
+}
+
+// Builds the terrain proxy in a world of its own, runs under -nullrhi
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainSceneProxyDrawRangesTest, "ProceduralTerrain.Rendering.SceneProxyDrawRanges",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FTerrainSceneProxyDrawRangesTest::RunTest(const FString& Parameters)
+{
+    static constexpr int32 GridSize = 5;
+    static constexpr int32 PartVertices = GridSize * GridSize;
+    static constexpr int32 PartTriangles = (GridSize - 1) * (GridSize - 1) * 2;
+
+    UWorld* world = UWorld::CreateWorld(EWorldType::Game, false);
+
+    // Two parts fit in a page, so the four parts need a second one
+    UTerrainMeshComponent* terrainMesh = NewObject<UTerrainMeshComponent>(GetTransientPackage());
+    terrainMesh->m_pageVertices = PartVertices * 2;
+    terrainMesh->m_pageIndices = PartTriangles * 3 * 2;
+    terrainMesh->RegisterComponentWithWorld(world);
+
+    const FTerrainSceneProxy* proxy = static_cast<const FTerrainSceneProxy*>(terrainMesh->SceneProxy);
+    if (TestNotNull(TEXT("Scene proxy"), proxy))
+    {
+        terrainMesh->SetChunkPart(FIntPoint(0, 0), 0, MakeGridPart(GridSize, FVector::ZeroVector), 1.0f);
+        terrainMesh->SetChunkPart(FIntPoint(0, 0), 1, MakeGridPart(GridSize, FVector::ZeroVector), 1.0f);
+        terrainMesh->SetChunkPart(FIntPoint(0, 0), 2, MakeGridPart(GridSize, FVector::ZeroVector), 1.0f);
+        terrainMesh->SetChunkPart(FIntPoint(1, 0), 0, MakeGridPart(GridSize, FVector(1000.0, 0.0, 0.0)), 1.0f);
+
+        // Part 1 stays hidden
+        terrainMesh->SetChunkVisibleParts(FIntPoint(0, 0), { 0, 2 });
+        terrainMesh->SetChunkVisibleParts(FIntPoint(1, 0), { 0 });
+
+        TArray<TPair<const FTerrainBufferPage*, FMeshBatchElement>> ranges = GatherDrawRanges(*proxy);
+
+        TestEqual(TEXT("Buffer pages"), terrainMesh->GetNumBufferPages(), 2);
+        TestEqual(TEXT("Draw ranges of the visible parts"), ranges.Num(), 3);
+
+        for (int32 i = 0; i < ranges.Num(); i++)
+        {
+            const FTerrainBufferPage& page = *ranges[i].Key;
+            const FMeshBatchElement& element = ranges[i].Value;
+
+            TestEqual(TEXT("Triangles of a range"), (int32)element.NumPrimitives, PartTriangles);
+            TestEqual(TEXT("Vertices of a range"), (int32)(element.MaxVertexIndex - element.MinVertexIndex + 1), PartVertices);
+            TestTrue(TEXT("Vertices of a range inside its page"), element.MaxVertexIndex < page.vertexRanges.GetCapacity());
+            TestTrue(TEXT("Indices of a range inside its page"), element.FirstIndex + element.NumPrimitives * 3 <= page.indexRanges.GetCapacity());
+
+            // Ranges sharing a page can't overlap, neither in the vertices nor in the indices
+            for (int32 j = i + 1; j < ranges.Num(); j++)
+            {
+                if (ranges[j].Key != &page)
+                    continue;
+
+                const FMeshBatchElement& other = ranges[j].Value;
+                TestTrue(TEXT("Vertex ranges apart"), element.MaxVertexIndex < other.MinVertexIndex || other.MaxVertexIndex < element.MinVertexIndex);
+                TestTrue(TEXT("Index ranges apart"), element.FirstIndex + element.NumPrimitives * 3 <= other.FirstIndex
+                    || other.FirstIndex + other.NumPrimitives * 3 <= element.FirstIndex);
+            }
+        }
+
+        // A removed chunk gives its ranges back, and stops being drawn
+        terrainMesh->RemoveChunk(FIntPoint(0, 0));
+        ranges = GatherDrawRanges(*proxy);
+
+        TestEqual(TEXT("Draw ranges once a chunk is removed"), ranges.Num(), 1);
+        if (ranges.Num() == 1)
+            TestEqual(TEXT("Vertices used in the page of the remaining part"), (int32)ranges[0].Key->vertexRanges.GetUsed(), PartVertices);
+    }
+
+    terrainMesh->DestroyComponent();
+    world->DestroyWorld(false);
+
+    return true;
+}
+
+#endif